@@ -1,5 +1,8 @@
 #include "ast.h"
 #include "semantic.h"
+#include "symtab.h"
+#include "stats.h"
+#include "mem.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -27,58 +30,307 @@ enum LUA_TYPE infer_type(char *value)
     return STRING_T;
 }
 
-// Crea un nodo valore che accetta il tipo esplicitamente
-struct AstNode *new_value(enum NODE_TYPE nodetype, enum LUA_TYPE val_type, char *string_val)
+/* Hash-consing delle espressioni durante il parsing: letterali, variabili ed
+   espressioni (tranne le assegnazioni) strutturalmente uguali sono lo stesso
+   nodo. Le chiavi usano i figli già condivisi e i nomi internati, quindi il
+   confronto è sui puntatori. Un nodo condiviso ha sempre next a NULL: le
+   funzioni che costruiscono le liste lo copiano prima di collegarlo.
+*/
+
+struct share_key
+{
+    enum NODE_TYPE nodetype;
+    int kind; // val_type o expr_type
+    const void *a;
+    const void *b;
+};
+
+struct share_entry
+{
+    struct share_key key;
+    struct AstNode *node;
+    UT_hash_handle hh;
+};
+
+// Stringa internata, per contenuto
+struct share_string
+{
+    char *s;
+    UT_hash_handle hh;
+};
+
+static struct share_entry *shared_nodes;
+static struct share_string *shared_strings;
+static int sharing_done;
+
+static char *intern(char *s)
+{
+    struct share_string *e;
+    if (!s)
+        return NULL;
+    HASH_FIND_STR(shared_strings, s, e);
+    if (e)
+        return e->s;
+    e = mem_alloc(MEM_AST, sizeof(struct share_string));
+    e->s = s;
+    HASH_ADD_KEYPTR(hh, shared_strings, e->s, strlen(e->s), e);
+    return s;
+}
+
+static struct AstNode *share_find(enum NODE_TYPE nodetype, int kind, const void *a, const void *b,
+                                  struct share_key *key)
+{
+    struct share_entry *e;
+    memset(key, 0, sizeof(struct share_key));
+    key->nodetype = nodetype;
+    key->kind = kind;
+    key->a = a;
+    key->b = b;
+    HASH_FIND(hh, shared_nodes, key, sizeof(struct share_key), e);
+    if (!e)
+        return NULL;
+    stats.ast_shared++;
+    return e->node;
+}
+
+static void share_add(const struct share_key *key, struct AstNode *node)
+{
+    struct share_entry *e = mem_alloc(MEM_AST, sizeof(struct share_entry));
+    e->key = *key;
+    e->node = node;
+    node->shared = 1;
+    HASH_ADD(hh, shared_nodes, key, sizeof(struct share_key), e);
+}
+
+/* Copia profonda di un nodo condiviso e dei suoi figli, con i payload
+   propri: i nodi condivisi sono solo letterali, variabili ed espressioni,
+   e i loro figli sono a loro volta condivisi. Nomi e testi dei letterali
+   restano in comune, nessun passo li modifica.
+*/
+static struct AstNode *copy_shared(struct AstNode *node)
+{
+    if (!node)
+        return NULL;
+    struct AstNode *copy = mem_alloc(MEM_AST, sizeof(struct AstNode));
+    *copy = *node;
+    copy->shared = 0;
+    copy->next = NULL;
+    stats.ast_nodes[copy->nodetype]++;
+    switch (node->nodetype)
+    {
+    case VAL_T:
+        copy->node.val = mem_alloc(MEM_AST, sizeof(struct value));
+        *copy->node.val = *node->node.val;
+        break;
+    case VAR_T:
+        copy->node.var = mem_alloc(MEM_AST, sizeof(struct variable));
+        copy->node.var->name = node->node.var->name;
+        copy->node.var->table_key = copy_shared(node->node.var->table_key);
+        break;
+    case EXPR_T:
+        copy->node.expr = mem_alloc(MEM_AST, sizeof(struct expression));
+        copy->node.expr->expr_type = node->node.expr->expr_type;
+        copy->node.expr->l = copy_shared(node->node.expr->l);
+        copy->node.expr->r = copy_shared(node->node.expr->r);
+        break;
+    default:
+        break;
+    }
+    return copy;
+}
+
+// Copia non condivisa di un nodo, da inserire in una lista
+static struct AstNode *unshare(struct AstNode *node)
+{
+    if (!node || !node->shared)
+        return node;
+    return copy_shared(node);
+}
+
+// Valore di shared per un nodo condiviso già raggiunto dalla visita di ast_share_end
+#define SHARE_SEEN 2
+
+static void unshare_list(struct AstNode **list);
+
+/* La prima occorrenza di un nodo condiviso resta l'originale, le altre
+   diventano copie profonde.
+*/
+static void unshare_slot(struct AstNode **slot)
+{
+    struct AstNode *n = *slot;
+
+    if (!n)
+        return;
+    if (n->shared == SHARE_SEEN)
+    {
+        *slot = copy_shared(n);
+        return;
+    }
+    if (n->shared)
+        n->shared = SHARE_SEEN;
+    switch (n->nodetype)
+    {
+    case VAR_T:
+        unshare_slot(&n->node.var->table_key);
+        break;
+    case EXPR_T:
+        unshare_slot(&n->node.expr->l);
+        unshare_slot(&n->node.expr->r);
+        break;
+    case DECL_T:
+        unshare_slot(&n->node.decl->var);
+        unshare_slot(&n->node.decl->expr);
+        break;
+    case RETURN_T:
+        unshare_slot(&n->node.ret->expr);
+        break;
+    case FCALL_T:
+        unshare_slot(&n->node.fcall->func_expr);
+        unshare_list(&n->node.fcall->args);
+        break;
+    case TABLE_NODE_T:
+        if (n->node.table)
+            unshare_list(&n->node.table->fields);
+        break;
+    case TABLE_FIELD_T:
+        unshare_slot(&n->node.tfield->key);
+        unshare_slot(&n->node.tfield->value);
+        break;
+    case IF_T:
+        unshare_slot(&n->node.ifn->cond);
+        unshare_list(&n->node.ifn->body);
+        unshare_list(&n->node.ifn->else_body);
+        break;
+    case FOR_T:
+        unshare_slot(&n->node.forn->start);
+        unshare_slot(&n->node.forn->end);
+        unshare_slot(&n->node.forn->step);
+        unshare_list(&n->node.forn->stmt);
+        break;
+    case FDEF_T:
+        unshare_list(&n->node.fdef->params);
+        unshare_list(&n->node.fdef->code);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Un elemento è condiviso solo se la lista ne ha uno (link_AstNode copia gli
+   altri): si sostituisce nella lista come un figlio qualunque.
+*/
+static void unshare_list(struct AstNode **list)
+{
+    for (struct AstNode **p = list; *p; p = &(*p)->next)
+    {
+        struct AstNode *next = (*p)->next;
+        unshare_slot(p);
+        (*p)->next = next;
+    }
+}
+
+/* Chiude il hash-consing alla fine del parsing: ogni nodo condiviso resta
+   in un solo punto dell'AST e le altre occorrenze diventano copie, così i
+   passi che riscrivono i nodi sul posto (fold, unroll, dce, eval) non
+   cambiano le altre occorrenze della stessa sottoespressione. I nodi
+   creati dopo non sono condivisi.
+*/
+void ast_share_end(struct AstNode *root)
 {
-    struct value *val = malloc(sizeof(struct value));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct share_entry *e, *tmp;
+    struct share_string *s, *stmp;
 
-    if (val_type != 0 && val_type != ERROR_T)
+    unshare_list(&root);
+    HASH_ITER(hh, shared_nodes, e, tmp)
     {
-        val->val_type = val_type;
+        e->node->shared = 0;
+        HASH_DEL(shared_nodes, e);
+        mem_free(e);
     }
-    else
+    HASH_ITER(hh, shared_strings, s, stmp)
     {
-        val->val_type = infer_type(string_val);
+        HASH_DEL(shared_strings, s);
+        mem_free(s);
     }
+    sharing_done = 1;
+}
+
+// Crea un nodo valore che accetta il tipo esplicitamente
+struct AstNode *new_value(enum NODE_TYPE nodetype, enum LUA_TYPE val_type, char *string_val)
+{
+    struct share_key key;
+    struct AstNode *node;
 
+    if (val_type == 0 || val_type == ERROR_T)
+        val_type = infer_type(string_val);
+    if (!sharing_done)
+    {
+        string_val = intern(string_val);
+        if ((node = share_find(nodetype, val_type, string_val, NULL, &key)))
+            return node;
+    }
+
+    struct value *val = mem_alloc(MEM_AST, sizeof(struct value));
+    node = mem_alloc(MEM_AST, sizeof(struct AstNode));
+
+    val->val_type = val_type;
     val->string_val = string_val;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.val = val;
     node->next = NULL;
+    node->shared = 0;
 
+    if (!sharing_done)
+        share_add(&key, node);
     return node;
 }
 
 // Crea un nodo variabile
 struct AstNode *new_variable(enum NODE_TYPE nodetype, char *name, struct AstNode *table_key)
 {
-    struct variable *var = malloc(sizeof(struct variable));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct share_key key;
+    struct AstNode *node;
+
+    if (!sharing_done)
+    {
+        name = intern(name);
+        if ((node = share_find(nodetype, 0, name, table_key, &key)))
+            return node;
+    }
+
+    struct variable *var = mem_alloc(MEM_AST, sizeof(struct variable));
+    node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     var->name = name;
     var->table_key = table_key;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.var = var;
     node->next = NULL;
+    node->shared = 0;
 
+    if (!sharing_done)
+        share_add(&key, node);
     return node;
 }
 
 // Crea un nodo dichiarazione che non include tipi espliciti in Lua
 struct AstNode *new_declaration(enum NODE_TYPE nodetype, struct AstNode *var, struct AstNode *expr)
 {
-    struct declaration *decl = malloc(sizeof(struct declaration));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct declaration *decl = mem_alloc(MEM_AST, sizeof(struct declaration));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     decl->var = var;
     decl->expr = expr;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.decl = decl;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -87,31 +339,44 @@ struct AstNode *new_declaration(enum NODE_TYPE nodetype, struct AstNode *var, st
 struct AstNode *new_expression(enum NODE_TYPE nodetype, enum EXPRESSION_TYPE expr_type, struct AstNode *l,
                                struct AstNode *r)
 {
-    struct expression *expr = malloc(sizeof(struct expression));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct share_key key;
+    struct AstNode *node;
+    int share = !sharing_done && expr_type != ASS_T;
+
+    if (share && (node = share_find(nodetype, expr_type, l, r, &key)))
+        return node;
+
+    struct expression *expr = mem_alloc(MEM_AST, sizeof(struct expression));
+    node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     expr->expr_type = expr_type;
     expr->l = l;
     expr->r = r;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.expr = expr;
     node->next = NULL;
+    node->shared = 0;
 
+    if (share)
+        share_add(&key, node);
     return node;
 }
 
 // Crea un nuovo nodo return
 struct AstNode *new_return(enum NODE_TYPE nodetype, struct AstNode *expr)
 {
-    struct returnNode *rnode = malloc(sizeof(struct returnNode));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct returnNode *rnode = mem_alloc(MEM_AST, sizeof(struct returnNode));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     rnode->expr = expr;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.ret = rnode;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -119,16 +384,18 @@ struct AstNode *new_return(enum NODE_TYPE nodetype, struct AstNode *expr)
 // Crea un nodo chiamata a funzione
 struct AstNode *new_func_call(enum NODE_TYPE nodetype, struct AstNode *func_expr, struct AstNode *args)
 {
-    struct funcCall *fcall = malloc(sizeof(struct funcCall));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct funcCall *fcall = mem_alloc(MEM_AST, sizeof(struct funcCall));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     fcall->func_expr = func_expr;
     fcall->args = args;
     fcall->return_type = NIL_T;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.fcall = fcall;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -137,8 +404,8 @@ struct AstNode *new_func_call(enum NODE_TYPE nodetype, struct AstNode *func_expr
 struct AstNode *new_func_def(enum NODE_TYPE nodetype, char *name, struct AstNode *params, struct AstNode *code,
                              enum LUA_TYPE ret_type)
 {
-    struct funcDef *fdef = malloc(sizeof(struct funcDef));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct funcDef *fdef = mem_alloc(MEM_AST, sizeof(struct funcDef));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     fdef->name = name;
     fdef->params = params;
@@ -146,8 +413,10 @@ struct AstNode *new_func_def(enum NODE_TYPE nodetype, char *name, struct AstNode
     fdef->ret_type = ret_type;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.fdef = fdef;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -156,18 +425,21 @@ struct AstNode *new_func_def(enum NODE_TYPE nodetype, char *name, struct AstNode
 struct AstNode *new_for(enum NODE_TYPE nodetype, char *varname, struct AstNode *start, struct AstNode *end,
                         struct AstNode *step, struct AstNode *stmt)
 {
-    struct forNode *forn = malloc(sizeof(struct forNode));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct forNode *forn = mem_alloc(MEM_AST, sizeof(struct forNode));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     forn->varname = varname;
     forn->start = start;
     forn->end = end;
     forn->step = step;
     forn->stmt = stmt;
+    forn->parallel = 0;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.forn = forn;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -175,16 +447,18 @@ struct AstNode *new_for(enum NODE_TYPE nodetype, char *varname, struct AstNode *
 // Crea un nodo if
 struct AstNode *new_if(enum NODE_TYPE nodetype, struct AstNode *cond, struct AstNode *body, struct AstNode *else_body)
 {
-    struct ifNode *ifn = malloc(sizeof(struct ifNode));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct ifNode *ifn = mem_alloc(MEM_AST, sizeof(struct ifNode));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     ifn->cond = cond;
     ifn->body = body;
     ifn->else_body = else_body;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.ifn = ifn;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -192,14 +466,16 @@ struct AstNode *new_if(enum NODE_TYPE nodetype, struct AstNode *cond, struct Ast
 // Crea un nodo tabella
 struct AstNode *new_table(enum NODE_TYPE nodetype, struct AstNode *fields)
 {
-    struct table *t = malloc(sizeof(struct table));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct table *t = mem_alloc(MEM_AST, sizeof(struct table));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     t->fields = fields;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.table = t;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -207,15 +483,17 @@ struct AstNode *new_table(enum NODE_TYPE nodetype, struct AstNode *fields)
 /* Crea un nodo campo di tabella */
 struct AstNode *new_table_field(enum NODE_TYPE nodetype, struct AstNode *key, struct AstNode *value)
 {
-    struct tableField *field = malloc(sizeof(struct tableField));
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct tableField *field = mem_alloc(MEM_AST, sizeof(struct tableField));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     field->key = key;
     field->value = value;
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->node.tfield = field;
     node->next = NULL;
+    node->shared = 0;
 
     return node;
 }
@@ -223,16 +501,19 @@ struct AstNode *new_table_field(enum NODE_TYPE nodetype, struct AstNode *key, st
 // Crea un nodo errore
 struct AstNode *new_error(enum NODE_TYPE nodetype)
 {
-    struct AstNode *node = malloc(sizeof(struct AstNode));
+    struct AstNode *node = mem_alloc(MEM_AST, sizeof(struct AstNode));
 
     node->nodetype = nodetype;
+    stats.ast_nodes[nodetype]++;
     node->next = NULL;
+    node->shared = 0;
     return node;
 }
 
 // Funzione usata per creare una lista di nodi AST partendo dall'ultimo
 struct AstNode *link_AstNode(struct AstNode *node, struct AstNode *next)
 {
+    node = unshare(node);
     node->next = next;
     return node;
 }
@@ -240,6 +521,22 @@ struct AstNode *link_AstNode(struct AstNode *node, struct AstNode *next)
 // Funzione usata per creare una lista di nodi AST partendo dal primo
 struct AstNode *append_AstNode(struct AstNode *node, struct AstNode *next)
 {
+    next = unshare(next);
     node->next = next;
     return next;
 }
+
+// Inverte una lista di nodi AST, usata per le liste costruite al contrario dal parser
+struct AstNode *reverse_AstNode(struct AstNode *list)
+{
+    struct AstNode *reversed = NULL;
+    while (list)
+    {
+        struct AstNode *next = list->next;
+        list = unshare(list);
+        list->next = reversed;
+        reversed = list;
+        list = next;
+    }
+    return reversed;
+}
@@ -80,6 +80,7 @@ struct forNode
     struct AstNode *end;
     struct AstNode *step;
     struct AstNode *stmt;
+    int parallel; // preceduto dal commento --@parallel
 };
 
 // Struttura del nodo valore
@@ -144,6 +145,7 @@ struct funcDef
 struct AstNode
 {
     enum NODE_TYPE nodetype;
+    int shared; // nodo condiviso dal hash-consing durante il parsing, mai dentro una lista
 
     union node
     {
@@ -183,6 +185,10 @@ struct AstNode *new_error(enum NODE_TYPE nodetype);
 // Funzioni per linkare due nodi
 struct AstNode *link_AstNode(struct AstNode *node, struct AstNode *next);
 struct AstNode *append_AstNode(struct AstNode *node, struct AstNode *next);
+struct AstNode *reverse_AstNode(struct AstNode *list);
+
+// Termina il hash-consing dei nodi alla fine del parsing e copia le occorrenze ripetute, l'AST torna un albero
+void ast_share_end(struct AstNode *root);
 
 // Funzioni per inferire i tipi
 enum LUA_TYPE infer_type(char *value);
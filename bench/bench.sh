@@ -0,0 +1,62 @@
+#!/bin/sh
+# Benchmark di throughput del transpiler su sorgenti sintetici.
+# Per ogni forma e dimensione genera un sorgente con gen_corpus, lo traduce
+# REPEAT volte e riporta il tempo migliore in MB/s e statement/s, usando
+# il report --stats=json del transpiler.
+#
+# Variabili d'ambiente:
+#   SHAPES      forme da generare (default: tutte)
+#   SIZES       dimensioni in statement (default: 1000 4000 16000 64000)
+#   REPEAT      ripetizioni per misura, si tiene la più veloce (default: 3)
+#   TRANSPILER  eseguibile da misurare (default: ./transpiler)
+#   OUT         directory di lavoro (default: bench/out)
+
+SHAPES=${SHAPES:-"functions nesting tables expressions strings io mixed"}
+SIZES=${SIZES:-"1000 4000 16000 64000"}
+REPEAT=${REPEAT:-3}
+TRANSPILER=${TRANSPILER:-./transpiler}
+GEN=${GEN:-bench/gen_corpus}
+OUT=${OUT:-bench/out}
+
+mkdir -p "$OUT"
+status=0
+
+# Estrae un campo numerico dal report JSON: json_field <file> <oggetto> <campo>
+json_field() {
+    sed -n "s/.*\"$2\": {[^}]*\"$3\": \([0-9.]*\).*/\1/p" "$1" | head -n 1
+}
+
+printf "%-12s %8s %10s %10s %10s %10s %12s\n" "shape" "size" "bytes" "stmts" "wall_ms" "MB/s" "stmts/s"
+for shape in $SHAPES; do
+    for size in $SIZES; do
+        src="$OUT/$shape-$size.lua"
+        "$GEN" "$shape" "$size" > "$src" || { status=1; continue; }
+        bytes=$(wc -c < "$src" | tr -d ' ')
+        stmts=$(sed -n '1s/.*statements=\([0-9]*\).*/\1/p' "$src")
+
+        best=""
+        i=0
+        while [ $i -lt "$REPEAT" ]; do
+            if ! "$TRANSPILER" --stats=json --stats-file="$OUT/stats.json" "$src" > /dev/null 2> "$OUT/stderr.txt"; then
+                best="FAIL"
+                break
+            fi
+            wall=$(json_field "$OUT/stats.json" total wall_ms)
+            if [ -z "$best" ] || awk "BEGIN { exit !($wall < $best) }"; then
+                best=$wall
+            fi
+            i=$((i + 1))
+        done
+
+        if [ "$best" = "FAIL" ] || [ -z "$best" ]; then
+            printf "%-12s %8s %10s %10s %10s\n" "$shape" "$size" "$bytes" "$stmts" "FAIL"
+            status=1
+            continue
+        fi
+        awk -v s="$shape" -v n="$size" -v b="$bytes" -v st="$stmts" -v w="$best" 'BEGIN {
+            sec = (w > 0 ? w : 0.001) / 1000
+            printf "%-12s %8d %10d %10d %10.2f %10.2f %12.0f\n", s, n, b, st, w, b / 1e6 / sec, st / sec
+        }'
+    done
+done
+exit $status
@@ -0,0 +1,308 @@
+/* Generatore deterministico di sorgenti Lua per i benchmark del transpiler.
+   Produce solo costrutti accettati da parser.y, con forma e dimensione
+   configurabili:
+
+       gen_corpus <forma> <dimensione> [seed]
+
+   La dimensione è il numero di statement (per "tables" il numero di campi,
+   che vengono contati come statement). La prima riga dell'output riporta
+   forma, dimensione e statement generati,
+   e viene letta da bench.sh per calcolare gli statement al secondo.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEST_DEPTH 24      // profondità dei blocchi annidati nella forma "nesting"
+#define EXPR_TERMS 48      // termini per espressione nella forma "expressions"
+#define STRING_LEN 512     // lunghezza media delle stringhe nella forma "strings"
+#define VARS_PER_BLOCK 16  // variabili riusate negli statement generati
+
+static unsigned long long rng_state;
+static FILE *out;
+static long statements = 0;
+
+// xorshift64*, stabile tra piattaforme per rendere l'output riproducibile
+static unsigned rng()
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned)((rng_state * 2685821657736338717ULL) >> 32);
+}
+
+static void indent(int depth)
+{
+    for (int i = 0; i < depth; i++)
+        fputs("    ", out);
+}
+
+// Operando casuale: variabile già assegnata o letterale numerico
+static void operand()
+{
+    switch (rng() % 4)
+    {
+    case 0:
+        fprintf(out, "%u", rng() % 1000);
+        break;
+    case 1:
+        fprintf(out, "%u.%u", rng() % 100, rng() % 100);
+        break;
+    default:
+        fprintf(out, "v%u", rng() % VARS_PER_BLOCK);
+        break;
+    }
+}
+
+// Espressione aritmetica di n termini con precedenze e parentesi miste
+static void arith_expr(int terms)
+{
+    static const char *ops[] = {" + ", " - ", " * "};
+    int open = 0;
+
+    for (int i = 0; i < terms; i++)
+    {
+        if (i > 0)
+            fputs(ops[rng() % 3], out);
+        if (i + 2 < terms && rng() % 6 == 0)
+        {
+            fputc('(', out);
+            open++;
+        }
+        operand();
+        if (open > 0 && rng() % 4 == 0)
+        {
+            fputc(')', out);
+            open--;
+        }
+    }
+    while (open-- > 0)
+        fputc(')', out);
+}
+
+// Dichiara le variabili usate dagli operandi
+static void prologue()
+{
+    for (int i = 0; i < VARS_PER_BLOCK; i++)
+    {
+        fprintf(out, "v%d = %d\n", i, i + 1);
+        statements++;
+    }
+}
+
+static void gen_functions(long size)
+{
+    long count = size / 4 > 0 ? size / 4 : 1;
+
+    for (long k = 0; k < count; k++)
+    {
+        fprintf(out, "function f%ld(a, b)\n", k);
+        fprintf(out, "    c = a + b * %u\n", rng() % 100);
+        fprintf(out, "    if c > %ld then\n        return c\n    end\n", k);
+        fprintf(out, "    return a - b\nend\n");
+        statements += 4;
+    }
+    for (long k = 0; k < count; k++)
+    {
+        fprintf(out, "r%ld = f%ld(%u, %u)\n", k % VARS_PER_BLOCK, k, rng() % 100, rng() % 100);
+        statements++;
+    }
+}
+
+static void gen_nesting(long size)
+{
+    prologue();
+    while (statements < size)
+    {
+        int depth;
+        for (depth = 0; depth < NEST_DEPTH; depth++)
+        {
+            indent(depth);
+            if (depth % 2 == 0)
+                fprintf(out, "if v%d > %u then\n", depth % VARS_PER_BLOCK, rng() % 50);
+            else
+                fprintf(out, "for i%d = 1, %u do\n", depth, 2 + rng() % 8);
+            statements++;
+        }
+        indent(depth);
+        fprintf(out, "x = v%u + %u\n", rng() % VARS_PER_BLOCK, rng() % 10);
+        statements++;
+        for (depth = NEST_DEPTH - 1; depth >= 0; depth--)
+        {
+            indent(depth);
+            if (depth % 2 == 0 && rng() % 2 == 0)
+            {
+                fprintf(out, "else\n");
+                indent(depth + 1);
+                fprintf(out, "y = %u\n", rng() % 10);
+                indent(depth);
+                statements++;
+            }
+            fprintf(out, "end\n");
+        }
+    }
+}
+
+static void gen_tables(long size)
+{
+    fprintf(out, "t = {\n");
+    for (long k = 0; k < size; k++)
+    {
+        fprintf(out, "    ");
+        switch (rng() % 6)
+        {
+        case 0:
+            fprintf(out, "k%ld = %u", k, rng() % 10000);
+            break;
+        case 1:
+            fprintf(out, "%u.%u", rng() % 1000, rng() % 100);
+            break;
+        case 2:
+            fprintf(out, "\"campo %ld\"", k);
+            break;
+        case 3:
+            fprintf(out, "%s", rng() % 2 ? "true" : "false");
+            break;
+        case 4:
+            fprintf(out, "{ %u, %u, \"s\" }", rng() % 10, rng() % 10);
+            break;
+        default:
+            fprintf(out, "%u", rng() % 100000);
+            break;
+        }
+        fprintf(out, "%s\n", k + 1 < size ? "," : "");
+    }
+    fprintf(out, "}\n");
+    statements += size; // ogni campo conta come un'unità di lavoro
+}
+
+static void gen_expressions(long size)
+{
+    prologue();
+    while (statements < size)
+    {
+        fprintf(out, "v%u = ", rng() % VARS_PER_BLOCK);
+        arith_expr(EXPR_TERMS / 2 + rng() % EXPR_TERMS);
+        fputc('\n', out);
+        statements++;
+    }
+}
+
+static void gen_strings(long size)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789,;:";
+
+    while (statements < size)
+    {
+        if (rng() % 4 == 0)
+        {
+            // commento lungo su più righe
+            fprintf(out, "--[[\n");
+            for (int l = 0; l < 8; l++)
+            {
+                for (int i = 0; i < 72; i++)
+                    fputc(alphabet[rng() % (sizeof(alphabet) - 1)], out);
+                fputc('\n', out);
+            }
+            fprintf(out, "]]\n");
+        }
+        fprintf(out, "s%u = \"", rng() % VARS_PER_BLOCK);
+        int len = STRING_LEN / 2 + rng() % STRING_LEN;
+        for (int i = 0; i < len; i++)
+        {
+            if (rng() % 64 == 0)
+                fputs("\\\"", out);
+            else
+                fputc(alphabet[rng() % (sizeof(alphabet) - 1)], out);
+        }
+        fprintf(out, "\" -- commento di riga\n");
+        statements++;
+    }
+}
+
+static void gen_io(long size)
+{
+    prologue();
+    while (statements < size)
+    {
+        switch (rng() % 5)
+        {
+        case 0:
+            fprintf(out, "n%u = io.read(\"*n\")\n", rng() % VARS_PER_BLOCK);
+            break;
+        case 1:
+            fprintf(out, "l%u = io.read()\n", rng() % VARS_PER_BLOCK);
+            break;
+        case 2:
+            fprintf(out, "b%u = io.read(%u)\n", rng() % VARS_PER_BLOCK, 1 + rng() % 16);
+            break;
+        default:
+            fprintf(out, "print(\"valore\", v%u, %u, %u.5, \"fine\")\n", rng() % VARS_PER_BLOCK, rng() % 100,
+                    rng() % 100);
+            break;
+        }
+        statements++;
+    }
+}
+
+// Forma mista: alterna blocchi di tutte le altre forme
+static void gen_mixed(long size)
+{
+    long chunk = size / 5 > 0 ? size / 5 : 1;
+
+    gen_functions(chunk);
+    gen_expressions(statements + chunk);
+    gen_strings(statements + chunk);
+    gen_io(statements + chunk);
+    gen_nesting(statements + chunk);
+}
+
+struct shape
+{
+    const char *name;
+    void (*generate)(long size);
+};
+
+static const struct shape shapes[] = {
+    {"functions", gen_functions}, {"nesting", gen_nesting}, {"tables", gen_tables}, {"expressions", gen_expressions},
+    {"strings", gen_strings},     {"io", gen_io},           {"mixed", gen_mixed},
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <shape> <size> [seed]\nshapes:", argv[0]);
+        for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++)
+            fprintf(stderr, " %s", shapes[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    long size = atol(argv[2]);
+    rng_state = argc > 3 ? strtoull(argv[3], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    if (rng_state == 0)
+        rng_state = 1;
+
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++)
+    {
+        if (strcmp(argv[1], shapes[i].name) == 0)
+        {
+            // Gli statement sono noti solo a generazione finita: il contenuto è
+            // bufferizzato e preceduto dall'intestazione
+            char *body;
+            size_t body_len;
+            out = open_memstream(&body, &body_len);
+            shapes[i].generate(size);
+            fclose(out);
+
+            printf("-- lua2c bench: shape=%s size=%ld statements=%ld\n", shapes[i].name, size, statements);
+            fwrite(body, 1, body_len, stdout);
+            free(body);
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "unknown shape: %s\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,145 @@
+#!/bin/sh
+# Test di scalabilità del transpiler: per ogni forma patologica traduce
+# sorgenti di dimensione N, 2N, 4N, 8N, stima l'esponente di crescita di
+# ogni fase (pendenza della retta di regressione in scala log-log rispetto
+# al numero di statement) e fallisce se una fase cresce più di BOUND.
+# Con BOUND=1.3 è ammesso n log n, mentre una crescita quadratica (~2) no.
+#
+# Oltre ai tempi vengono controllati i contatori deterministici del report
+# (scope visitati da find_symtab, nodi AST, picco di memoria), che non
+# risentono del rumore di misura.
+#
+# Variabili d'ambiente:
+#   SHAPES      forme da generare (default: nesting tables expressions strings functions)
+#   BASE        dimensione N in statement (default: 4000)
+#   STEPS       numero di raddoppi misurati (default: 4, cioè N..8N)
+#   BOUND       esponente massimo ammesso (default: 1.3)
+#   MIN_MS      fasi sotto questa durata alla dimensione massima sono ignorate (default: 5)
+#   REPEAT      ripetizioni per misura, si tiene la più veloce (default: 3)
+#   TRANSPILER  eseguibile da misurare (default: ./transpiler)
+#   FLAGS       opzioni aggiuntive del transpiler, es. "-O2 --ir" per misurare anche i passi
+#   OUT         directory di lavoro (default: bench/out)
+
+SHAPES=${SHAPES:-"nesting tables expressions strings functions"}
+BASE=${BASE:-4000}
+STEPS=${STEPS:-4}
+BOUND=${BOUND:-1.3}
+MIN_MS=${MIN_MS:-5}
+REPEAT=${REPEAT:-3}
+TRANSPILER=${TRANSPILER:-./transpiler}
+GEN=${GEN:-bench/gen_corpus}
+OUT=${OUT:-bench/out}
+
+PHASES="lex parse eval_expr_type infer_func_return_type check_fcall ir opt translate output total"
+COUNTERS="tokens scopes_walked symbols_inserted ast_nodes peak"
+
+mkdir -p "$OUT"
+status=0
+
+# Estrae un campo numerico dal report JSON: json_field <file> <oggetto> <campo>
+json_field() {
+    sed -n "s/.*\"$2\": {[^}]*\"$3\": \([0-9.]*\).*/\1/p" "$1" | head -n 1
+}
+
+# Estrae un contatore scalare o il totale di un oggetto: json_counter <file> <nome>
+json_counter() {
+    sed -n "s/.*\"$2\": \([0-9.][0-9.]*\).*/\1/p; s/.*\"$2\": {\"total\": \([0-9.]*\).*/\1/p" "$1" | head -n 1
+}
+
+# Pendenza dei punti "x y" letti da stdin in scala log-log
+fit_exponent() {
+    awk '$1 > 0 && $2 > 0 {
+        x = log($1); y = log($2)
+        n++; sx += x; sy += y; sxx += x * x; sxy += x * y
+    }
+    END {
+        d = n * sxx - sx * sx
+        if (n < 2 || d == 0) print "nan"
+        else printf "%.2f\n", (n * sxy - sx * sy) / d
+    }'
+}
+
+# Confronta l'esponente con BOUND e stampa l'esito: check <shape> <metrica> <esponente> <ultimo valore>
+check() {
+    verdict="ok"
+    if [ "$3" = "nan" ]; then
+        verdict="skip"
+    elif awk "BEGIN { exit !($3 > $BOUND) }"; then
+        verdict="FAIL"
+        status=1
+    fi
+    printf "%-12s %-24s %8s %14s  %s\n" "$1" "$2" "$3" "$4" "$verdict"
+}
+
+printf "%-12s %-24s %8s %14s  %s\n" "shape" "metric" "exp" "max value" "result"
+for shape in $SHAPES; do
+    data="$OUT/scaling-$shape.txt"
+    : > "$data"
+
+    size=$BASE
+    step=0
+    while [ $step -lt "$STEPS" ]; do
+        src="$OUT/$shape-$size.lua"
+        "$GEN" "$shape" "$size" > "$src" || { status=1; break; }
+        stmts=$(sed -n '1s/.*statements=\([0-9]*\).*/\1/p' "$src")
+
+        # Per ogni fase si tiene il minimo tra le ripetizioni
+        best=""
+        i=0
+        while [ $i -lt "$REPEAT" ]; do
+            if ! "$TRANSPILER" $FLAGS --stats=json --stats-file="$OUT/stats.json" "$src" > /dev/null 2> "$OUT/stderr.txt"; then
+                printf "%-12s %-24s %8s %14s  %s\n" "$shape" "size $size" "" "" "FAIL (transpiler)"
+                status=1
+                best=""
+                break
+            fi
+            row=""
+            for p in $PHASES; do
+                row="$row $(json_field "$OUT/stats.json" "$p" wall_ms)"
+            done
+            if [ -z "$best" ]; then
+                best=$row
+            else
+                best=$(echo "$best
+$row" | awk 'NR == 1 { for (k = 1; k <= NF; k++) m[k] = $k }
+                    NR == 2 { for (k = 1; k <= NF; k++) printf "%s ", ($k < m[k] ? $k : m[k]); print "" }')
+            fi
+            i=$((i + 1))
+        done
+        [ -z "$best" ] && break
+
+        counters=""
+        for c in $COUNTERS; do
+            v=$(json_counter "$OUT/stats.json" "$c")
+            counters="$counters ${v:-0}"
+        done
+        echo "$stmts $best $counters" >> "$data"
+
+        size=$((size * 2))
+        step=$((step + 1))
+    done
+
+    [ "$(wc -l < "$data")" -lt 2 ] && continue
+
+    col=2
+    for metric in $PHASES $COUNTERS; do
+        last=$(awk -v c=$col 'END { print $c }' "$data")
+        case " $PHASES " in
+        *" $metric "*)
+            # Tempi troppo piccoli sono dominati dal rumore
+            if awk "BEGIN { exit !($last < $MIN_MS) }"; then
+                col=$((col + 1))
+                continue
+            fi
+            name="$metric (ms)"
+            ;;
+        *)
+            name=$metric
+            ;;
+        esac
+        exp=$(awk -v c=$col '{ print $1, $c }' "$data" | fit_exponent)
+        check "$shape" "$name" "$exp" "$last"
+        col=$((col + 1))
+    done
+done
+exit $status
@@ -0,0 +1,343 @@
+#include "dce.h"
+#include "fold.h"
+#include "symtab.h"
+#include "mem.h"
+#include <string.h>
+
+// Nome di variabile letta o di funzione raggiunta
+struct dce_name
+{
+    const char *name; // chiave della hash table
+    UT_hash_handle hh;
+};
+
+static long removed;
+
+static int has_name(struct dce_name *set, const char *name)
+{
+    struct dce_name *e;
+    HASH_FIND_STR(set, name, e);
+    return e != NULL;
+}
+
+static int add_name(struct dce_name **set, const char *name)
+{
+    if (has_name(*set, name))
+        return 0;
+    struct dce_name *e = mem_alloc(MEM_AST, sizeof(struct dce_name));
+    e->name = name;
+    HASH_ADD_KEYPTR(hh, *set, e->name, strlen(e->name), e);
+    return 1;
+}
+
+static void clear_names(struct dce_name **set)
+{
+    struct dce_name *e, *tmp;
+    HASH_ITER(hh, *set, e, tmp)
+    {
+        HASH_DEL(*set, e);
+        mem_free(e);
+    }
+}
+
+static void collect_list(struct AstNode *list, struct dce_name **set);
+
+/* Nomi che il nodo legge: variabili e funzioni chiamate. La variabile a
+   sinistra di un'assegnazione non è una lettura, salvo che l'assegnazione
+   sia a un campo della tabella.
+*/
+static void collect(struct AstNode *n, struct dce_name **set)
+{
+    if (!n)
+        return;
+    switch (n->nodetype)
+    {
+    case VAR_T:
+        add_name(set, n->node.var->name);
+        collect(n->node.var->table_key, set);
+        break;
+    case EXPR_T:
+    {
+        struct AstNode *lhs = n->node.expr->l;
+        if (n->node.expr->expr_type != ASS_T || !lhs || lhs->nodetype != VAR_T || lhs->node.var->table_key)
+            collect(lhs, set);
+        collect(n->node.expr->r, set);
+        break;
+    }
+    case DECL_T:
+        collect(n->node.decl->expr, set);
+        break;
+    case RETURN_T:
+        collect(n->node.ret->expr, set);
+        break;
+    case FCALL_T:
+        collect(n->node.fcall->func_expr, set);
+        collect_list(n->node.fcall->args, set);
+        break;
+    case TABLE_NODE_T:
+        collect_list(n->node.table->fields, set);
+        break;
+    case TABLE_FIELD_T:
+        collect(n->node.tfield->key, set);
+        collect(n->node.tfield->value, set);
+        break;
+    case IF_T:
+        collect(n->node.ifn->cond, set);
+        collect_list(n->node.ifn->body, set);
+        collect_list(n->node.ifn->else_body, set);
+        break;
+    case FOR_T:
+        collect(n->node.forn->start, set);
+        collect(n->node.forn->end, set);
+        collect(n->node.forn->step, set);
+        collect_list(n->node.forn->stmt, set);
+        break;
+    case FDEF_T:
+        collect_list(n->node.fdef->params, set);
+        collect_list(n->node.fdef->code, set);
+        break;
+    default:
+        break;
+    }
+}
+
+static void collect_list(struct AstNode *list, struct dce_name **set)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+        collect(n, set);
+}
+
+// Espressione senza chiamate, che si può non valutare
+static int no_calls(struct AstNode *n)
+{
+    if (!n)
+        return 1;
+    switch (n->nodetype)
+    {
+    case FCALL_T:
+        return 0;
+    case VAR_T:
+        return no_calls(n->node.var->table_key);
+    case EXPR_T:
+        return no_calls(n->node.expr->l) && no_calls(n->node.expr->r);
+    case TABLE_NODE_T:
+        for (struct AstNode *f = n->node.table->fields; f; f = f->next)
+        {
+            if (!no_calls(f))
+                return 0;
+        }
+        return 1;
+    case TABLE_FIELD_T:
+        return no_calls(n->node.tfield->key) && no_calls(n->node.tfield->value);
+    default:
+        return 1;
+    }
+}
+
+static int dead_store(struct AstNode *n, struct dce_name *reads)
+{
+    struct AstNode *var, *value;
+    if (n->nodetype == EXPR_T && n->node.expr->expr_type == ASS_T)
+    {
+        var = n->node.expr->l;
+        value = n->node.expr->r;
+    }
+    else if (n->nodetype == DECL_T)
+    {
+        var = n->node.decl->var;
+        value = n->node.decl->expr;
+    }
+    else
+        return 0;
+    return var && var->nodetype == VAR_T && !var->node.var->table_key && !has_name(reads, var->node.var->name) &&
+           no_calls(value);
+}
+
+// Verità della condizione costante di un if, -1 se non è nota
+static int const_cond(struct AstNode *cond)
+{
+    struct const_value c;
+    int truth;
+    if (cond->nodetype != VAL_T || !const_parse(cond->node.val->val_type, cond->node.val->string_val, &c) ||
+        !const_truth(&c, &truth))
+        return -1;
+    return truth;
+}
+
+/* La grammatica non ha local: DECL_T è un parametro con valore di default
+   e non compare tra gli statement, quindi solo una definizione di funzione
+   tiene il ramo nel suo blocco.
+*/
+static int defines_function(struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        if (n->nodetype == FDEF_T)
+            return 1;
+    }
+    return 0;
+}
+
+// Statement dopo il quale il resto della lista non viene eseguito
+static int terminates(struct AstNode *n)
+{
+    struct AstNode *last;
+    if (n->nodetype == RETURN_T)
+        return 1;
+    if (n->nodetype != IF_T || !n->node.ifn->body || !n->node.ifn->else_body)
+        return 0;
+    for (last = n->node.ifn->body; last->next; last = last->next)
+        ;
+    if (!terminates(last))
+        return 0;
+    for (last = n->node.ifn->else_body; last->next; last = last->next)
+        ;
+    return terminates(last);
+}
+
+static long count_list(struct AstNode *list)
+{
+    long count = 0;
+    for (; list; list = list->next)
+        count++;
+    return count;
+}
+
+static struct AstNode *sweep_list(struct AstNode *list, struct dce_name *reads);
+
+static void sweep_statement(struct AstNode *n, struct dce_name *reads)
+{
+    switch (n->nodetype)
+    {
+    case IF_T:
+        n->node.ifn->body = sweep_list(n->node.ifn->body, reads);
+        n->node.ifn->else_body = sweep_list(n->node.ifn->else_body, reads);
+        break;
+    case FOR_T:
+        n->node.forn->stmt = sweep_list(n->node.forn->stmt, reads);
+        break;
+    case FDEF_T:
+        n->node.fdef->code = sweep_list(n->node.fdef->code, reads);
+        break;
+    default:
+        break;
+    }
+}
+
+// Ricostruisce la lista senza gli statement morti e restituisce la nuova testa
+static struct AstNode *sweep_list(struct AstNode *list, struct dce_name *reads)
+{
+    struct AstNode *head = NULL, **tail = &head, *next = NULL;
+    int ended = 0;
+
+    for (struct AstNode *n = list; n && !ended; n = next)
+    {
+        next = n->next;
+        sweep_statement(n, reads);
+        if (dead_store(n, reads))
+        {
+            removed++;
+            continue;
+        }
+        else if (n->nodetype == IF_T && const_cond(n->node.ifn->cond) >= 0)
+        {
+            int truth = const_cond(n->node.ifn->cond);
+            struct AstNode *taken = truth ? n->node.ifn->body : n->node.ifn->else_body;
+            if (!defines_function(taken))
+            {
+                // Il ramo eseguito prende il posto dell'if
+                removed++;
+                for (struct AstNode *s = taken, *s_next; s; s = s_next)
+                {
+                    s_next = s->next;
+                    *tail = s;
+                    tail = &s->next;
+                    ended = terminates(s);
+                }
+                continue;
+            }
+            // Le funzioni del ramo restano nel suo blocco: si toglie solo il ramo non eseguito
+            if (n->node.ifn->else_body)
+                removed++;
+            if (!truth)
+            {
+                n->node.ifn->cond = new_value(VAL_T, TRUE_T, mem_strdup(MEM_AST, "true"));
+                n->node.ifn->body = n->node.ifn->else_body;
+            }
+            n->node.ifn->else_body = NULL;
+        }
+        *tail = n;
+        tail = &n->next;
+        ended = terminates(n);
+    }
+    // Statement dopo un return
+    removed += count_list(next);
+    *tail = NULL;
+    return head;
+}
+
+/* Funzioni raggiunte dal programma principale: i nomi usati fuori dalle
+   definizioni, poi quelli usati nei corpi delle funzioni raggiunte, fino
+   al punto fisso.
+*/
+static void collect_live(struct AstNode *root, struct dce_name **live)
+{
+    int changed = 1;
+    for (struct AstNode *n = root; n; n = n->next)
+    {
+        if (n->nodetype != FDEF_T)
+            collect(n, live);
+    }
+    while (changed)
+    {
+        changed = 0;
+        for (struct AstNode *n = root; n; n = n->next)
+        {
+            int before = HASH_COUNT(*live);
+            if (n->nodetype == FDEF_T && n->node.fdef->name && has_name(*live, n->node.fdef->name))
+            {
+                collect(n, live);
+                changed |= HASH_COUNT(*live) != (unsigned)before;
+            }
+        }
+    }
+}
+
+long dce_ast(struct AstNode *root)
+{
+    struct dce_name *reads = NULL, *live = NULL;
+    struct AstNode *list = root, **link;
+    long before;
+
+    removed = 0;
+    do
+    {
+        before = removed;
+        collect_list(list, &reads);
+        list = sweep_list(list, reads);
+
+        collect_live(list, &live);
+        for (link = &list; *link;)
+        {
+            struct AstNode *f = *link;
+            if (f->nodetype == FDEF_T && f->node.fdef->name && !has_name(live, f->node.fdef->name))
+            {
+                *link = f->next;
+                removed++;
+            }
+            else
+                link = &f->next;
+        }
+        clear_names(&reads);
+        clear_names(&live);
+    } while (removed != before);
+
+    /* La radice dell'AST è del chiamante: prende il contenuto della nuova
+       testa, o di un if senza corpo se non resta nessuno statement.
+    */
+    if (!list)
+        list = new_if(IF_T, new_value(VAL_T, FALSE_T, mem_strdup(MEM_AST, "false")), NULL, NULL);
+    if (list != root)
+        *root = *list;
+    return removed;
+}
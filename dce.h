@@ -0,0 +1,22 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "ast.h"
+
+/* Eliminazione del codice morto sull'AST, prima della traduzione:
+   - gli statement che seguono un return, o un if i cui rami terminano
+     entrambi con return;
+   - gli if con condizione costante (dopo fold): resta solo il ramo
+     eseguito, portato nella lista che contiene l'if se non definisce
+     funzioni;
+   - le assegnazioni a variabili che nessuna espressione del programma
+     legge, se il valore assegnato non contiene chiamate;
+   - le funzioni che non si raggiungono dalle chiamate del programma
+     principale attraverso il grafo delle chiamate.
+   Il confronto delle variabili è sul nome, su tutto il programma: una
+   lettura in qualunque funzione tiene vive tutte le assegnazioni.
+*/
+
+long dce_ast(struct AstNode *root);
+
+#endif
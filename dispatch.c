@@ -0,0 +1,216 @@
+#include "dispatch.h"
+#include "fold.h"
+#include "mem.h"
+#include <limits.h>
+#include <string.h>
+
+static struct dispatch *chains;
+static int analyzed;
+
+unsigned dispatch_hash(const char *s, unsigned seed)
+{
+    // FNV-1a a 32 bit con il seme nel valore iniziale
+    unsigned h = 2166136261u ^ seed;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/* Caso della catena: var == costante o costante == var, con la costante
+   intera (anche negata) o stringa senza sequenze di escape. Restituisce
+   la variabile confrontata, NULL se la condizione non ha questa forma.
+*/
+static const char *case_of(struct AstNode *cond, struct dispatch_case *c, int *strings)
+{
+    if (cond->nodetype != EXPR_T || cond->node.expr->expr_type != EQ_T)
+        return NULL;
+
+    struct AstNode *var = cond->node.expr->l, *k = cond->node.expr->r;
+    if (var->nodetype != VAR_T)
+    {
+        var = cond->node.expr->r;
+        k = cond->node.expr->l;
+    }
+    if (var->nodetype != VAR_T || var->node.var->table_key)
+        return NULL;
+
+    int neg = k->nodetype == EXPR_T && k->node.expr->expr_type == NEG_T;
+    if (neg)
+        k = k->node.expr->r;
+    if (k->nodetype != VAL_T)
+        return NULL;
+
+    struct const_value v;
+    if (!const_parse(k->node.val->val_type, k->node.val->string_val, &v))
+        return NULL;
+    if (v.type == INT_T)
+    {
+        c->value = neg ? -v.i : v.i;
+        if (c->value < INT_MIN || c->value > INT_MAX)
+            return NULL;
+        *strings = 0;
+    }
+    else if (v.type == STRING_T && !neg)
+    {
+        c->text = k->node.val->string_val;
+        *strings = 1;
+    }
+    else
+        return NULL;
+    return var->node.var->name;
+}
+
+static int duplicate(struct dispatch *d, struct dispatch_case *c)
+{
+    for (int i = 0; i < d->ncases; i++)
+    {
+        if (d->strings ? strcmp(d->cases[i].text, c->text) == 0 : d->cases[i].value == c->value)
+            return 1;
+    }
+    return 0;
+}
+
+/* Tabella più piccola, e a parità di dimensione primo seme, in cui le
+   stringhe dei casi cadono in posizioni distinte.
+*/
+static int perfect_hash(struct dispatch *d)
+{
+    unsigned char *used = mem_alloc(MEM_AST, DISPATCH_MAX_SLOTS);
+    unsigned size = 1;
+
+    while (size < (unsigned)d->ncases)
+        size *= 2;
+    for (; size <= DISPATCH_MAX_SLOTS; size *= 2)
+    {
+        for (unsigned seed = 0; seed < DISPATCH_MAX_SEEDS; seed++)
+        {
+            int i;
+            memset(used, 0, size);
+            for (i = 0; i < d->ncases; i++)
+            {
+                unsigned slot = dispatch_hash(d->cases[i].text, seed) & (size - 1);
+                if (used[slot])
+                    break;
+                used[slot] = 1;
+                d->cases[i].slot = slot;
+            }
+            if (i == d->ncases)
+            {
+                d->seed = seed;
+                d->mask = size - 1;
+                mem_free(used);
+                return 1;
+            }
+        }
+    }
+    mem_free(used);
+    return 0;
+}
+
+/* La catena prosegue finché l'else contiene solo un altro if che confronta
+   la stessa variabile con una costante nuova dello stesso tipo; il resto
+   diventa il caso default.
+*/
+static struct dispatch *analyze_chain(struct AstNode *head)
+{
+    struct dispatch *d = mem_alloc(MEM_AST, sizeof(struct dispatch));
+    int cap = 8;
+
+    memset(d, 0, sizeof(struct dispatch));
+    d->head = head;
+    d->cases = mem_alloc(MEM_AST, cap * sizeof(struct dispatch_case));
+
+    for (struct AstNode *n = head;; n = n->node.ifn->else_body)
+    {
+        struct dispatch_case c;
+        int strings;
+        memset(&c, 0, sizeof(c));
+
+        // L'if che interrompe la catena diventa il caso default
+        const char *var = case_of(n->node.ifn->cond, &c, &strings);
+        if (!var || (d->ncases && (strcmp(var, d->var) != 0 || strings != d->strings || duplicate(d, &c))))
+        {
+            d->default_body = n;
+            break;
+        }
+        d->var = var;
+        d->strings = strings;
+        if (d->ncases == cap)
+        {
+            cap *= 2;
+            d->cases = mem_realloc(d->cases, cap * sizeof(struct dispatch_case));
+        }
+        c.body = n->node.ifn->body;
+        d->cases[d->ncases++] = c;
+
+        struct AstNode *e = n->node.ifn->else_body;
+        if (!e || e->nodetype != IF_T || e->next)
+        {
+            d->default_body = e;
+            break;
+        }
+    }
+
+    if (d->ncases < DISPATCH_MIN_CASES || (d->strings && !perfect_hash(d)))
+    {
+        mem_free(d->cases);
+        mem_free(d);
+        return NULL;
+    }
+    return d;
+}
+
+static void walk_list(struct AstNode *list);
+
+static void walk_if(struct AstNode *n)
+{
+    struct dispatch *d = analyze_chain(n);
+    if (!d)
+    {
+        walk_list(n->node.ifn->body);
+        walk_list(n->node.ifn->else_body);
+        return;
+    }
+
+    HASH_ADD_PTR(chains, head, d);
+    for (int i = 0; i < d->ncases; i++)
+        walk_list(d->cases[i].body);
+    walk_list(d->default_body);
+}
+
+static void walk_list(struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        switch (n->nodetype)
+        {
+        case IF_T:
+            walk_if(n);
+            break;
+        case FOR_T:
+            walk_list(n->node.forn->stmt);
+            break;
+        case FDEF_T:
+            walk_list(n->node.fdef->code);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+long dispatch_ast(struct AstNode *root)
+{
+    walk_list(root);
+    analyzed = 1;
+    return HASH_COUNT(chains);
+}
+
+struct dispatch *dispatch_find(struct AstNode *head)
+{
+    struct dispatch *d;
+    if (!analyzed)
+        return NULL;
+    HASH_FIND_PTR(chains, &head, d);
+    return d;
+}
@@ -0,0 +1,52 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "ast.h"
+#include "symtab.h"
+
+/* Catene di if annidati nell'else che confrontano con == la stessa
+   variabile con costanti distinte, tutte intere o tutte stringhe. Il
+   backend AST le emette come switch: sugli interi direttamente, sulle
+   stringhe sulla posizione della chiave in una tabella indicizzata da un
+   hash perfetto calcolato durante la traduzione, così la scelta del ramo
+   costa un hash e un solo strcmp invece di un confronto per caso.
+*/
+
+// Casi sotto i quali la catena resta una sequenza di if
+#define DISPATCH_MIN_CASES 3
+// Posizioni massime della tabella di un hash perfetto
+#define DISPATCH_MAX_SLOTS 4096
+// Semi provati per ogni dimensione della tabella
+#define DISPATCH_MAX_SEEDS 1024
+
+struct dispatch_case
+{
+    struct AstNode *body;
+    long long value;  // caso intero
+    const char *text; // caso stringa, senza virgolette
+    unsigned slot;    // posizione della stringa nella tabella
+};
+
+// Catena riconosciuta, a partire dal primo if
+struct dispatch
+{
+    struct AstNode *head; // chiave della hash table
+    const char *var;
+    int strings; // confronti tra stringhe: switch sulla posizione nella tabella
+    struct dispatch_case *cases;
+    int ncases;
+    struct AstNode *default_body; // else dell'ultimo if della catena, NULL se manca
+    unsigned seed;
+    unsigned mask; // dimensione della tabella - 1
+    UT_hash_handle hh;
+};
+
+long dispatch_ast(struct AstNode *root);
+
+// Catena che inizia con l'if, NULL se il passo non è attivo o l'if non ne inizia una
+struct dispatch *dispatch_find(struct AstNode *head);
+
+// Hash usato dal C generato (c_lua_switch_hash), calcolato anche durante la traduzione
+unsigned dispatch_hash(const char *s, unsigned seed);
+
+#endif
@@ -0,0 +1,505 @@
+#include "effects.h"
+#include "global.h"
+#include "symtab.h"
+#include "translate.h"
+#include "mem.h"
+#include <stdio.h>
+#include <string.h>
+
+// Chiamata a una funzione utente
+struct effects_call
+{
+    struct effects_func *callee;
+    int in_loop;
+};
+
+// Funzione utente analizzata
+struct effects_func
+{
+    char *name; // chiave della hash table
+    struct AstNode *fdef;
+    int redefined;
+
+    int local;   // effetti del solo corpo
+    int effects; // effetti del corpo e delle funzioni chiamate
+    int size;    // nodi dell'AST del corpo
+
+    char **defined; // parametri, variabili assegnate e variabili dei for
+    int ndefined;
+    int defined_cap;
+
+    struct effects_call *calls;
+    int ncalls;
+    int calls_cap;
+
+    int recursive;
+    int reachable; // chiamata, anche indirettamente, dal programma principale
+    int hot;
+    unsigned pointers; // parametri puntatore (char*, lua_field), un bit per posizione
+    unsigned nonnull;  // parametri puntatore mai NULL nelle chiamate
+    int called;
+
+    char *prefix;
+    char *wrapper_prefix; // senza const e pure, per il wrapper di una funzione memoizzata
+    UT_hash_handle hh;
+};
+
+static struct effects_func *funcs;
+// Chiamate del programma principale
+static struct effects_func main_func;
+static int analyzed;
+
+static void add_defined(struct effects_func *f, char *name)
+{
+    for (int i = 0; i < f->ndefined; i++)
+    {
+        if (strcmp(f->defined[i], name) == 0)
+            return;
+    }
+    if (f->ndefined == f->defined_cap)
+    {
+        f->defined_cap = f->defined_cap ? f->defined_cap * 2 : 8;
+        f->defined = f->defined ? mem_realloc(f->defined, f->defined_cap * sizeof(char *))
+                                : mem_alloc(MEM_AST, f->defined_cap * sizeof(char *));
+    }
+    f->defined[f->ndefined++] = name;
+}
+
+static int is_defined(struct effects_func *f, const char *name)
+{
+    for (int i = 0; i < f->ndefined; i++)
+    {
+        if (strcmp(f->defined[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static void add_call(struct effects_func *f, struct effects_func *callee, int in_loop)
+{
+    if (f->ncalls == f->calls_cap)
+    {
+        f->calls_cap = f->calls_cap ? f->calls_cap * 2 : 4;
+        f->calls = f->calls ? mem_realloc(f->calls, f->calls_cap * sizeof(struct effects_call))
+                            : mem_alloc(MEM_AST, f->calls_cap * sizeof(struct effects_call));
+    }
+    f->calls[f->ncalls].callee = callee;
+    f->calls[f->ncalls].in_loop = in_loop;
+    f->ncalls++;
+}
+
+// Variabili definite nel corpo: in una funzione ogni assegnazione crea una variabile locale
+static void collect_defined(struct effects_func *f, struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        switch (n->nodetype)
+        {
+        case EXPR_T:
+            if (n->node.expr->expr_type == ASS_T && n->node.expr->l && n->node.expr->l->nodetype == VAR_T &&
+                !n->node.expr->l->node.var->table_key)
+                add_defined(f, n->node.expr->l->node.var->name);
+            break;
+        case DECL_T:
+            if (n->node.decl->var && n->node.decl->var->nodetype == VAR_T)
+                add_defined(f, n->node.decl->var->node.var->name);
+            break;
+        case IF_T:
+            collect_defined(f, n->node.ifn->body);
+            collect_defined(f, n->node.ifn->else_body);
+            break;
+        case FOR_T:
+            add_defined(f, n->node.forn->varname);
+            collect_defined(f, n->node.forn->stmt);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// L'argomento non può essere NULL nel C generato: stringa letterale, tabella costruita o array di main
+static int non_null_arg(struct effects_func *f, struct AstNode *arg)
+{
+    if (!arg)
+        return 0;
+    if (arg->nodetype == VAL_T)
+        return arg->node.val->val_type == STRING_T;
+    if (arg->nodetype == TABLE_NODE_T)
+        return 1;
+    if (arg->nodetype == VAR_T && f == &main_func && !arg->node.var->table_key && root_symtab)
+    {
+        struct symbol *sym = find_sym(root_symtab, arg->node.var->name);
+        return sym && sym->sym_type == VARIABLE && sym->type == TABLE_T;
+    }
+    return 0;
+}
+
+static void walk_list(struct effects_func *f, struct AstNode *list, int in_loop);
+
+static void walk(struct effects_func *f, struct AstNode *n, int in_loop)
+{
+    if (!n)
+        return;
+    f->size++;
+
+    switch (n->nodetype)
+    {
+    case VAR_T:
+        if (n->node.var->table_key)
+        {
+            f->local |= EFFECT_READS_GLOBALS;
+            walk(f, n->node.var->table_key, in_loop);
+        }
+        else if (f != &main_func && !is_defined(f, n->node.var->name))
+            f->local |= EFFECT_READS_GLOBALS;
+        break;
+    case TABLE_NODE_T:
+        f->local |= EFFECT_ALLOCATES;
+        walk_list(f, n->node.table->fields, in_loop);
+        break;
+    case TABLE_FIELD_T:
+        walk(f, n->node.tfield->key, in_loop);
+        walk(f, n->node.tfield->value, in_loop);
+        break;
+    case EXPR_T:
+    {
+        struct AstNode *lhs = n->node.expr->l;
+        if (n->node.expr->expr_type == ASS_T && lhs && lhs->nodetype == VAR_T)
+        {
+            if (lhs->node.var->table_key)
+            {
+                f->local |= EFFECT_WRITES_GLOBALS;
+                walk(f, lhs->node.var->table_key, in_loop);
+            }
+        }
+        else
+            walk(f, lhs, in_loop);
+        walk(f, n->node.expr->r, in_loop);
+        break;
+    }
+    case DECL_T:
+        walk(f, n->node.decl->expr, in_loop);
+        break;
+    case RETURN_T:
+        walk(f, n->node.ret->expr, in_loop);
+        break;
+    case FCALL_T:
+    {
+        struct AstNode *callee = n->node.fcall->func_expr;
+        const char *name = callee && callee->nodetype == VAR_T ? callee->node.var->name : NULL;
+        struct effects_func *g = NULL;
+
+        if (name)
+            HASH_FIND_STR(funcs, name, g);
+        if (g)
+        {
+            struct AstNode *arg = n->node.fcall->args;
+            add_call(f, g, in_loop);
+            g->called = 1;
+            for (int i = 0; i < 32; i++, arg = arg ? arg->next : NULL)
+            {
+                if ((g->pointers & (1u << i)) && !non_null_arg(f, arg))
+                    g->nonnull &= ~(1u << i);
+            }
+        }
+        else if (name && strcmp(name, "print") == 0)
+            f->local |= EFFECT_IO;
+        else if (name && strcmp(name, "io.read") == 0)
+            f->local |= EFFECT_IO | EFFECT_ALLOCATES;
+        else
+            f->local |= EFFECT_READS_GLOBALS | EFFECT_WRITES_GLOBALS | EFFECT_IO | EFFECT_ALLOCATES;
+        walk_list(f, n->node.fcall->args, in_loop);
+        break;
+    }
+    case IF_T:
+        walk(f, n->node.ifn->cond, in_loop);
+        walk_list(f, n->node.ifn->body, in_loop);
+        walk_list(f, n->node.ifn->else_body, in_loop);
+        break;
+    case FOR_T:
+        walk(f, n->node.forn->start, in_loop);
+        walk(f, n->node.forn->end, in_loop);
+        walk(f, n->node.forn->step, in_loop);
+        walk_list(f, n->node.forn->stmt, 1);
+        break;
+    default:
+        break;
+    }
+}
+
+static void walk_list(struct effects_func *f, struct AstNode *list, int in_loop)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+        walk(f, n, in_loop);
+}
+
+static int reaches(struct effects_func *from, struct effects_func *target, struct effects_func **seen, int *nseen)
+{
+    for (int i = 0; i < *nseen; i++)
+    {
+        if (seen[i] == from)
+            return 0;
+    }
+    seen[(*nseen)++] = from;
+    for (int i = 0; i < from->ncalls; i++)
+    {
+        if (from->calls[i].callee == target || reaches(from->calls[i].callee, target, seen, nseen))
+            return 1;
+    }
+    return 0;
+}
+
+static void mark_reachable(struct effects_func *f)
+{
+    for (int i = 0; i < f->ncalls; i++)
+    {
+        struct effects_func *g = f->calls[i].callee;
+        if (!g->reachable)
+        {
+            g->reachable = 1;
+            mark_reachable(g);
+        }
+    }
+}
+
+/* Effetti, ricorsione, raggiungibilità e funzioni calde: una funzione è
+   calda se è ricorsiva, se è chiamata dentro un ciclo da codice eseguito o
+   se la chiama una funzione calda.
+*/
+static void propagate(int nfuncs)
+{
+    struct effects_func *f, *tmp;
+    struct effects_func **seen = mem_alloc(MEM_AST, (nfuncs + 1) * sizeof(struct effects_func *));
+    int changed = 1;
+
+    HASH_ITER(hh, funcs, f, tmp)
+    {
+        f->effects = f->local;
+    }
+    while (changed)
+    {
+        changed = 0;
+        HASH_ITER(hh, funcs, f, tmp)
+        {
+            for (int i = 0; i < f->ncalls; i++)
+            {
+                int effects = f->effects | f->calls[i].callee->effects;
+                changed |= effects != f->effects;
+                f->effects = effects;
+            }
+        }
+    }
+
+    mark_reachable(&main_func);
+    HASH_ITER(hh, funcs, f, tmp)
+    {
+        int nseen = 0;
+        f->recursive = reaches(f, f, seen, &nseen);
+        f->hot = f->recursive && f->reachable;
+    }
+    for (int i = 0; i < main_func.ncalls; i++)
+        main_func.calls[i].callee->hot |= main_func.calls[i].in_loop;
+    changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        HASH_ITER(hh, funcs, f, tmp)
+        {
+            if (!f->reachable)
+                continue;
+            for (int i = 0; i < f->ncalls; i++)
+            {
+                struct effects_func *g = f->calls[i].callee;
+                if (!g->hot && (f->hot || f->calls[i].in_loop))
+                {
+                    g->hot = 1;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    mem_free(seen);
+}
+
+static void append_attribute(char *buf, size_t size, const char *attr)
+{
+    size_t len = strlen(buf);
+    snprintf(buf + len, size - len, "%s%s", len ? ", " : "", attr);
+}
+
+// Lunghezza massima della lista di attributi di una funzione, senza const o pure
+#define ATTRS_SIZE 256
+
+// Prefisso di una definizione con gli attributi attrs
+static char *format_prefix(const char *attrs, int is_inline)
+{
+    char prefix[ATTRS_SIZE + 64];
+    if (split_functions)
+    {
+        // Con --split le funzioni sono chiamate da altre unità: niente static
+        if (attrs[0])
+            snprintf(prefix, sizeof(prefix), "__attribute__((%s)) ", attrs);
+        else
+            prefix[0] = '\0';
+    }
+    else if (attrs[0])
+        snprintf(prefix, sizeof(prefix), "static %s__attribute__((%s)) ", is_inline ? "inline " : "", attrs);
+    else
+        snprintf(prefix, sizeof(prefix), "static ");
+    return mem_strdup(MEM_AST, prefix);
+}
+
+/* Attributi della funzione:
+   - const se restituisce un valore, non ha effetti e non riceve puntatori;
+     pure se legge memoria esterna ma non la modifica, non fa I/O e non alloca;
+     mai per le funzioni ricorsive, che potrebbero non terminare: gcc può
+     togliere o spostare una chiamata const o pure il cui valore non serve;
+   - always_inline per le funzioni piccole non ricorsive, noinline per quelle
+     più grandi che fanno I/O, il cui costo è dominato dalla I/O;
+   - hot per le funzioni calde, cold per quelle mai raggiunte da main;
+   - nonnull per i parametri puntatore che nessuna chiamata passa NULL.
+   Il wrapper di memoize scrive nella sua cache: ha gli stessi attributi
+   tranne const e pure.
+*/
+static void build_prefix(struct effects_func *f)
+{
+    char attrs[ATTRS_SIZE] = "";
+    char nonnull[128] = "";
+    const char *purity = NULL;
+    int value = f->fdef->node.fdef->ret_type != NIL_T;
+    int is_inline = 0;
+
+    if (value && !f->recursive)
+    {
+        if (!f->effects && !f->pointers)
+            purity = "const";
+        else if (!(f->effects & (EFFECT_WRITES_GLOBALS | EFFECT_IO | EFFECT_ALLOCATES)))
+            purity = "pure";
+    }
+
+    if (!f->reachable)
+        append_attribute(attrs, sizeof(attrs), "cold");
+    else
+    {
+        if (!f->recursive && f->size <= EFFECTS_INLINE_SIZE)
+        {
+            // Con --split il corpo non è visibile dalle altre unità
+            if (!split_functions)
+                append_attribute(attrs, sizeof(attrs), "always_inline");
+            is_inline = 1;
+        }
+        else if (f->effects & EFFECT_IO)
+            append_attribute(attrs, sizeof(attrs), "noinline");
+        if (f->hot)
+            append_attribute(attrs, sizeof(attrs), "hot");
+    }
+
+    if (f->called && f->nonnull)
+    {
+        for (int i = 0; i < 32; i++)
+        {
+            if (f->nonnull & (1u << i))
+            {
+                size_t len = strlen(nonnull);
+                snprintf(nonnull + len, sizeof(nonnull) - len, "%s%d", len ? ", " : "nonnull(", i + 1);
+            }
+        }
+        strcat(nonnull, ")");
+        append_attribute(attrs, sizeof(attrs), nonnull);
+    }
+
+    f->wrapper_prefix = format_prefix(attrs, is_inline);
+    if (purity)
+    {
+        char all[ATTRS_SIZE + 16];
+        snprintf(all, sizeof(all), "%s%s%s", purity, attrs[0] ? ", " : "", attrs);
+        f->prefix = format_prefix(all, is_inline);
+    }
+    else
+        f->prefix = format_prefix(attrs, is_inline);
+}
+
+/* Analizza le funzioni definite al primo livello del programma e prepara
+   gli attributi. Restituisce il numero di funzioni che ne hanno almeno uno.
+*/
+long effects_ast(struct AstNode *root)
+{
+    struct effects_func *f, *tmp;
+    long annotated = 0;
+    int nfuncs = 0;
+
+    for (struct AstNode *n = root; n; n = n->next)
+    {
+        if (n->nodetype != FDEF_T || !n->node.fdef->name)
+            continue;
+        HASH_FIND_STR(funcs, n->node.fdef->name, f);
+        if (f)
+        {
+            f->redefined = 1;
+            continue;
+        }
+        f = mem_alloc(MEM_AST, sizeof(struct effects_func));
+        memset(f, 0, sizeof(struct effects_func));
+        f->name = n->node.fdef->name;
+        f->fdef = n;
+
+        int i = 0;
+        for (struct AstNode *p = n->node.fdef->params; p; p = p->next, i++)
+        {
+            struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+            enum LUA_TYPE type = param_type(p, root_symtab);
+            if (var->nodetype == VAR_T)
+                add_defined(f, var->node.var->name);
+            if (i < 32 && (type == STRING_T || type == TABLE_T))
+                f->pointers |= 1u << i;
+        }
+        f->nonnull = f->pointers;
+        collect_defined(f, n->node.fdef->code);
+        HASH_ADD_KEYPTR(hh, funcs, f->name, strlen(f->name), f);
+        nfuncs++;
+    }
+
+    for (struct AstNode *n = root; n; n = n->next)
+    {
+        if (n->nodetype != FDEF_T)
+            walk(&main_func, n, 0);
+        else if (n->node.fdef->name)
+        {
+            HASH_FIND_STR(funcs, n->node.fdef->name, f);
+            if (f->fdef == n)
+                walk_list(f, n->node.fdef->code, 0);
+        }
+    }
+    propagate(nfuncs);
+
+    HASH_ITER(hh, funcs, f, tmp)
+    {
+        if (f->redefined)
+            continue;
+        build_prefix(f);
+        annotated += f->prefix[0] && strcmp(f->prefix, "static ") != 0;
+    }
+    analyzed = 1;
+    return annotated;
+}
+
+const char *effects_prefix(const char *name)
+{
+    struct effects_func *f;
+
+    if (!analyzed || !name)
+        return "";
+    HASH_FIND_STR(funcs, name, f);
+    return f && f->prefix ? f->prefix : "";
+}
+
+const char *effects_wrapper_prefix(const char *name)
+{
+    struct effects_func *f;
+
+    if (!analyzed || !name)
+        return "";
+    HASH_FIND_STR(funcs, name, f);
+    return f && f->wrapper_prefix ? f->wrapper_prefix : "";
+}
@@ -0,0 +1,33 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "ast.h"
+
+/* Analisi degli effetti delle funzioni utente sul grafo delle chiamate: per
+   ogni funzione si raccolgono gli effetti del corpo e di tutte le funzioni
+   che chiama, e da questi gli attributi di gcc emessi davanti alle
+   definizioni e ai prototipi nell'header (static, const, pure,
+   always_inline, noinline, hot, cold, nonnull).
+*/
+
+// Effetti di una funzione
+enum EFFECT
+{
+    EFFECT_READS_GLOBALS = 1,  // legge variabili non definite nella funzione o campi di tabelle
+    EFFECT_WRITES_GLOBALS = 2, // assegna campi di tabelle
+    EFFECT_IO = 4,             // print o io.read
+    EFFECT_ALLOCATES = 8       // costruisce tabelle o legge stringhe con io.read
+};
+
+// Nodi dell'AST oltre i quali una funzione non è forzata inline
+#define EFFECTS_INLINE_SIZE 24
+
+long effects_ast(struct AstNode *root);
+
+// Prefisso della definizione o del prototipo ("static __attribute__((...)) "), "" se l'analisi non è attiva
+const char *effects_prefix(const char *name);
+
+// Prefisso del wrapper che memoize mette davanti alla funzione: senza const e pure
+const char *effects_wrapper_prefix(const char *name);
+
+#endif
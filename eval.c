@@ -0,0 +1,681 @@
+#include "eval.h"
+#include "fold.h"
+#include "global.h"
+#include "ir.h"
+#include "symtab.h"
+#include "translate.h"
+#include "mem.h"
+#include <limits.h>
+#include <string.h>
+
+// Variabile locale di una funzione, con il tipo che le dà l'IR (ir_local_type)
+struct eval_var
+{
+    char *name;
+    enum LUA_TYPE type;
+    int closed; // variabile di controllo di un for già concluso
+};
+
+// Funzione utente candidata alla valutazione
+struct eval_func
+{
+    char *name; // chiave della hash table
+    struct AstNode *fdef;
+    int nparams;
+    struct eval_var *vars; // prima i parametri, poi le variabili nell'ordine di assegnazione
+    int nvars;
+    int cap;
+    char **callees; // funzioni utente chiamate dal corpo
+    int ncallees;
+    int callees_cap;
+    int supported; // il corpo usa solo costrutti che l'interprete sa eseguire
+    int pure;
+    UT_hash_handle hh;
+};
+
+static struct eval_func *funcs;
+static long evaluated;
+
+/* Analisi delle funzioni */
+
+static struct eval_var *find_local(struct eval_func *f, const char *name)
+{
+    for (int i = 0; i < f->nvars; i++)
+    {
+        if (strcmp(f->vars[i].name, name) == 0)
+            return &f->vars[i];
+    }
+    return NULL;
+}
+
+static void add_local(struct eval_func *f, char *name, enum LUA_TYPE type)
+{
+    if (f->nvars == f->cap)
+    {
+        f->cap = f->cap ? f->cap * 2 : 8;
+        f->vars = f->vars ? mem_realloc(f->vars, f->cap * sizeof(struct eval_var))
+                          : mem_alloc(MEM_AST, f->cap * sizeof(struct eval_var));
+    }
+    f->vars[f->nvars].name = name;
+    f->vars[f->nvars].type = type;
+    f->vars[f->nvars].closed = 0;
+    f->nvars++;
+}
+
+static void add_callee(struct eval_func *f, char *name)
+{
+    if (f->ncallees == f->callees_cap)
+    {
+        f->callees_cap = f->callees_cap ? f->callees_cap * 2 : 4;
+        f->callees = f->callees ? mem_realloc(f->callees, f->callees_cap * sizeof(char *))
+                                : mem_alloc(MEM_AST, f->callees_cap * sizeof(char *));
+    }
+    f->callees[f->ncallees++] = name;
+}
+
+// Tipi che l'interprete sa rappresentare
+static int value_type(enum LUA_TYPE type)
+{
+    switch (type)
+    {
+    case INT_T:
+    case FLOAT_T:
+    case NUMBER_T:
+    case STRING_T:
+    case BOOLEAN_T:
+    case TRUE_T:
+    case FALSE_T:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Tipo di una chiamata a funzione utente, come lo vede il codice generato
+static enum LUA_TYPE call_type(struct AstNode *n)
+{
+    if (n->node.fcall->return_type != NIL_T)
+        return n->node.fcall->return_type;
+
+    struct symbol *sym = root_symtab ? find_sym(root_symtab, n->node.fcall->func_expr->node.var->name) : NULL;
+    return sym && sym->sym_type == FUNCTION_SYM ? sym->type : USERDATA_T;
+}
+
+/* Tipo statico di un'espressione nel corpo della funzione, calcolato come
+   fa l'IR: le operazioni tra interi restano intere, la divisione e le altre
+   operazioni aritmetiche danno float. ERROR_T se l'espressione usa qualcosa
+   che l'interprete non esegue.
+*/
+static enum LUA_TYPE analyze_expr(struct eval_func *f, struct AstNode *n)
+{
+    if (!n)
+        return ERROR_T;
+
+    switch (n->nodetype)
+    {
+    case VAL_T:
+    {
+        enum LUA_TYPE t = n->node.val->val_type;
+        if (t == TRUE_T || t == FALSE_T)
+            return BOOLEAN_T;
+        return value_type(t) ? t : ERROR_T;
+    }
+    case VAR_T:
+    {
+        // Una variabile letta prima della sua assegnazione non ha un tipo nell'IR
+        struct eval_var *var = n->node.var->table_key ? NULL : find_local(f, n->node.var->name);
+        return var && !var->closed ? var->type : ERROR_T;
+    }
+    case FCALL_T:
+    {
+        struct AstNode *callee = n->node.fcall->func_expr;
+        if (callee->nodetype != VAR_T || strcmp(callee->node.var->name, "print") == 0 ||
+            strcmp(callee->node.var->name, "io.read") == 0)
+            return ERROR_T;
+        for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+        {
+            if (analyze_expr(f, arg) == ERROR_T)
+                return ERROR_T;
+        }
+        add_callee(f, callee->node.var->name);
+        enum LUA_TYPE t = call_type(n);
+        return value_type(t) ? t : ERROR_T;
+    }
+    case EXPR_T:
+        break;
+    default:
+        return ERROR_T;
+    }
+
+    struct expression *e = n->node.expr;
+    enum LUA_TYPE l, r;
+    switch (e->expr_type)
+    {
+    case ASS_T:
+        return ERROR_T;
+    case PAR_T:
+    case NEG_T:
+        return analyze_expr(f, e->r);
+    case NOT_T:
+        return analyze_expr(f, e->r) == ERROR_T ? ERROR_T : BOOLEAN_T;
+    default:
+        l = analyze_expr(f, e->l);
+        r = analyze_expr(f, e->r);
+        if (l == ERROR_T || r == ERROR_T)
+            return ERROR_T;
+        switch (e->expr_type)
+        {
+        case ADD_T:
+        case SUB_T:
+        case MUL_T:
+            return l == INT_T && r == INT_T ? INT_T : NUMBER_T;
+        case DIV_T:
+            return NUMBER_T;
+        default:
+            return BOOLEAN_T;
+        }
+    }
+}
+
+// Il passo del for deve essere un intero letterale, eventualmente negato
+static int for_step(struct forNode *forn, long long *value)
+{
+    struct AstNode *lit = forn->step;
+    int sign = 1;
+    struct const_value c;
+
+    if (!lit)
+    {
+        *value = 1;
+        return 1;
+    }
+    if (lit->nodetype == EXPR_T)
+    {
+        lit = lit->node.expr->r;
+        sign = -1;
+    }
+    if (lit->nodetype != VAL_T || lit->node.val->val_type != INT_T ||
+        !const_parse(INT_T, lit->node.val->string_val, &c) || c.i == 0)
+        return 0;
+    *value = sign * c.i;
+    return 1;
+}
+
+static int analyze_statements(struct eval_func *f, struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        switch (n->nodetype)
+        {
+        case EXPR_T:
+        {
+            struct AstNode *lhs = n->node.expr->l;
+            if (n->node.expr->expr_type != ASS_T || !lhs || lhs->nodetype != VAR_T || lhs->node.var->table_key)
+                return 0;
+            enum LUA_TYPE t = analyze_expr(f, n->node.expr->r);
+            struct eval_var *var = find_local(f, lhs->node.var->name);
+            if (t == ERROR_T || (var && var->closed))
+                return 0;
+            if (!var)
+                add_local(f, lhs->node.var->name, t == TRUE_T || t == FALSE_T ? BOOLEAN_T : ir_local_type(n->node.expr->r, t));
+            break;
+        }
+        case FCALL_T:
+            if (analyze_expr(f, n) == ERROR_T)
+                return 0;
+            break;
+        case RETURN_T:
+            if (!n->node.ret->expr || analyze_expr(f, n->node.ret->expr) == ERROR_T)
+                return 0;
+            break;
+        case IF_T:
+            if (analyze_expr(f, n->node.ifn->cond) == ERROR_T || !analyze_statements(f, n->node.ifn->body) ||
+                !analyze_statements(f, n->node.ifn->else_body))
+                return 0;
+            break;
+        case FOR_T:
+        {
+            // La variabile di controllo non deve nasconderne un'altra né essere usata dopo il ciclo
+            // (due cicli in sequenza possono riusare lo stesso nome)
+            struct forNode *forn = n->node.forn;
+            struct eval_var *var = find_local(f, forn->varname);
+            long long step_value;
+            if (!forn->start || !forn->end || analyze_expr(f, forn->start) == ERROR_T ||
+                analyze_expr(f, forn->end) == ERROR_T || !for_step(forn, &step_value) || (var && !var->closed))
+                return 0;
+            if (!var)
+                add_local(f, forn->varname, INT_T);
+            int index = var ? (int)(var - f->vars) : f->nvars - 1;
+            f->vars[index].closed = 0;
+            if (!analyze_statements(f, forn->stmt))
+                return 0;
+            f->vars[index].closed = 1;
+            break;
+        }
+        default:
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void analyze_function(struct eval_func *f)
+{
+    struct funcDef *fdef = f->fdef->node.fdef;
+
+    if (!value_type(fdef->ret_type))
+        return;
+    for (struct AstNode *p = fdef->params; p; p = p->next)
+    {
+        struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+        enum LUA_TYPE t = param_type(p, root_symtab);
+        if (var->nodetype != VAR_T || !value_type(t) || find_local(f, var->node.var->name))
+            return;
+        add_local(f, var->node.var->name, t == TRUE_T || t == FALSE_T ? BOOLEAN_T : t);
+    }
+    f->nparams = f->nvars;
+    f->supported = analyze_statements(f, fdef->code);
+}
+
+/* Una funzione è pura se è eseguibile e tutte le funzioni che chiama lo
+   sono. Si parte assumendo pure tutte quelle eseguibili, così le funzioni
+   ricorsive restano pure, e si tolgono finché non cambia più niente.
+*/
+static void compute_purity()
+{
+    struct eval_func *f, *tmp;
+    int changed = 1;
+
+    HASH_ITER(hh, funcs, f, tmp)
+    {
+        f->pure = f->supported;
+    }
+    while (changed)
+    {
+        changed = 0;
+        HASH_ITER(hh, funcs, f, tmp)
+        {
+            for (int i = 0; f->pure && i < f->ncallees; i++)
+            {
+                struct eval_func *callee;
+                HASH_FIND_STR(funcs, f->callees[i], callee);
+                if (!callee || !callee->pure)
+                {
+                    f->pure = 0;
+                    changed = 1;
+                }
+            }
+        }
+    }
+}
+
+/* Interprete */
+
+enum EVAL_RESULT
+{
+    EVAL_NEXT,
+    EVAL_RETURN,
+    EVAL_FAIL
+};
+
+struct frame
+{
+    struct eval_func *f;
+    struct const_value *values;
+    char *defined;
+    struct const_value ret;
+};
+
+static long steps;      // passi rimasti per la chiamata in corso
+static long total_steps; // passi rimasti per l'intero programma
+static int depth;
+static size_t frame_bytes;
+
+static int call(struct eval_func *f, struct const_value *args, int nargs, struct const_value *out);
+
+static int step()
+{
+    if (steps <= 0 || total_steps <= 0)
+        return 0;
+    steps--;
+    total_steps--;
+    return 1;
+}
+
+static int local_index(struct frame *fr, const char *name)
+{
+    for (int i = 0; fr && i < fr->f->nvars; i++)
+    {
+        if (strcmp(fr->f->vars[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int eval_expr(struct frame *fr, struct AstNode *n, struct const_value *out);
+
+// Valuta gli argomenti e chiama la funzione; senza record di attivazione sono ammessi solo argomenti costanti
+static int eval_call(struct frame *fr, struct AstNode *n, struct const_value *out)
+{
+    struct eval_func *f;
+    struct const_value args[16];
+    int nargs = 0;
+
+    HASH_FIND_STR(funcs, n->node.fcall->func_expr->node.var->name, f);
+    if (!f || !f->pure)
+        return 0;
+    for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+    {
+        if (nargs == 16 || !eval_expr(fr, arg, &args[nargs++]))
+            return 0;
+    }
+
+    struct const_value result;
+    if (!call(f, args, nargs, &result))
+        return 0;
+    // Il valore arriva al chiamante con il tipo della chiamata
+    enum LUA_TYPE t = call_type(n);
+    return const_convert(&result, t == TRUE_T || t == FALSE_T ? BOOLEAN_T : t, out);
+}
+
+static int eval_expr(struct frame *fr, struct AstNode *n, struct const_value *out)
+{
+    struct const_value l, r;
+    int truth;
+
+    if (!step())
+        return 0;
+
+    switch (n->nodetype)
+    {
+    case VAL_T:
+        return const_parse(n->node.val->val_type, n->node.val->string_val, out);
+    case VAR_T:
+    {
+        int i = local_index(fr, n->node.var->name);
+        if (i < 0 || !fr->defined[i])
+            return 0;
+        *out = fr->values[i];
+        return 1;
+    }
+    case FCALL_T:
+        return n->node.fcall->func_expr->nodetype == VAR_T && eval_call(fr, n, out);
+    case EXPR_T:
+        break;
+    default:
+        return 0;
+    }
+
+    struct expression *e = n->node.expr;
+    switch (e->expr_type)
+    {
+    case ASS_T:
+        return 0;
+    case PAR_T:
+    case NEG_T:
+    case NOT_T:
+        return eval_expr(fr, e->r, &r) && const_unary(e->expr_type, &r, out);
+    case AND_T:
+    case OR_T:
+        // Cortocircuito come in C: il secondo operando può non essere valutabile
+        if (!eval_expr(fr, e->l, &l) || !const_truth(&l, &truth))
+            return 0;
+        if (truth == (e->expr_type == OR_T))
+            return const_unary(PAR_T, &l, out);
+        return eval_expr(fr, e->r, &r) && const_binary(e->expr_type, &l, &r, out);
+    default:
+        return eval_expr(fr, e->l, &l) && eval_expr(fr, e->r, &r) && const_binary(e->expr_type, &l, &r, out);
+    }
+}
+
+static int assign(struct frame *fr, const char *name, const struct const_value *v)
+{
+    int i = local_index(fr, name);
+    if (i < 0 || !const_convert(v, fr->f->vars[i].type, &fr->values[i]))
+        return 0;
+    fr->defined[i] = 1;
+    return 1;
+}
+
+static enum EVAL_RESULT eval_statements(struct frame *fr, struct AstNode *list);
+
+static enum EVAL_RESULT eval_for(struct frame *fr, struct forNode *forn)
+{
+    struct const_value start, end, cond;
+    long long step_value;
+    int i = local_index(fr, forn->varname);
+
+    // Il limite è valutato una sola volta, come nell'IR
+    if (!for_step(forn, &step_value) || !eval_expr(fr, forn->start, &start) || !eval_expr(fr, forn->end, &end) ||
+        !assign(fr, forn->varname, &start))
+        return EVAL_FAIL;
+
+    for (;;)
+    {
+        if (!const_binary(step_value > 0 ? LE_T : GE_T, &fr->values[i], &end, &cond))
+            return EVAL_FAIL;
+        if (!cond.b)
+            return EVAL_NEXT;
+
+        enum EVAL_RESULT res = eval_statements(fr, forn->stmt);
+        if (res != EVAL_NEXT)
+            return res;
+
+        long long next = fr->values[i].i + step_value;
+        if (next < INT_MIN || next > INT_MAX || !step())
+            return EVAL_FAIL;
+        fr->values[i].i = next;
+    }
+}
+
+static enum EVAL_RESULT eval_statements(struct frame *fr, struct AstNode *list)
+{
+    struct const_value v;
+    int truth;
+    enum EVAL_RESULT res;
+
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        if (!step())
+            return EVAL_FAIL;
+
+        switch (n->nodetype)
+        {
+        case EXPR_T:
+            if (!eval_expr(fr, n->node.expr->r, &v) || !assign(fr, n->node.expr->l->node.var->name, &v))
+                return EVAL_FAIL;
+            break;
+        case FCALL_T:
+            if (!eval_expr(fr, n, &v))
+                return EVAL_FAIL;
+            break;
+        case RETURN_T:
+            if (!eval_expr(fr, n->node.ret->expr, &fr->ret))
+                return EVAL_FAIL;
+            return EVAL_RETURN;
+        case IF_T:
+            if (!eval_expr(fr, n->node.ifn->cond, &v) || !const_truth(&v, &truth))
+                return EVAL_FAIL;
+            res = eval_statements(fr, truth ? n->node.ifn->body : n->node.ifn->else_body);
+            if (res != EVAL_NEXT)
+                return res;
+            break;
+        case FOR_T:
+            res = eval_for(fr, n->node.forn);
+            if (res != EVAL_NEXT)
+                return res;
+            break;
+        default:
+            return EVAL_FAIL;
+        }
+    }
+    return EVAL_NEXT;
+}
+
+/* Esegue la funzione con argomenti già valutati. Gli argomenti sono
+   convertiti al tipo dei parametri e il risultato al tipo di ritorno,
+   come fanno le conversioni implicite del C.
+*/
+static int call(struct eval_func *f, struct const_value *args, int nargs, struct const_value *out)
+{
+    size_t size = f->nvars * (sizeof(struct const_value) + 1);
+    if (nargs != f->nparams || depth >= EVAL_MAX_DEPTH || frame_bytes + size > EVAL_MAX_BYTES)
+        return 0;
+
+    struct frame fr;
+    fr.f = f;
+    fr.values = mem_alloc(MEM_AST, size + 1);
+    fr.defined = (char *)(fr.values + f->nvars);
+    memset(fr.defined, 0, f->nvars);
+    frame_bytes += size;
+    depth++;
+
+    int ok = 1;
+    for (int i = 0; ok && i < nargs; i++)
+        ok = assign(&fr, f->vars[i].name, &args[i]);
+    // Una funzione che termina senza return non ha un valore utilizzabile nel C generato
+    ok = ok && eval_statements(&fr, f->fdef->node.fdef->code) == EVAL_RETURN &&
+         const_convert(&fr.ret, f->fdef->node.fdef->ret_type, out);
+
+    depth--;
+    frame_bytes -= size;
+    mem_free(fr.values);
+    return ok;
+}
+
+/* Sostituzione delle chiamate */
+
+static void eval_list(struct AstNode *list);
+
+// Prova a valutare le chiamate contenute nell'espressione, dalla più esterna
+static void eval_in_expr(struct AstNode *n)
+{
+    struct const_value v;
+
+    if (!n)
+        return;
+
+    switch (n->nodetype)
+    {
+    case FCALL_T:
+    {
+        struct AstNode *callee = n->node.fcall->func_expr;
+        if (callee->nodetype != VAR_T)
+            return;
+        if (strcmp(callee->node.var->name, "io.read") == 0)
+            return;
+        if (strcmp(callee->node.var->name, "print") != 0)
+        {
+            enum LUA_TYPE t = call_type(n);
+            steps = EVAL_CALL_STEPS;
+            if (value_type(t) && eval_call(NULL, n, &v))
+            {
+                const_to_node(n, t, &v);
+                evaluated++;
+                return;
+            }
+        }
+        for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+            eval_in_expr(arg);
+        break;
+    }
+    case EXPR_T:
+        eval_in_expr(n->node.expr->l);
+        eval_in_expr(n->node.expr->r);
+        break;
+    case TABLE_NODE_T:
+        for (struct AstNode *f = n->node.table->fields; f; f = f->next)
+        {
+            if (f->nodetype == TABLE_FIELD_T)
+                eval_in_expr(f->node.tfield->value);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void eval_statement(struct AstNode *n)
+{
+    switch (n->nodetype)
+    {
+    case EXPR_T:
+        eval_in_expr(n->node.expr->r);
+        break;
+    case FCALL_T:
+        // Una chiamata usata come istruzione non ha un risultato da sostituire
+        for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+            eval_in_expr(arg);
+        break;
+    case RETURN_T:
+        eval_in_expr(n->node.ret->expr);
+        break;
+    case IF_T:
+        eval_in_expr(n->node.ifn->cond);
+        eval_list(n->node.ifn->body);
+        eval_list(n->node.ifn->else_body);
+        break;
+    case FOR_T:
+        eval_in_expr(n->node.forn->start);
+        eval_in_expr(n->node.forn->end);
+        eval_list(n->node.forn->stmt);
+        break;
+    case FDEF_T:
+        eval_list(n->node.fdef->code);
+        break;
+    default:
+        break;
+    }
+}
+
+static void eval_list(struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+        eval_statement(n);
+}
+
+static void free_funcs()
+{
+    struct eval_func *f, *tmp;
+    HASH_ITER(hh, funcs, f, tmp)
+    {
+        HASH_DEL(funcs, f);
+        if (f->vars)
+            mem_free(f->vars);
+        if (f->callees)
+            mem_free(f->callees);
+        mem_free(f);
+    }
+}
+
+long eval_ast(struct AstNode *root)
+{
+    struct eval_func *f;
+
+    evaluated = 0;
+    total_steps = EVAL_TOTAL_STEPS;
+
+    for (struct AstNode *n = root; n; n = n->next)
+    {
+        if (n->nodetype != FDEF_T || !n->node.fdef->name)
+            continue;
+        HASH_FIND_STR(funcs, n->node.fdef->name, f);
+        if (f)
+        {
+            // Funzione ridefinita: quale definizione valga dipende dall'ordine di esecuzione
+            f->supported = 0;
+            continue;
+        }
+        f = mem_alloc(MEM_AST, sizeof(struct eval_func));
+        memset(f, 0, sizeof(struct eval_func));
+        f->name = n->node.fdef->name;
+        f->fdef = n;
+        HASH_ADD_KEYPTR(hh, funcs, f->name, strlen(f->name), f);
+        analyze_function(f);
+    }
+    compute_purity();
+
+    eval_list(root);
+    free_funcs();
+    return evaluated;
+}
@@ -0,0 +1,26 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "ast.h"
+
+/* Valutazione parziale: le chiamate a funzioni pure con argomenti costanti
+   vengono eseguite a tempo di traduzione e sostituite dal loro risultato.
+   Una funzione è pura se non chiama print o io.read, non usa tabelle e
+   chiama solo funzioni pure. L'esecuzione segue i tipi del C generato
+   dall'IR (variabili tipate alla prima assegnazione, int e float del C) ed
+   è limitata da un budget di passi, di profondità di ricorsione e di
+   memoria: se uno dei limiti viene superato, o se il risultato
+   dipenderebbe da un errore a runtime, la chiamata resta com'è.
+*/
+
+// Passi massimi per una singola chiamata e per l'intero programma
+#define EVAL_CALL_STEPS 100000
+#define EVAL_TOTAL_STEPS 10000000
+// Profondità massima delle chiamate annidate
+#define EVAL_MAX_DEPTH 200
+// Byte massimi occupati dai record di attivazione
+#define EVAL_MAX_BYTES (1 << 20)
+
+long eval_ast(struct AstNode *root);
+
+#endif
@@ -0,0 +1,210 @@
+#include "fastscan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTSCAN_X86 1
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define FASTSCAN_AVX2 1
+#endif
+#endif
+
+// Implementazioni disponibili
+enum FASTSCAN_IMPL
+{
+    IMPL_UNSET,
+    IMPL_SCALAR,
+    IMPL_SSE2,
+    IMPL_AVX2
+};
+
+static enum FASTSCAN_IMPL impl = IMPL_UNSET;
+
+/* Versioni scalari, usate come fallback e per le code dei buffer */
+
+static const char *find3_scalar(const char *p, const char *end, char a, char b, char c)
+{
+    while (p < end && *p != a && *p != b && *p != c)
+    {
+        p++;
+    }
+    return p;
+}
+
+static size_t count_newlines_scalar(const char *p, const char *end)
+{
+    size_t n = 0;
+    while (p < end)
+    {
+        if (*p++ == '\n')
+            n++;
+    }
+    return n;
+}
+
+#ifdef FASTSCAN_X86
+
+/* Versioni SSE2: confrontano 16 byte alla volta e usano la movemask
+   per individuare la prima occorrenza o contare le occorrenze
+*/
+
+__attribute__((target("sse2"))) static const char *find3_sse2(const char *p, const char *end, char a, char b, char c)
+{
+    __m128i va = _mm_set1_epi8(a);
+    __m128i vb = _mm_set1_epi8(b);
+    __m128i vc = _mm_set1_epi8(c);
+
+    while (end - p >= 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)), _mm_cmpeq_epi8(x, vc));
+        int mask = _mm_movemask_epi8(m);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return find3_scalar(p, end, a, b, c);
+}
+
+__attribute__((target("sse2"))) static size_t count_newlines_sse2(const char *p, const char *end)
+{
+    __m128i nl = _mm_set1_epi8('\n');
+    size_t n = 0;
+
+    while (end - p >= 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(x, nl)));
+        p += 16;
+    }
+    return n + count_newlines_scalar(p, end);
+}
+
+#endif
+
+#ifdef FASTSCAN_AVX2
+
+/* Versioni AVX2: come le SSE2 ma su blocchi da 32 byte */
+
+__attribute__((target("avx2"))) static const char *find3_avx2(const char *p, const char *end, char a, char b, char c)
+{
+    __m256i va = _mm256_set1_epi8(a);
+    __m256i vb = _mm256_set1_epi8(b);
+    __m256i vc = _mm256_set1_epi8(c);
+
+    while (end - p >= 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)),
+                                    _mm256_cmpeq_epi8(x, vc));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return find3_sse2(p, end, a, b, c);
+}
+
+__attribute__((target("avx2"))) static size_t count_newlines_avx2(const char *p, const char *end)
+{
+    __m256i nl = _mm256_set1_epi8('\n');
+    size_t n = 0;
+
+    while (end - p >= 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        n += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, nl)));
+        p += 32;
+    }
+    return n + count_newlines_sse2(p, end);
+}
+
+#endif
+
+// Sceglie l'implementazione migliore supportata dalla CPU, salvo override da ambiente
+static void fastscan_init(void)
+{
+    const char *forced = getenv("LUA2C_SIMD");
+
+    impl = IMPL_SCALAR;
+#ifdef FASTSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        impl = IMPL_SSE2;
+#ifdef FASTSCAN_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        impl = IMPL_AVX2;
+#endif
+#endif
+
+    if (forced)
+    {
+        // L'override può solo abbassare il livello, mai selezionare istruzioni non supportate
+        if (strcmp(forced, "scalar") == 0)
+            impl = IMPL_SCALAR;
+        else if (strcmp(forced, "sse2") == 0 && impl > IMPL_SSE2)
+            impl = IMPL_SSE2;
+    }
+}
+
+const char *fastscan_impl_name(void)
+{
+    if (impl == IMPL_UNSET)
+        fastscan_init();
+
+    switch (impl)
+    {
+    case IMPL_AVX2:
+        return "avx2";
+    case IMPL_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+const char *fast_find3(const char *p, const char *end, char a, char b, char c)
+{
+    if (impl == IMPL_UNSET)
+        fastscan_init();
+
+    switch (impl)
+    {
+#ifdef FASTSCAN_AVX2
+    case IMPL_AVX2:
+        return find3_avx2(p, end, a, b, c);
+#endif
+#ifdef FASTSCAN_X86
+    case IMPL_SSE2:
+        return find3_sse2(p, end, a, b, c);
+#endif
+    default:
+        return find3_scalar(p, end, a, b, c);
+    }
+}
+
+const char *fast_find1(const char *p, const char *end, char a)
+{
+    return fast_find3(p, end, a, a, a);
+}
+
+size_t fast_count_newlines(const char *p, const char *end)
+{
+    if (impl == IMPL_UNSET)
+        fastscan_init();
+
+    switch (impl)
+    {
+#ifdef FASTSCAN_AVX2
+    case IMPL_AVX2:
+        return count_newlines_avx2(p, end);
+#endif
+#ifdef FASTSCAN_X86
+    case IMPL_SSE2:
+        return count_newlines_sse2(p, end);
+#endif
+    default:
+        return count_newlines_scalar(p, end);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef FASTSCAN_H
+#define FASTSCAN_H
+
+#include <stddef.h>
+
+/* Primitive di scansione veloce usate dallo scanner per saltare commenti
+   e corpi di stringa. L'implementazione (AVX2, SSE2 o scalare) viene scelta
+   a runtime in base alla CPU; la variabile d'ambiente LUA2C_SIMD
+   (valori: avx2, sse2, scalar) permette di forzarne una.
+*/
+
+// Restituisce il nome dell'implementazione selezionata
+const char *fastscan_impl_name(void);
+
+// Primo byte in [p, end) uguale ad a, b o c; end se non presente
+const char *fast_find3(const char *p, const char *end, char a, char b, char c);
+
+// Primo byte in [p, end) uguale ad a; end se non presente
+const char *fast_find1(const char *p, const char *end, char a);
+
+// Numero di '\n' presenti in [p, end)
+size_t fast_count_newlines(const char *p, const char *end);
+
+#endif
@@ -0,0 +1,480 @@
+#include "fold.h"
+#include "semantic.h"
+#include "mem.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Valutazione delle costanti */
+
+static int is_number(const struct const_value *c)
+{
+    return c->type == INT_T || c->type == FLOAT_T;
+}
+
+static double as_double(const struct const_value *c)
+{
+    return c->type == INT_T ? (double)c->i : c->f;
+}
+
+/* Valore di un operando convertito come fa il C nelle operazioni miste:
+   verso double se wide, altrimenti verso float (un int diventa float).
+*/
+static double as_c(const struct const_value *c, int wide)
+{
+    return wide ? as_double(c) : (double)(float)as_double(c);
+}
+
+// Tipo C dell'operazione tra l e r: 1 double, 0 float (almeno un float), -1 tra interi
+static int c_precision(const struct const_value *l, const struct const_value *r)
+{
+    if ((l->type == FLOAT_T && l->wide) || (r->type == FLOAT_T && r->wide))
+        return 1;
+    return l->type == FLOAT_T || r->type == FLOAT_T ? 0 : -1;
+}
+
+static int make_int(long long i, struct const_value *out)
+{
+    // Il C generato usa int: un risultato fuori intervallo va lasciato al runtime
+    if (i < INT_MIN || i > INT_MAX)
+        return 0;
+    out->type = INT_T;
+    out->i = i;
+    return 1;
+}
+
+// Numero non intero: double del C se wide, altrimenti arrotondato a float
+static int make_float(double f, int wide, struct const_value *out)
+{
+    double v = wide ? f : (double)(float)f;
+    if (!isfinite(v))
+        return 0;
+    out->type = FLOAT_T;
+    out->f = v;
+    out->wide = wide;
+    return 1;
+}
+
+static int make_bool(int b, struct const_value *out)
+{
+    out->type = BOOLEAN_T;
+    out->b = b != 0;
+    return 1;
+}
+
+/* Legge un letterale. Per le stringhe text è il contenuto senza virgolette,
+   come in string_val; per nil può essere NULL.
+*/
+int const_parse(enum LUA_TYPE type, const char *text, struct const_value *out)
+{
+    char *end;
+
+    memset(out, 0, sizeof(struct const_value));
+    switch (type)
+    {
+    case NIL_T:
+        out->type = NIL_T;
+        return 1;
+    case TRUE_T:
+    case FALSE_T:
+        return make_bool(type == TRUE_T, out);
+    case BOOLEAN_T:
+        if (!text || (strcmp(text, "true") != 0 && strcmp(text, "false") != 0))
+            return 0;
+        return make_bool(text[0] == 't', out);
+    case INT_T:
+        if (!text)
+            return 0;
+        out->i = strtoll(text, &end, 0);
+        return *end == '\0' && make_int(out->i, out);
+    case FLOAT_T:
+    case NUMBER_T:
+        if (!text)
+            return 0;
+        // Come nel C: un testo intero è un int, il suffisso f un float, il resto un double
+        out->i = strtoll(text, &end, 10);
+        if (*end == '\0')
+            return make_int(out->i, out);
+        out->f = strtod(text, &end);
+        if ((*end == 'f' || *end == 'F') && end[1] == '\0')
+            return make_float(out->f, 0, out);
+        return *end == '\0' && make_float(out->f, 1, out);
+    case STRING_T:
+        // Le sequenze di escape renderebbero inaffidabile il confronto sul testo
+        if (!text || strchr(text, '\\'))
+            return 0;
+        out->type = STRING_T;
+        out->s = text;
+        out->len = strlen(text);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Legge il testo C di una costante dell'IR: stringhe tra virgolette, nil come NULL
+int const_parse_c(enum LUA_TYPE type, const char *text, struct const_value *out)
+{
+    if (type != STRING_T)
+        return const_parse(type, strcmp(text, "NULL") == 0 ? NULL : text, out);
+
+    int len = strlen(text);
+    if (len < 2 || text[0] != '"' || memchr(text + 1, '\\', len - 2))
+        return 0;
+    memset(out, 0, sizeof(struct const_value));
+    out->type = STRING_T;
+    out->s = text + 1;
+    out->len = len - 2;
+    return 1;
+}
+
+// Verità di una costante, solo per booleani e nil: per gli altri tipi Lua e il C generato non concordano
+int const_truth(const struct const_value *a, int *truth)
+{
+    if (a->type == NIL_T)
+        *truth = 0;
+    else if (a->type == BOOLEAN_T)
+        *truth = a->b;
+    else
+        return 0;
+    return 1;
+}
+
+int const_unary(enum EXPRESSION_TYPE op, const struct const_value *a, struct const_value *out)
+{
+    int truth;
+
+    switch (op)
+    {
+    case NEG_T:
+        if (a->type == INT_T)
+            return make_int(-a->i, out);
+        if (a->type == FLOAT_T)
+            return make_float(-a->f, a->wide, out);
+        return 0;
+    case NOT_T:
+        return const_truth(a, &truth) && make_bool(!truth, out);
+    case PAR_T:
+        *out = *a;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int const_equal(const struct const_value *l, const struct const_value *r)
+{
+    if (is_number(l) && is_number(r))
+    {
+        int wide = c_precision(l, r);
+        return wide < 0 ? l->i == r->i : as_c(l, wide) == as_c(r, wide);
+    }
+    if (l->type != r->type)
+        return 0;
+    switch (l->type)
+    {
+    case NIL_T:
+        return 1;
+    case BOOLEAN_T:
+        return l->b == r->b;
+    case STRING_T:
+        return l->len == r->len && memcmp(l->s, r->s, l->len) == 0;
+    default:
+        return 0;
+    }
+}
+
+int const_binary(enum EXPRESSION_TYPE op, const struct const_value *l, const struct const_value *r,
+                 struct const_value *out)
+{
+    int lt, rt, cmp, wide;
+
+    memset(out, 0, sizeof(struct const_value));
+    switch (op)
+    {
+    case ADD_T:
+    case SUB_T:
+    case MUL_T:
+        if (!is_number(l) || !is_number(r))
+            return 0;
+        if (l->type == INT_T && r->type == INT_T)
+        {
+            long long v = op == ADD_T ? l->i + r->i : op == SUB_T ? l->i - r->i : l->i * r->i;
+            return make_int(v, out);
+        }
+        else
+        {
+            // Calcolata in double e arrotondata: per +, - e * tra float il risultato è quello del float
+            wide = c_precision(l, r);
+            double v = op == ADD_T   ? as_c(l, wide) + as_c(r, wide)
+                       : op == SUB_T ? as_c(l, wide) - as_c(r, wide)
+                                     : as_c(l, wide) * as_c(r, wide);
+            return make_float(v, wide, out);
+        }
+    case DIV_T:
+        // In Lua / è sempre una divisione in virgola mobile: tra interi il C generato la fa in float
+        if (!is_number(l) || !is_number(r) || as_double(r) == 0)
+            return 0;
+        wide = c_precision(l, r) > 0;
+        return make_float(as_c(l, wide) / as_c(r, wide), wide, out);
+    case AND_T:
+    case OR_T:
+        if (!const_truth(l, &lt) || !const_truth(r, &rt))
+            return 0;
+        return make_bool(op == AND_T ? lt && rt : lt || rt, out);
+    case EQ_T:
+        return make_bool(const_equal(l, r), out);
+    case NE_T:
+        return make_bool(!const_equal(l, r), out);
+    case G_T:
+    case GE_T:
+    case L_T:
+    case LE_T:
+        // Tra stringhe il C generato confronta i puntatori e non il contenuto come
+        // Lua: il risultato dipende da dove il compilatore mette i letterali
+        if (!is_number(l) || !is_number(r))
+            return 0;
+        wide = c_precision(l, r);
+        if (wide < 0)
+            cmp = l->i < r->i ? -1 : l->i > r->i;
+        else
+            cmp = as_c(l, wide) < as_c(r, wide) ? -1 : as_c(l, wide) > as_c(r, wide);
+        return make_bool(op == G_T ? cmp > 0 : op == GE_T ? cmp >= 0 : op == L_T ? cmp < 0 : cmp <= 0, out);
+    default:
+        return 0;
+    }
+}
+
+// Conversione implicita del C verso il tipo di una variabile
+int const_convert(const struct const_value *a, enum LUA_TYPE type, struct const_value *out)
+{
+    switch (type)
+    {
+    case INT_T:
+        if (a->type == INT_T)
+            break;
+        if (a->type == FLOAT_T && a->f > INT_MIN - 1.0 && a->f < INT_MAX + 1.0)
+            return make_int((long long)a->f, out);
+        return 0;
+    case FLOAT_T:
+    case NUMBER_T:
+        // Le variabili numeriche del C generato sono float
+        if (!is_number(a))
+            return 0;
+        return make_float(as_double(a), 0, out);
+    case BOOLEAN_T:
+    case TRUE_T:
+    case FALSE_T:
+        if (a->type != BOOLEAN_T)
+            return 0;
+        break;
+    default:
+        if (a->type != type)
+            return 0;
+        break;
+    }
+    *out = *a;
+    return 1;
+}
+
+/* Testo C della costante. I numeri non interi usano la rappresentazione
+   più corta che riletta dà lo stesso valore, sempre con il punto decimale
+   e con il suffisso f se nel C generato sono float.
+*/
+char *const_to_text(const struct const_value *c, enum MEM_SUBSYSTEM sub)
+{
+    char buf[64];
+
+    switch (c->type)
+    {
+    case INT_T:
+        snprintf(buf, sizeof(buf), "%lld", c->i);
+        break;
+    case FLOAT_T:
+        for (int precision = c->wide ? 15 : 6; precision <= (c->wide ? 17 : 9); precision++)
+        {
+            snprintf(buf, sizeof(buf), "%.*g", precision, c->f);
+            if (c->wide ? strtod(buf, NULL) == c->f : strtof(buf, NULL) == (float)c->f)
+                break;
+        }
+        if (!strpbrk(buf, ".e"))
+            strcat(buf, ".0");
+        if (!c->wide)
+            strcat(buf, "f");
+        break;
+    case BOOLEAN_T:
+        return mem_strdup(sub, c->b ? "true" : "false");
+    case STRING_T:
+    {
+        char *s = mem_alloc(sub, c->len + 3);
+        sprintf(s, "\"%.*s\"", c->len, c->s);
+        return s;
+    }
+    default:
+        return mem_strdup(sub, "NULL");
+    }
+    return mem_strdup(sub, buf);
+}
+
+// Sostituisce sul posto l'espressione con un letterale, mantenendo il collegamento next
+void const_to_node(struct AstNode *n, enum LUA_TYPE type, const struct const_value *c)
+{
+    // Un risultato intero resta un int nel C anche se il tipo del nodo è NUMBER_T
+    struct const_value v = *c;
+    if (v.type == BOOLEAN_T)
+        type = v.b ? TRUE_T : FALSE_T;
+
+    char *text;
+    if (v.type == STRING_T)
+    {
+        // string_val contiene la stringa senza virgolette
+        text = mem_alloc(MEM_AST, v.len + 1);
+        memcpy(text, v.s, v.len);
+        text[v.len] = '\0';
+    }
+    else if (v.type == NIL_T)
+        text = mem_strdup(MEM_AST, "nil");
+    else
+        text = const_to_text(&v, MEM_AST);
+
+    struct AstNode *lit = new_value(VAL_T, type, text);
+    n->nodetype = VAL_T;
+    n->node.val = lit->node.val;
+    mem_free(lit);
+}
+
+/* Passo fold: ripiega le espressioni costanti dell'AST in letterali */
+
+static long folded;
+
+static int node_const(struct AstNode *n, struct const_value *out)
+{
+    return n->nodetype == VAL_T && const_parse(n->node.val->val_type, n->node.val->string_val, out);
+}
+
+static void fold_list(struct AstNode *list);
+
+/* Ripiega un'espressione partendo dalle foglie. Restituisce il complex_type
+   del nodo: CONSTANT se è (diventato) un letterale. Il tipo del letterale
+   prodotto è quello che eval_expr_type dava all'espressione, così la
+   traduzione (es. il formato di print) non cambia: le operazioni
+   aritmetiche restano NUMBER_T, i confronti diventano true o false.
+*/
+static struct complex_type fold_expr(struct AstNode *n)
+{
+    struct complex_type result = {NIL_T, DYNAMIC};
+    struct const_value l, r, v;
+
+    if (!n)
+        return result;
+
+    switch (n->nodetype)
+    {
+    case VAL_T:
+        result.type = n->node.val->val_type;
+        result.kind = CONSTANT;
+        return result;
+    case FCALL_T:
+        // Gli argomenti di io.read sono formati controllati da check_fcall
+        if (n->node.fcall->func_expr->nodetype != VAR_T ||
+            strcmp(n->node.fcall->func_expr->node.var->name, "io.read") != 0)
+        {
+            for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+                fold_expr(arg);
+        }
+        return result;
+    case TABLE_NODE_T:
+        for (struct AstNode *f = n->node.table->fields; f; f = f->next)
+        {
+            if (f->nodetype == TABLE_FIELD_T)
+                fold_expr(f->node.tfield->value);
+        }
+        return result;
+    case EXPR_T:
+        break;
+    default:
+        return result;
+    }
+
+    struct expression *e = n->node.expr;
+    switch (e->expr_type)
+    {
+    case ASS_T:
+        fold_expr(e->r);
+        return result;
+    case PAR_T:
+    case NEG_T:
+    case NOT_T:
+    {
+        struct complex_type t = fold_expr(e->r);
+        if (t.kind != CONSTANT || !node_const(e->r, &r) || !const_unary(e->expr_type, &r, &v))
+            return result;
+        const_to_node(n, e->expr_type == NOT_T ? BOOLEAN_T : t.type, &v);
+        folded++;
+        break;
+    }
+    default:
+    {
+        struct complex_type lt = fold_expr(e->l);
+        struct complex_type rt = fold_expr(e->r);
+        if (lt.kind != CONSTANT || rt.kind != CONSTANT || !node_const(e->l, &l) || !node_const(e->r, &r) ||
+            !const_binary(e->expr_type, &l, &r, &v))
+            return result;
+        const_to_node(n, v.type == BOOLEAN_T ? BOOLEAN_T : NUMBER_T, &v);
+        folded++;
+        break;
+    }
+    }
+
+    result.type = n->node.val->val_type;
+    result.kind = CONSTANT;
+    return result;
+}
+
+static void fold_statement(struct AstNode *n)
+{
+    switch (n->nodetype)
+    {
+    case EXPR_T:
+    case FCALL_T:
+        fold_expr(n);
+        break;
+    case DECL_T:
+        fold_expr(n->node.decl->expr);
+        break;
+    case RETURN_T:
+        fold_expr(n->node.ret->expr);
+        break;
+    case IF_T:
+        fold_expr(n->node.ifn->cond);
+        fold_list(n->node.ifn->body);
+        fold_list(n->node.ifn->else_body);
+        break;
+    case FOR_T:
+        // Il passo resta un letterale o la negazione di un letterale, come lo produce il parser
+        fold_expr(n->node.forn->start);
+        fold_expr(n->node.forn->end);
+        fold_list(n->node.forn->stmt);
+        break;
+    case FDEF_T:
+        fold_list(n->node.fdef->code);
+        break;
+    default:
+        break;
+    }
+}
+
+static void fold_list(struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+        fold_statement(n);
+}
+
+long fold_ast(struct AstNode *root)
+{
+    folded = 0;
+    fold_list(root);
+    return folded;
+}
@@ -0,0 +1,44 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "ast.h"
+#include "mem.h"
+
+/* Valutazione delle espressioni costanti a tempo di traduzione, condivisa
+   dal passo sull'AST (fold) e dalla propagazione delle costanti sull'IR.
+   Segue la semantica di Lua: le operazioni tra interi restano intere, la
+   divisione produce sempre un numero in virgola mobile, l'uguaglianza tra
+   stringhe è sul contenuto. <, <=, > e >= tra stringhe non sono valutati:
+   il C generato confronta i puntatori. Le operazioni che a runtime darebbero errore
+   o un risultato non rappresentabile (overflow dell'int del C generato,
+   divisione per zero) non vengono valutate. I numeri non interi seguono i
+   tipi del C generato, così il valore è quello calcolato a runtime: double
+   per i letterali e le operazioni con essi, float per le variabili e per
+   le operazioni tra float e interi, arrotondati a ogni passaggio.
+*/
+
+// Valore costante
+struct const_value
+{
+    enum LUA_TYPE type; // INT_T, FLOAT_T, BOOLEAN_T, STRING_T o NIL_T
+    long long i;
+    double f;
+    int wide; // FLOAT_T: double nel C generato (letterali non interi e operazioni con essi), altrimenti float
+    int b;
+    const char *s; // contenuto della stringa, senza virgolette e non terminato
+    int len;
+};
+
+int const_parse(enum LUA_TYPE type, const char *text, struct const_value *out);
+int const_parse_c(enum LUA_TYPE type, const char *text, struct const_value *out);
+int const_unary(enum EXPRESSION_TYPE op, const struct const_value *a, struct const_value *out);
+int const_binary(enum EXPRESSION_TYPE op, const struct const_value *l, const struct const_value *r,
+                 struct const_value *out);
+int const_convert(const struct const_value *a, enum LUA_TYPE type, struct const_value *out);
+int const_truth(const struct const_value *a, int *truth);
+char *const_to_text(const struct const_value *c, enum MEM_SUBSYSTEM sub);
+void const_to_node(struct AstNode *n, enum LUA_TYPE type, const struct const_value *c);
+
+long fold_ast(struct AstNode *root);
+
+#endif
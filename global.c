@@ -1,5 +1,6 @@
 #include "global.h"
 #include "symtab.h"
+#include "mem.h"
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -10,6 +11,7 @@ int main_flag = 0;
 int current_scope_lvl = 1;
 struct symlist *current_symtab = NULL;
 struct symlist *root_symtab = NULL;
+int parallel_hint = 0;
 
 /* Funzione di supporto alle funzioni per il print di errori, warning e note,
     prende come parametro una format string e un numero variabile di argomenti
@@ -23,7 +25,7 @@ char *error_string_format(char *msg, ...)
     int size = vsnprintf(NULL, 0, msg, args) + 1;
     va_end(args);
 
-    char *buffer = malloc(size);
+    char *buffer = mem_alloc(MEM_DIAGNOSTICS, size);
     va_start(args, msg);
     vsprintf(buffer, msg, args);
     va_end(args);
@@ -15,6 +15,7 @@ extern int main_flag;
 extern int current_scope_lvl;
 extern struct symlist *current_symtab;
 extern struct symlist *root_symtab;
+extern int parallel_hint; // riga del commento --@parallel letto, vale solo se il token successivo è for
 
 /* funzioni per la gestione degli errori */
 void yyerror(const char *s);
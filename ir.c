@@ -0,0 +1,1710 @@
+#include "ir.h"
+#include "global.h"
+#include "pretty.h"
+#include "semantic.h"
+#include "stats.h"
+#include "passes.h"
+#include "translate.h"
+#include "effects.h"
+#include "fold.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IR_ARGS_INIT 4
+
+int ir_flag = 0;
+
+static struct ir_function *fn; // funzione in costruzione
+static struct ir_block *cur;   // blocco in cui vengono aggiunte le istruzioni
+
+// Ultima definizione di una variabile in un blocco
+struct ir_def
+{
+    int var; // id della variabile + 1, 0 se l'elemento è libero
+    struct ir_value *value;
+};
+
+static struct ir_function *functions; // funzioni utente per nome, per i passi interprocedurali
+
+static void lower_statements(struct AstNode *list);
+static struct ir_value *lower_expr(struct AstNode *n);
+
+/* Costruzione di valori e blocchi */
+
+struct ir_value *ir_new_value(struct ir_function *f, enum IR_OP op, enum LUA_TYPE type)
+{
+    struct ir_value *v = mem_alloc(MEM_IR, sizeof(struct ir_value));
+    memset(v, 0, sizeof(struct ir_value));
+    v->id = f->nvalues++;
+    v->op = op;
+    v->type = type;
+    stats.ir_values++;
+    return v;
+}
+
+struct ir_value *ir_new_const(struct ir_function *f, enum LUA_TYPE type, const char *text)
+{
+    struct ir_value *v = ir_new_value(f, IR_CONST, type);
+    v->text = text;
+    return v;
+}
+
+static struct ir_value *new_ir_value(enum IR_OP op, enum LUA_TYPE type)
+{
+    return ir_new_value(fn, op, type);
+}
+
+static struct ir_value *new_const(enum LUA_TYPE type, const char *text)
+{
+    return ir_new_const(fn, type, text);
+}
+
+void ir_add_arg(struct ir_value *v, struct ir_value *arg)
+{
+    if (v->nargs == v->cap)
+    {
+        v->cap = v->cap ? v->cap * 2 : IR_ARGS_INIT;
+        if (v->args)
+            v->args = mem_realloc(v->args, v->cap * sizeof(struct ir_value *));
+        else
+            v->args = mem_alloc(MEM_IR, v->cap * sizeof(struct ir_value *));
+    }
+    v->args[v->nargs++] = arg;
+}
+
+static void add_arg(struct ir_value *v, struct ir_value *arg)
+{
+    ir_add_arg(v, arg);
+}
+
+// Aggiunge un'istruzione in coda al blocco corrente
+static struct ir_value *append(struct ir_value *v)
+{
+    v->block = cur;
+    if (cur->last)
+        cur->last->next = v;
+    else
+        cur->first = v;
+    cur->last = v;
+    return v;
+}
+
+struct ir_block *ir_new_block(struct ir_function *f)
+{
+    struct ir_block *b = mem_alloc(MEM_IR, sizeof(struct ir_block));
+    memset(b, 0, sizeof(struct ir_block));
+    b->id = f->nblocks++;
+    b->order = -1;
+
+    if (f->last_block)
+        f->last_block->next = b;
+    else
+        f->entry = b;
+    f->last_block = b;
+
+    stats.ir_blocks++;
+    return b;
+}
+
+static struct ir_block *new_block()
+{
+    return ir_new_block(fn);
+}
+
+void ir_add_pred(struct ir_block *b, struct ir_block *pred)
+{
+    if (b->npreds == b->cap)
+    {
+        b->cap = b->cap ? b->cap * 2 : IR_ARGS_INIT;
+        if (b->preds)
+            b->preds = mem_realloc(b->preds, b->cap * sizeof(struct ir_block *));
+        else
+            b->preds = mem_alloc(MEM_IR, b->cap * sizeof(struct ir_block *));
+    }
+    b->preds[b->npreds++] = pred;
+}
+
+// Toglie un arco entrante e l'argomento corrispondente delle phi del blocco
+void ir_remove_pred(struct ir_block *b, struct ir_block *pred)
+{
+    int k = 0;
+    while (k < b->npreds && b->preds[k] != pred)
+        k++;
+    if (k == b->npreds)
+        return;
+
+    memmove(&b->preds[k], &b->preds[k + 1], (b->npreds - k - 1) * sizeof(struct ir_block *));
+    b->npreds--;
+    for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+    {
+        if (k < phi->nargs)
+        {
+            memmove(&phi->args[k], &phi->args[k + 1], (phi->nargs - k - 1) * sizeof(struct ir_value *));
+            phi->nargs--;
+        }
+    }
+}
+
+static void add_pred(struct ir_block *b, struct ir_block *pred)
+{
+    ir_add_pred(b, pred);
+}
+
+static void terminate(struct ir_value *term)
+{
+    term->block = cur;
+    cur->term = term;
+}
+
+static void jump(struct ir_block *target)
+{
+    struct ir_value *t = new_ir_value(IR_JUMP, NIL_T);
+    t->targets[0] = target;
+    terminate(t);
+    add_pred(target, cur);
+}
+
+static void branch(struct ir_value *cond, struct ir_block *if_true, struct ir_block *if_false)
+{
+    struct ir_value *t = new_ir_value(IR_BRANCH, NIL_T);
+    add_arg(t, cond);
+    t->targets[0] = if_true;
+    t->targets[1] = if_false;
+    terminate(t);
+    add_pred(if_true, cur);
+    add_pred(if_false, cur);
+}
+
+/* Variabili e costruzione della forma SSA.
+   Algoritmo di Braun et al., "Simple and Efficient Construction of Static
+   Single Assignment Form": l'ultima definizione di ogni variabile è
+   registrata per blocco e le phi sono create solo dove una lettura risale
+   a un blocco con più predecessori.
+*/
+
+static struct ir_var *find_var(char *name)
+{
+    struct ir_var *v;
+    HASH_FIND_STR(fn->vars, name, v);
+    return v;
+}
+
+static struct ir_var *new_var(char *name, enum LUA_TYPE type)
+{
+    struct ir_var *v = mem_alloc(MEM_IR, sizeof(struct ir_var));
+    v->name = name;
+    v->id = fn->nvars++;
+    v->type = type;
+    HASH_ADD_STR(fn->vars, name, v);
+    return v;
+}
+
+/* Le definizioni sono in una piccola tabella ad indirizzamento aperto per
+   blocco, grande quanto le variabili definite o lette nel blocco: un array
+   per blocco grande quanto il numero di variabili occuperebbe memoria
+   quadratica (ogni ciclo for aggiunge una variabile), e un'unica hash table
+   per funzione cresce fino a non stare in cache, così ogni lettura di
+   variabile costerebbe sempre di più con la dimensione della funzione.
+   Gli id delle variabili sono consecutivi, quindi i bit bassi bastano come
+   hash.
+*/
+static struct ir_def *find_def(struct ir_block *b, int var)
+{
+    int mask = b->defs_cap - 1;
+    for (int i = var & mask;; i = (i + 1) & mask)
+    {
+        if (b->defs[i].var == var + 1 || b->defs[i].var == 0)
+            return &b->defs[i];
+    }
+}
+
+static void write_var(int var, struct ir_block *b, struct ir_value *v)
+{
+    if (4 * (b->ndefs + 1) > 3 * b->defs_cap)
+    {
+        struct ir_def *old = b->defs;
+        int old_cap = b->defs_cap;
+
+        b->defs_cap = old_cap ? 2 * old_cap : 4;
+        b->defs = mem_alloc(MEM_IR, b->defs_cap * sizeof(struct ir_def));
+        memset(b->defs, 0, b->defs_cap * sizeof(struct ir_def));
+        for (int i = 0; i < old_cap; i++)
+        {
+            if (old[i].var)
+                *find_def(b, old[i].var - 1) = old[i];
+        }
+        if (old)
+            mem_free(old);
+    }
+
+    struct ir_def *d = find_def(b, var);
+    if (!d->var)
+    {
+        d->var = var + 1;
+        b->ndefs++;
+    }
+    d->value = v;
+}
+
+static struct ir_value *local_def(int var, struct ir_block *b)
+{
+    if (!b->defs_cap)
+        return NULL;
+    struct ir_def *d = find_def(b, var);
+    return d->var ? ir_resolve(d->value) : NULL;
+}
+
+static struct ir_value *new_phi(struct ir_block *b, int var, enum LUA_TYPE type)
+{
+    struct ir_value *phi = new_ir_value(IR_PHI, type);
+    phi->var = var;
+    phi->block = b;
+    phi->next = b->phis;
+    b->phis = phi;
+    return phi;
+}
+
+static struct ir_value *read_var(int var, enum LUA_TYPE type, struct ir_block *b);
+
+static int trivial_phi(struct ir_value *phi, struct ir_value **same, int skip_unreachable);
+
+/* Aggiunge gli operandi della phi e, se è già banale, la sostituisce subito
+   con l'unico valore che unisce: altrimenti ogni ciclo annidato che legge una
+   variabile aggiungerebbe una catena di phi inutili, rimossa solo alla fine.
+*/
+static void add_phi_operands(struct ir_value *phi)
+{
+    struct ir_value *same;
+
+    for (int i = 0; i < phi->block->npreds; i++)
+        add_arg(phi, read_var(phi->var, phi->type, phi->block->preds[i]));
+    if (trivial_phi(phi, &same, 0) && same)
+        phi->forward = same;
+}
+
+static struct ir_value *read_var(int var, enum LUA_TYPE type, struct ir_block *b)
+{
+    struct ir_value *v = local_def(var, b);
+    if (v)
+        return v;
+
+    // Le catene di blocchi con un solo predecessore sono risalite senza ricorsione
+    struct ir_block *start = b;
+    while (b->sealed && b->npreds == 1 && !local_def(var, b))
+        b = b->preds[0];
+
+    v = local_def(var, b);
+    if (!v)
+    {
+        if (!b->sealed)
+        {
+            // Predecessori non ancora noti: gli operandi saranno aggiunti alla chiusura
+            v = new_phi(b, var, type);
+            v->incomplete = 1;
+        }
+        else if (b->npreds == 0)
+        {
+            // Variabile non definita su questo cammino
+            v = new_const(type, "0");
+        }
+        else
+        {
+            // La phi è registrata prima di leggere i predecessori, per interrompere i cicli
+            v = new_phi(b, var, type);
+            write_var(var, b, v);
+            add_phi_operands(v);
+        }
+        write_var(var, b, v);
+    }
+    write_var(var, start, v);
+    return v;
+}
+
+// Tutti i predecessori del blocco sono noti: completa le phi rimaste in sospeso
+static void seal(struct ir_block *b)
+{
+    for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+    {
+        if (phi->incomplete)
+        {
+            phi->incomplete = 0;
+            add_phi_operands(phi);
+        }
+    }
+    b->sealed = 1;
+}
+
+/* Valore che sostituisce v dopo l'eliminazione delle phi banali. Le catene
+   di sostituzioni vengono compresse, così risolverle di nuovo costa poco.
+*/
+struct ir_value *ir_resolve(struct ir_value *v)
+{
+    struct ir_value *root = v;
+    while (root->forward)
+        root = root->forward;
+    while (v->forward && v->forward != root)
+    {
+        struct ir_value *next = v->forward;
+        v->forward = root;
+        v = next;
+    }
+    return root;
+}
+
+static struct ir_value *resolve(struct ir_value *v)
+{
+    return ir_resolve(v);
+}
+
+/* Abbassamento delle espressioni */
+
+// Testo C di un letterale, come lo produce translate_node
+static const char *const_text(struct AstNode *n)
+{
+    if (n->node.val->val_type == NIL_T)
+        return "NULL";
+    if (n->node.val->val_type == STRING_T)
+    {
+        char *s = mem_alloc(MEM_IR, strlen(n->node.val->string_val) + 3);
+        sprintf(s, "\"%s\"", n->node.val->string_val);
+        return s;
+    }
+    return n->node.val->string_val;
+}
+
+// Valore costante per un letterale dell'AST: un NUMBER_T intero prodotto da fold è un int nel C
+struct ir_value *ir_new_literal(struct ir_function *f, struct AstNode *n)
+{
+    struct const_value c;
+    enum LUA_TYPE type = n->node.val->val_type;
+    if (type == NUMBER_T && const_parse(NUMBER_T, n->node.val->string_val, &c) && c.type == INT_T)
+        type = INT_T;
+    return ir_new_const(f, type, const_text(n));
+}
+
+/* Tipo con cui una funzione dichiara una variabile alla prima assegnazione:
+   quello che translate.c ricava dal valore con eval_expr_type, per cui ogni
+   operazione aritmetica è NUMBER_T (float). arith_type tiene intere le
+   operazioni tra interi solo per i temporanei.
+*/
+enum LUA_TYPE ir_local_type(struct AstNode *value, enum LUA_TYPE value_type)
+{
+    while (value->nodetype == EXPR_T &&
+           (value->node.expr->expr_type == PAR_T || value->node.expr->expr_type == NEG_T))
+        value = value->node.expr->r;
+    // Un letterale NUMBER_T di fold con testo intero è un int solo come valore
+    if (value->nodetype == VAL_T && value->node.val->val_type == NUMBER_T)
+        return NUMBER_T;
+    if (value->nodetype != EXPR_T)
+        return value_type;
+    switch (value->node.expr->expr_type)
+    {
+    case ADD_T:
+    case SUB_T:
+    case MUL_T:
+    case DIV_T:
+        return NUMBER_T;
+    default:
+        return value_type;
+    }
+}
+
+// Tipo della variabile alla prima assegnazione: in main quello della symbol table globale
+static enum LUA_TYPE declared_type(char *name, struct AstNode *value, enum LUA_TYPE value_type)
+{
+    if (!fn->fdef && root_symtab)
+    {
+        struct symbol *sym = find_sym(root_symtab, name);
+        if (sym && sym->sym_type == VARIABLE)
+            return sym->type;
+    }
+    return ir_local_type(value, value_type);
+}
+
+// Tipo di ritorno di una chiamata a funzione utente, come in eval_expr_type ma senza warning
+static enum LUA_TYPE call_type(struct AstNode *n)
+{
+    if (n->node.fcall->return_type != NIL_T)
+        return n->node.fcall->return_type;
+
+    struct symbol *sym = root_symtab ? find_sym(root_symtab, n->node.fcall->func_expr->node.var->name) : NULL;
+    return sym && sym->sym_type == FUNCTION_SYM ? sym->type : USERDATA_T;
+}
+
+static int has_call(struct AstNode *n)
+{
+    if (!n)
+        return 0;
+    switch (n->nodetype)
+    {
+    case FCALL_T:
+        return 1;
+    case EXPR_T:
+        return has_call(n->node.expr->l) || has_call(n->node.expr->r);
+    case TABLE_NODE_T:
+        for (struct AstNode *f = n->node.table->fields; f; f = f->next)
+        {
+            if (has_call(f))
+                return 1;
+        }
+        return 0;
+    case TABLE_FIELD_T:
+        return has_call(n->node.tfield->value);
+    default:
+        return 0;
+    }
+}
+
+// Buffer di testo per la stringa di formato di print
+struct text_buf
+{
+    char *s;
+    size_t len;
+    size_t cap;
+};
+
+static void text_append(struct text_buf *buf, const char *s)
+{
+    size_t n = strlen(s);
+    if (buf->len + n + 1 > buf->cap)
+    {
+        buf->cap = (buf->len + n + 1) * 2;
+        buf->s = buf->s ? mem_realloc(buf->s, buf->cap) : mem_alloc(MEM_IR, buf->cap);
+    }
+    memcpy(buf->s + buf->len, s, n + 1);
+    buf->len += n;
+}
+
+// print: la stringa di formato è costruita come in translate_node
+static struct ir_value *lower_print(struct AstNode *n)
+{
+    struct ir_value *v = new_ir_value(IR_PRINT, NIL_T);
+    struct text_buf format = {NULL, 0, 0};
+
+    text_append(&format, "");
+    for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+    {
+        if (arg != n->node.fcall->args)
+            text_append(&format, " ");
+
+        if (arg->nodetype == VAL_T && arg->node.val->val_type == STRING_T)
+        {
+            text_append(&format, arg->node.val->string_val);
+            continue;
+        }
+
+        struct ir_value *a = lower_expr(arg);
+        enum LUA_TYPE type = a->type;
+        text_append(&format, print_conversion(type));
+        if (print_passes_arg(type))
+            add_arg(v, a);
+    }
+    text_append(&format, "\\n");
+
+    v->text = format.s;
+    append(v);
+    return new_const(NIL_T, "NULL");
+}
+
+static struct ir_value *lower_io_read(struct AstNode *n)
+{
+    struct AstNode *arg = n->node.fcall->args;
+    struct ir_value *v = new_ir_value(IR_CALL, eval_expr_type(n, root_symtab).type);
+
+    if (!arg)
+    {
+        v->text = "c_lua_io_read_line";
+    }
+    else if (arg->nodetype == VAL_T && arg->node.val->val_type == STRING_T)
+    {
+        const char *fmt = arg->node.val->string_val;
+        if (strcmp(fmt, "*n") == 0)
+            v->text = "c_lua_io_read_number";
+        else if (strcmp(fmt, "*l") == 0 || strcmp(fmt, "*L") == 0 || strcmp(fmt, "*a") == 0)
+            v->text = "c_lua_io_read_line";
+        else
+        {
+            v->text = "io_read_unsupported_format";
+            add_arg(v, new_const(STRING_T, const_text(arg)));
+        }
+    }
+    else if (arg->nodetype == VAL_T && (arg->node.val->val_type == INT_T || arg->node.val->val_type == FLOAT_T))
+    {
+        v->text = "c_lua_io_read_bytes";
+        add_arg(v, lower_expr(arg));
+    }
+    else
+    {
+        v->text = "io_read_complex_arg";
+    }
+    return append(v);
+}
+
+static struct ir_value *lower_call(struct AstNode *n)
+{
+    char *name = n->node.fcall->func_expr->node.var->name;
+
+    if (strcmp(name, "print") == 0)
+        return lower_print(n);
+    if (strcmp(name, "io.read") == 0)
+        return lower_io_read(n);
+
+    struct ir_value *v = new_ir_value(IR_CALL, call_type(n));
+    v->text = name;
+    for (struct AstNode *arg = n->node.fcall->args; arg; arg = arg->next)
+        add_arg(v, lower_expr(arg));
+    return append(v);
+}
+
+static struct ir_value *lower_table(struct AstNode *n)
+{
+    struct ir_value *v = new_ir_value(IR_TABLE, TABLE_T);
+    v->ast = n;
+    for (struct AstNode *f = n->node.table->fields; f; f = f->next)
+    {
+        if (f->nodetype != TABLE_FIELD_T)
+            add_arg(v, lower_expr(f));
+        else if (f->node.tfield->value)
+            add_arg(v, lower_expr(f->node.tfield->value));
+        else
+            add_arg(v, new_const(INT_T, "0"));
+    }
+    return append(v);
+}
+
+/* and/or con chiamate nell'operando destro: il flusso di controllo rende
+   esplicito il cortocircuito, il risultato è una phi booleana
+*/
+static struct ir_value *lower_logical(struct AstNode *n)
+{
+    int is_and = n->node.expr->expr_type == AND_T;
+    struct ir_value *l = lower_expr(n->node.expr->l);
+    struct ir_block *rhs = new_block();
+    struct ir_block *merge = new_block();
+
+    if (is_and)
+        branch(l, rhs, merge);
+    else
+        branch(l, merge, rhs);
+    seal(rhs);
+
+    cur = rhs;
+    struct ir_value *r = lower_expr(n->node.expr->r);
+    jump(merge);
+    seal(merge);
+
+    cur = merge;
+    struct ir_value *phi = new_phi(merge, -1, BOOLEAN_T);
+    add_arg(phi, new_const(BOOLEAN_T, is_and ? "false" : "true"));
+    add_arg(phi, r);
+    return phi;
+}
+
+/* Tipo del risultato di un'operazione aritmetica: tra interi resta intero,
+   come in Lua e nel C generato; la divisione è sempre in virgola mobile,
+   come in Lua (l'emissione converte il dividendo se entrambi sono interi).
+*/
+static enum LUA_TYPE arith_type(enum EXPRESSION_TYPE op, enum LUA_TYPE l, enum LUA_TYPE r)
+{
+    return op != DIV_T && l == INT_T && r == INT_T ? INT_T : NUMBER_T;
+}
+
+static struct ir_value *lower_expr(struct AstNode *n)
+{
+    struct ir_value *v;
+
+    switch (n->nodetype)
+    {
+    case VAL_T:
+        return ir_new_literal(fn, n);
+    case VAR_T:
+    {
+        struct ir_var *var = find_var(n->node.var->name);
+        if (!var)
+        {
+            struct symbol *sym = root_symtab ? find_sym(root_symtab, n->node.var->name) : NULL;
+            var = new_var(n->node.var->name, sym ? sym->type : NIL_T);
+        }
+        return read_var(var->id, var->type, cur);
+    }
+    case TABLE_NODE_T:
+        return lower_table(n);
+    case FCALL_T:
+        return lower_call(n);
+    case EXPR_T:
+        break;
+    default:
+        return new_const(USERDATA_T, "0");
+    }
+
+    switch (n->node.expr->expr_type)
+    {
+    case PAR_T:
+        return lower_expr(n->node.expr->r);
+    case NEG_T:
+    case NOT_T:
+    {
+        struct ir_value *r = lower_expr(n->node.expr->r);
+        v = new_ir_value(IR_UNARY, n->node.expr->expr_type == NOT_T ? BOOLEAN_T : r->type);
+        v->expr_type = n->node.expr->expr_type;
+        add_arg(v, r);
+        return append(v);
+    }
+    case AND_T:
+    case OR_T:
+        if (has_call(n->node.expr->r))
+            return lower_logical(n);
+        // fallthrough
+    default:
+    {
+        struct ir_value *l = lower_expr(n->node.expr->l);
+        struct ir_value *r = lower_expr(n->node.expr->r);
+        enum EXPRESSION_TYPE op = n->node.expr->expr_type;
+        int arith = op == ADD_T || op == SUB_T || op == MUL_T || op == DIV_T;
+        v = new_ir_value(IR_BINARY, arith ? arith_type(op, l->type, r->type) : BOOLEAN_T);
+        v->expr_type = op;
+        add_arg(v, l);
+        add_arg(v, r);
+        return append(v);
+    }
+    }
+}
+
+/* Abbassamento degli statement */
+
+// Tipo C di un valore dell'IR: le tabelle sono passate per puntatore
+static const char *c_type(enum LUA_TYPE type)
+{
+    if (type != TABLE_T)
+        return lua_type_to_c_string(type);
+    runtime_use(RUNTIME_FIELD);
+    return "lua_field*";
+}
+
+// Converte il valore al tipo della variabile, se diverso
+struct ir_value *ir_convert(struct ir_function *f, struct ir_value *v, enum LUA_TYPE type)
+{
+    if (strcmp(c_type(v->type), c_type(type)) == 0)
+        return v;
+
+    struct ir_value *cast = ir_new_value(f, IR_CAST, type);
+    add_arg(cast, v);
+    return cast;
+}
+
+static struct ir_value *convert(struct ir_value *v, enum LUA_TYPE type)
+{
+    return ir_convert(fn, v, type);
+}
+
+static void lower_assignment(struct AstNode *n)
+{
+    struct ir_value *v = lower_expr(n->node.expr->r);
+    struct AstNode *lhs = n->node.expr->l;
+    if (!lhs || lhs->nodetype != VAR_T)
+        return;
+
+    struct ir_var *var = find_var(lhs->node.var->name);
+    if (!var)
+        var = new_var(lhs->node.var->name, declared_type(lhs->node.var->name, n->node.expr->r, v->type));
+    write_var(var->id, cur, convert(v, var->type));
+}
+
+static void lower_if(struct AstNode *n)
+{
+    struct ir_value *cond = lower_expr(n->node.ifn->cond);
+    struct ir_block *then_block = new_block();
+    struct ir_block *else_block = n->node.ifn->else_body ? new_block() : NULL;
+    struct ir_block *merge = new_block();
+
+    branch(cond, then_block, else_block ? else_block : merge);
+    seal(then_block);
+
+    cur = then_block;
+    lower_statements(n->node.ifn->body);
+    if (!cur->term)
+        jump(merge);
+
+    if (else_block)
+    {
+        seal(else_block);
+        cur = else_block;
+        lower_statements(n->node.ifn->else_body);
+        if (!cur->term)
+            jump(merge);
+    }
+
+    seal(merge);
+    cur = merge;
+}
+
+/* for: il limite è valutato una sola volta prima del ciclo, come in Lua.
+   Il passo è un letterale, quindi il suo segno sceglie il confronto.
+*/
+static void lower_for(struct AstNode *n)
+{
+    struct forNode *forn = n->node.forn;
+    struct ir_value *start = forn->start ? lower_expr(forn->start) : new_const(INT_T, "0");
+    struct ir_value *end = forn->end ? lower_expr(forn->end) : new_const(INT_T, "0");
+    struct ir_value *step = new_const(INT_T, "1");
+    int descending = 0;
+
+    if (forn->step && forn->step->nodetype == VAL_T)
+    {
+        step = new_const(forn->step->node.val->val_type, forn->step->node.val->string_val);
+    }
+    else if (forn->step)
+    {
+        // NEG_T di un letterale
+        struct AstNode *lit = forn->step->node.expr->r;
+        char *text = mem_alloc(MEM_IR, strlen(lit->node.val->string_val) + 2);
+        sprintf(text, "-%s", lit->node.val->string_val);
+        step = new_const(lit->node.val->val_type, text);
+        descending = 1;
+    }
+
+    // La variabile di controllo nasconde una eventuale variabile esterna con lo stesso nome
+    struct ir_var *outer = find_var(forn->varname);
+    if (outer)
+        HASH_DEL(fn->vars, outer);
+    struct ir_var *var = new_var(forn->varname, INT_T);
+    write_var(var->id, cur, convert(start, INT_T));
+
+    struct ir_block *header = new_block();
+    jump(header);
+    cur = header;
+
+    struct ir_value *cond = new_ir_value(IR_BINARY, BOOLEAN_T);
+    cond->expr_type = descending ? GE_T : LE_T;
+    add_arg(cond, read_var(var->id, INT_T, header));
+    add_arg(cond, end);
+    append(cond);
+
+    struct ir_block *body = new_block();
+    struct ir_block *after = new_block();
+    branch(cond, body, after);
+    seal(body);
+    seal(after);
+
+    cur = body;
+    lower_statements(forn->stmt);
+    if (!cur->term)
+    {
+        struct ir_value *next = new_ir_value(IR_BINARY, INT_T);
+        next->expr_type = ADD_T;
+        add_arg(next, read_var(var->id, INT_T, cur));
+        add_arg(next, step);
+        append(next);
+        write_var(var->id, cur, next);
+        jump(header);
+    }
+    seal(header);
+    cur = after;
+
+    HASH_DEL(fn->vars, var);
+    if (outer)
+        HASH_ADD_STR(fn->vars, name, outer);
+}
+
+static void lower_return(struct AstNode *n)
+{
+    struct ir_value *t = new_ir_value(IR_RETURN, NIL_T);
+    if (n->node.ret->expr)
+        add_arg(t, lower_expr(n->node.ret->expr));
+    terminate(t);
+}
+
+static void lower_statements(struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        if (cur->term)
+        {
+            // Codice dopo un return: blocco senza predecessori, scartato nel layout
+            cur = new_block();
+            cur->sealed = 1;
+        }
+
+        switch (n->nodetype)
+        {
+        case EXPR_T:
+            if (n->node.expr->expr_type == ASS_T)
+                lower_assignment(n);
+            else
+                lower_expr(n);
+            break;
+        case FCALL_T:
+            lower_expr(n);
+            break;
+        case IF_T:
+            lower_if(n);
+            break;
+        case FOR_T:
+            lower_for(n);
+            break;
+        case RETURN_T:
+            lower_return(n);
+            break;
+        default:
+            // Le definizioni di funzione sono abbassate a parte
+            break;
+        }
+    }
+}
+
+/* Analisi dopo la costruzione */
+
+static int successors(struct ir_block *b, struct ir_block **succ)
+{
+    if (!b->term || b->term->op == IR_RETURN)
+        return 0;
+    if (b->term->op == IR_JUMP)
+    {
+        succ[0] = b->term->targets[0];
+        return 1;
+    }
+    // Il ramo falso è visitato per primo, così nel reverse postorder il ramo vero lo precede
+    succ[0] = b->term->targets[1];
+    succ[1] = b->term->targets[0];
+    return 2;
+}
+
+// Ordina i blocchi raggiungibili in reverse postorder, con una visita iterativa
+static void compute_layout(struct ir_function *f)
+{
+    struct ir_block **post = mem_alloc(MEM_IR, f->nblocks * sizeof(struct ir_block *));
+    struct ir_block **stack = mem_alloc(MEM_IR, f->nblocks * sizeof(struct ir_block *));
+    int *next_succ = mem_alloc(MEM_IR, f->nblocks * sizeof(int));
+    int npost = 0, top = 0;
+
+    f->entry->order = 0;
+    stack[top] = f->entry;
+    next_succ[top++] = 0;
+    while (top > 0)
+    {
+        struct ir_block *succ[2];
+        struct ir_block *b = stack[top - 1];
+        int n = successors(b, succ);
+
+        if (next_succ[top - 1] < n)
+        {
+            struct ir_block *s = succ[next_succ[top - 1]++];
+            if (s->order == -1)
+            {
+                s->order = 0;
+                stack[top] = s;
+                next_succ[top++] = 0;
+            }
+        }
+        else
+        {
+            post[npost++] = b;
+            top--;
+        }
+    }
+
+    f->layout = mem_alloc(MEM_IR, npost * sizeof(struct ir_block *));
+    f->nlayout = npost;
+    for (int i = 0; i < npost; i++)
+    {
+        f->layout[i] = post[npost - 1 - i];
+        f->layout[i]->order = i;
+    }
+
+    mem_free(post);
+    mem_free(stack);
+    mem_free(next_succ);
+}
+
+/* La phi è banale se gli operandi, esclusa la phi stessa, sono un solo valore.
+   Dopo il calcolo del layout si ignorano quelli che arrivano da blocchi irraggiungibili.
+*/
+static int trivial_phi(struct ir_value *phi, struct ir_value **same, int skip_unreachable)
+{
+    *same = NULL;
+    for (int k = 0; k < phi->nargs; k++)
+    {
+        struct ir_value *a = resolve(phi->args[k]);
+        if ((skip_unreachable && phi->block->preds[k]->order < 0) || a == phi || a == *same)
+            continue;
+        if (*same)
+            return 0;
+        *same = a;
+    }
+    return 1;
+}
+
+/* Elimina le phi banali con una worklist: quando una phi viene sostituita
+   sono ricontrollate solo le phi che la usano, che passano poi al valore
+   che la sostituisce. Una scansione ripetuta di tutte le phi fino al punto
+   fisso sarebbe quadratica nei cicli annidati.
+*/
+static void remove_trivial_phis(struct ir_function *f)
+{
+    int n = f->nvalues;
+    int nedges = 0, nwork = 0;
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *phi = f->layout[i]->phis; phi; phi = phi->next)
+            nedges += phi->nargs + 1;
+    }
+
+    // Liste delle phi che usano ogni phi, concatenabili in tempo costante
+    int *head = mem_alloc(MEM_IR, n * sizeof(int));
+    int *tail = mem_alloc(MEM_IR, n * sizeof(int));
+    int *next = mem_alloc(MEM_IR, (nedges + 1) * sizeof(int));
+    struct ir_value **user = mem_alloc(MEM_IR, (nedges + 1) * sizeof(struct ir_value *));
+    int cap = 2 * nedges + 1;
+    struct ir_value **work = mem_alloc(MEM_IR, cap * sizeof(struct ir_value *));
+    int e = 0;
+
+    memset(head, -1, n * sizeof(int));
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *phi = f->layout[i]->phis; phi; phi = phi->next)
+        {
+            if (phi->forward)
+                continue;
+            work[nwork++] = phi;
+            for (int k = 0; k < phi->nargs; k++)
+            {
+                struct ir_value *a = resolve(phi->args[k]);
+                if (a->op != IR_PHI || a == phi)
+                    continue;
+                next[e] = -1;
+                user[e] = phi;
+                if (head[a->id] < 0)
+                    head[a->id] = e;
+                else
+                    next[tail[a->id]] = e;
+                tail[a->id] = e++;
+            }
+        }
+    }
+
+    while (nwork > 0)
+    {
+        struct ir_value *phi = work[--nwork];
+        struct ir_value *same;
+        if (phi->forward || !trivial_phi(phi, &same, 1))
+            continue;
+
+        phi->forward = same ? same : new_const(phi->type, "0");
+        for (int u = head[phi->id]; u >= 0; u = next[u])
+        {
+            if (user[u]->forward)
+                continue;
+            if (nwork == cap)
+            {
+                cap *= 2;
+                work = mem_realloc(work, cap * sizeof(struct ir_value *));
+            }
+            work[nwork++] = user[u];
+        }
+        if (same && same->op == IR_PHI && head[phi->id] >= 0)
+        {
+            if (head[same->id] < 0)
+                head[same->id] = head[phi->id];
+            else
+                next[tail[same->id]] = head[phi->id];
+            tail[same->id] = tail[phi->id];
+        }
+    }
+
+    mem_free(head);
+    mem_free(tail);
+    mem_free(next);
+    mem_free(user);
+    mem_free(work);
+}
+
+static void add_use(struct ir_value *v, struct ir_value **work, int *top)
+{
+    if (v->uses++ == 0 && v->op != IR_CALL && v->op != IR_PRINT)
+        work[(*top)++] = v;
+}
+
+static void use_args(struct ir_value *v, struct ir_value **work, int *top)
+{
+    for (int i = 0; i < v->nargs; i++)
+    {
+        if (v->op == IR_PHI && v->block->preds[i]->order < 0)
+            continue;
+        add_use(resolve(v->args[i]), work, top);
+    }
+}
+
+/* Conta gli usi vivi di ogni valore partendo dalle istruzioni con effetti
+   (chiamate, print) e dai terminatori: i valori senza usi non vengono emessi
+*/
+static void reset_uses(struct ir_value *v)
+{
+    v->uses = 0;
+    for (int i = 0; i < v->nargs; i++)
+        resolve(v->args[i])->uses = 0;
+}
+
+static void count_uses(struct ir_function *f)
+{
+    struct ir_value **work = mem_alloc(MEM_IR, (f->nvalues + 1) * sizeof(struct ir_value *));
+    int top = 0;
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *phi = f->layout[i]->phis; phi; phi = phi->next)
+            reset_uses(phi);
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+            reset_uses(v);
+        if (f->layout[i]->term)
+            reset_uses(f->layout[i]->term);
+    }
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+        {
+            if (v->op == IR_CALL || v->op == IR_PRINT)
+                use_args(v, work, &top);
+        }
+        if (f->layout[i]->term)
+            use_args(f->layout[i]->term, work, &top);
+    }
+    while (top > 0)
+        use_args(work[--top], work, &top);
+    mem_free(work);
+}
+
+/* Riporta l'IR in forma canonica dopo una trasformazione: ricalcola il
+   layout, elimina le phi diventate banali e conta di nuovo gli usi
+*/
+void ir_update(struct ir_function *f)
+{
+    for (int i = 0; i < f->nlayout; i++)
+        f->layout[i]->order = -1;
+    mem_free(f->layout);
+    compute_layout(f);
+    remove_trivial_phis(f);
+    count_uses(f);
+}
+
+/* Funzioni e programma */
+
+static struct ir_function *lower_function(struct AstNode *fdef, struct AstNode *body)
+{
+    fn = mem_alloc(MEM_IR, sizeof(struct ir_function));
+    memset(fn, 0, sizeof(struct ir_function));
+    fn->fdef = fdef;
+    fn->name = fdef ? fdef->node.fdef->name : NULL;
+    fn->ret_type = fdef ? fdef->node.fdef->ret_type : INT_T;
+
+    cur = new_block();
+    cur->sealed = 1;
+
+    if (fdef)
+    {
+        for (struct AstNode *p = fdef->node.fdef->params; p; p = p->next)
+        {
+            struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+            if (var->nodetype != VAR_T)
+                continue;
+
+            enum LUA_TYPE type = param_type(p, root_symtab);
+            struct ir_value *param = new_ir_value(IR_PARAM, type);
+            param->text = var->node.var->name;
+            write_var(new_var(var->node.var->name, type)->id, cur, param);
+        }
+    }
+
+    lower_statements(body);
+    if (!cur->term)
+    {
+        struct ir_value *t = new_ir_value(IR_RETURN, NIL_T);
+        if (!fdef)
+            add_arg(t, new_const(INT_T, "0"));
+        terminate(t);
+    }
+
+    // Con tutti i blocchi sigillati le definizioni non servono più
+    for (struct ir_block *b = fn->entry; b; b = b->next)
+    {
+        if (b->defs)
+            mem_free(b->defs);
+        b->defs = NULL;
+        b->defs_cap = b->ndefs = 0;
+    }
+
+    compute_layout(fn);
+    remove_trivial_phis(fn);
+    count_uses(fn);
+    return fn;
+}
+
+struct ir_function *ir_find_function(const char *name)
+{
+    struct ir_function *f;
+    HASH_FIND_STR(functions, name, f);
+    return f;
+}
+
+/* Tutte le funzioni vengono costruite prima di eseguire i passi, così i
+   passi interprocedurali trovano l'IR di ogni funzione chiamata. I passi
+   girano nell'ordine del sorgente: le funzioni di supporto, di solito
+   definite prima, sono già ottimizzate quando vengono espanse nei chiamanti.
+*/
+struct ir_program *ir_lower(struct AstNode *root)
+{
+    stats_begin(TIMER_IR);
+    struct ir_program *program = mem_alloc(MEM_IR, sizeof(struct ir_program));
+    struct ir_function **tail = &program->functions;
+
+    for (struct AstNode *n = root; n; n = n->next)
+    {
+        if (n->nodetype == FDEF_T && n->node.fdef->name)
+        {
+            *tail = lower_function(n, n->node.fdef->code);
+            if (!ir_find_function((*tail)->name))
+                HASH_ADD_KEYPTR(hh, functions, (*tail)->name, strlen((*tail)->name), *tail);
+            tail = &(*tail)->next;
+        }
+    }
+    *tail = lower_function(NULL, root);
+    (*tail)->next = NULL;
+
+    for (struct ir_function *f = program->functions; f; f = f->next)
+    {
+        passes_run_ir(f);
+        for (int i = 0; i < f->nlayout; i++)
+        {
+            for (struct ir_value *phi = f->layout[i]->phis; phi; phi = phi->next)
+            {
+                if (!phi->forward && phi->uses)
+                    stats.ir_phis++;
+            }
+        }
+    }
+
+    stats_end(TIMER_IR);
+    return program;
+}
+
+/* Stampa dell'IR (--dump-ir) */
+
+static void print_operand(FILE *out, struct ir_value *v)
+{
+    v = resolve(v);
+    switch (v->op)
+    {
+    case IR_CONST:
+    case IR_PARAM:
+        fputs(v->text, out);
+        break;
+    case IR_CAST:
+        fprintf(out, "(%s)", c_type(v->type));
+        print_operand(out, v->args[0]);
+        break;
+    default:
+        fprintf(out, "_r%d", v->id);
+        break;
+    }
+}
+
+static void print_args(FILE *out, struct ir_value *v)
+{
+    for (int i = 0; i < v->nargs; i++)
+    {
+        if (i)
+            fputs(", ", out);
+        print_operand(out, v->args[i]);
+    }
+}
+
+void ir_print(struct ir_program *program, FILE *out)
+{
+    for (struct ir_function *f = program->functions; f; f = f->next)
+    {
+        fprintf(out, "\nfunction %s: %s%s\n", f->name ? f->name : "main",
+                f->ret_type || !f->fdef ? c_type(f->ret_type) : "void", f->memo ? " (memo)" : "");
+        for (int i = 0; i < f->nlayout; i++)
+        {
+            struct ir_block *b = f->layout[i];
+            fprintf(out, "_b%d:", b->id);
+            const char *sep = "  ; pred ";
+            for (int k = 0; k < b->npreds; k++)
+            {
+                if (b->preds[k]->order >= 0)
+                {
+                    fprintf(out, "%s_b%d", sep, b->preds[k]->id);
+                    sep = ", ";
+                }
+            }
+            fprintf(out, "\n");
+
+            for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+            {
+                if (phi->forward)
+                    continue;
+                fprintf(out, "    _r%d = phi", phi->id);
+                for (int k = 0; k < phi->nargs; k++)
+                {
+                    if (b->preds[k]->order < 0)
+                        continue;
+                    fprintf(out, " [");
+                    print_operand(out, phi->args[k]);
+                    fprintf(out, ", _b%d]", b->preds[k]->id);
+                }
+                fprintf(out, " : %s\n", c_type(phi->type));
+            }
+
+            for (struct ir_value *v = b->first; v; v = v->next)
+            {
+                fprintf(out, "    ");
+                switch (v->op)
+                {
+                case IR_BINARY:
+                    fprintf(out, "_r%d = ", v->id);
+                    print_operand(out, v->args[0]);
+                    fprintf(out, " %s ", convert_expr_type(v->expr_type));
+                    print_operand(out, v->args[1]);
+                    break;
+                case IR_UNARY:
+                    fprintf(out, "_r%d = %s ", v->id, convert_expr_type(v->expr_type));
+                    print_operand(out, v->args[0]);
+                    break;
+                case IR_CALL:
+                    fprintf(out, "_r%d = call %s(", v->id, v->text);
+                    print_args(out, v);
+                    fprintf(out, ")");
+                    break;
+                case IR_PRINT:
+                    fprintf(out, "print \"%s\"%s", v->text, v->nargs ? ", " : "");
+                    print_args(out, v);
+                    break;
+                case IR_TABLE:
+                    fprintf(out, "_r%d = table {", v->id);
+                    print_args(out, v);
+                    fprintf(out, "}");
+                    break;
+                default:
+                    break;
+                }
+                if (v->op != IR_PRINT)
+                    fprintf(out, " : %s%s", c_type(v->type), v->uses || v->op == IR_CALL ? "" : " (morto)");
+                fprintf(out, "\n");
+            }
+
+            struct ir_value *t = b->term;
+            if (t->op == IR_JUMP)
+                fprintf(out, "    jump _b%d\n", t->targets[0]->id);
+            else if (t->op == IR_BRANCH)
+            {
+                fprintf(out, "    branch ");
+                print_operand(out, t->args[0]);
+                fprintf(out, ", _b%d, _b%d\n", t->targets[0]->id, t->targets[1]->id);
+            }
+            else
+            {
+                fprintf(out, "    return%s", t->nargs ? " " : "");
+                print_args(out, t);
+                fprintf(out, "\n");
+            }
+        }
+    }
+}
+
+/* Emissione del C.
+   Fuori dalla forma SSA ogni valore è una variabile C dichiarata all'inizio
+   della funzione; ogni phi ha una seconda variabile _in assegnata da tutti
+   i predecessori prima del salto e copiata all'ingresso del blocco, così
+   le copie non interferiscono tra loro e gli archi critici non vanno
+   spezzati. I blocchi seguono il layout, i salti al blocco successivo sono
+   omessi.
+*/
+
+static FILE *out;
+
+static const char *c_operator(enum EXPRESSION_TYPE op)
+{
+    switch (op)
+    {
+    case AND_T:
+        return "&&";
+    case OR_T:
+        return "||";
+    case NE_T:
+        return "!=";
+    case NOT_T:
+        return "!";
+    default:
+        return convert_expr_type(op);
+    }
+}
+
+// Il valore ha una variabile C propria
+static int has_temp(struct ir_value *v)
+{
+    switch (v->op)
+    {
+    case IR_BINARY:
+    case IR_UNARY:
+    case IR_CALL:
+    case IR_PHI:
+        return v->uses > 0 && !v->forward;
+    default:
+        return 0;
+    }
+}
+
+static struct ir_block *layout_next(struct ir_function *f, struct ir_block *b)
+{
+    return b->order + 1 < f->nlayout ? f->layout[b->order + 1] : NULL;
+}
+
+static void mark_labels(struct ir_function *f)
+{
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        struct ir_value *t = f->layout[i]->term;
+        struct ir_block *next = layout_next(f, f->layout[i]);
+
+        if (t->op == IR_JUMP && t->targets[0] != next)
+            t->targets[0]->label = 1;
+        else if (t->op == IR_BRANCH)
+        {
+            // Stessa scelta di emit_terminator: si salta solo al ramo che non segue nel layout
+            if (t->targets[0] == t->targets[1])
+                t->targets[0]->label |= t->targets[0] != next;
+            else if (t->targets[1] == next)
+                t->targets[0]->label = 1;
+            else if (t->targets[0] == next)
+                t->targets[1]->label = 1;
+            else
+                t->targets[0]->label = t->targets[1]->label = 1;
+        }
+    }
+}
+
+static void emit_declarations(struct ir_function *f)
+{
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *phi = f->layout[i]->phis; phi; phi = phi->next)
+        {
+            if (has_temp(phi))
+                fprintf(out, "    %s _r%d;\n    %s _r%d_in;\n", c_type(phi->type), phi->id, c_type(phi->type), phi->id);
+        }
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+        {
+            if (has_temp(v))
+                fprintf(out, "    %s _r%d;\n", c_type(v->type), v->id);
+        }
+    }
+}
+
+// Campo della union di lua_field per un valore, come in translate_node
+static const char *field_member(enum LUA_TYPE type)
+{
+    switch (type)
+    {
+    case STRING_T:
+        return "string_value";
+    case FLOAT_T:
+    case NUMBER_T:
+        return "float_value";
+    case TRUE_T:
+    case FALSE_T:
+        return "bool_value";
+    default:
+        return "int_value";
+    }
+}
+
+static void emit_table(struct ir_value *v)
+{
+    int auto_key = 0;
+    int k = 0;
+
+    runtime_use(RUNTIME_FIELD);
+    fprintf(out, "    lua_field _r%d[] = {", v->id);
+    for (struct AstNode *f = v->ast->node.table->fields; f; f = f->next, k++)
+    {
+        struct AstNode *key = f->nodetype == TABLE_FIELD_T ? f->node.tfield->key : NULL;
+        fprintf(out, "%s{ ", k ? ", " : " ");
+        if (key && key->nodetype == VAR_T)
+            fprintf(out, "\"%s\", ", key->node.var->name);
+        else
+            fprintf(out, "\"key_%d\", ", auto_key++);
+        fprintf(out, "{.%s = ", field_member(resolve(v->args[k])->type));
+        print_operand(out, v->args[k]);
+        fprintf(out, "} }");
+    }
+    fprintf(out, " };\n");
+}
+
+static void emit_value(struct ir_value *v)
+{
+    if (!v->uses && v->op != IR_CALL && v->op != IR_PRINT)
+        return;
+
+    switch (v->op)
+    {
+    case IR_BINARY:
+        fprintf(out, "    _r%d = ", v->id);
+        if (v->expr_type == DIV_T && strcmp(c_type(resolve(v->args[0])->type), "int") == 0 &&
+            strcmp(c_type(resolve(v->args[1])->type), "int") == 0)
+            fprintf(out, "(float)");
+        print_operand(out, v->args[0]);
+        fprintf(out, " %s ", c_operator(v->expr_type));
+        print_operand(out, v->args[1]);
+        fprintf(out, ";\n");
+        break;
+    case IR_UNARY:
+        fprintf(out, "    _r%d = %s", v->id, c_operator(v->expr_type));
+        print_operand(out, v->args[0]);
+        fprintf(out, ";\n");
+        break;
+    case IR_CALL:
+        runtime_use(runtime_helper(v->text));
+        fprintf(out, "    ");
+        if (v->uses)
+            fprintf(out, "_r%d = ", v->id);
+        fprintf(out, "%s(", v->text);
+        print_args(out, v);
+        fprintf(out, ");\n");
+        break;
+    case IR_PRINT:
+        fprintf(out, "    printf(\"%s\"", v->text);
+        for (int i = 0; i < v->nargs; i++)
+        {
+            fprintf(out, ", ");
+            if (resolve(v->args[i])->type == BOOLEAN_T)
+            {
+                fprintf(out, "(");
+                print_operand(out, v->args[i]);
+                fprintf(out, ") ? \"true\" : \"false\"");
+            }
+            else
+            {
+                print_operand(out, v->args[i]);
+            }
+        }
+        fprintf(out, ");\n");
+        break;
+    case IR_TABLE:
+        emit_table(v);
+        break;
+    default:
+        break;
+    }
+}
+
+// Copie verso le phi di un successore, prima del salto
+static void emit_phi_copies(struct ir_block *b, struct ir_block *succ)
+{
+    for (struct ir_value *phi = succ->phis; phi; phi = phi->next)
+    {
+        if (!has_temp(phi))
+            continue;
+        for (int k = 0; k < succ->npreds; k++)
+        {
+            if (succ->preds[k] == b)
+            {
+                fprintf(out, "    _r%d_in = ", phi->id);
+                print_operand(out, phi->args[k]);
+                fprintf(out, ";\n");
+                break;
+            }
+        }
+    }
+}
+
+static void emit_terminator(struct ir_function *f, struct ir_block *b)
+{
+    struct ir_value *t = b->term;
+    struct ir_block *next = layout_next(f, b);
+
+    switch (t->op)
+    {
+    case IR_JUMP:
+        emit_phi_copies(b, t->targets[0]);
+        if (t->targets[0] != next)
+            fprintf(out, "    goto _b%d;\n", t->targets[0]->id);
+        break;
+    case IR_BRANCH:
+        emit_phi_copies(b, t->targets[0]);
+        if (t->targets[0] == t->targets[1])
+        {
+            // Le due uscite coincidono (es. un if dal corpo vuoto): il ramo è un salto
+            if (t->targets[0] != next)
+                fprintf(out, "    goto _b%d;\n", t->targets[0]->id);
+            break;
+        }
+        emit_phi_copies(b, t->targets[1]);
+        if (t->targets[1] == next)
+        {
+            fprintf(out, "    if (");
+            print_operand(out, t->args[0]);
+            fprintf(out, ") goto _b%d;\n", t->targets[0]->id);
+        }
+        else if (t->targets[0] == next)
+        {
+            fprintf(out, "    if (!");
+            print_operand(out, t->args[0]);
+            fprintf(out, ") goto _b%d;\n", t->targets[1]->id);
+        }
+        else
+        {
+            fprintf(out, "    if (");
+            print_operand(out, t->args[0]);
+            fprintf(out, ") goto _b%d;\n    goto _b%d;\n", t->targets[0]->id, t->targets[1]->id);
+        }
+        break;
+    default:
+        if (t->nargs)
+        {
+            fprintf(out, "    return ");
+            print_operand(out, t->args[0]);
+            fprintf(out, ";\n");
+        }
+        else if (next)
+        {
+            fprintf(out, "    return;\n");
+        }
+        break;
+    }
+}
+
+// Firma della funzione, con gli attributi dell'analisi degli effetti; il corpo di una funzione memoizzata è
+// statico e ha il suffisso _memo, il wrapper non è const né pure
+static void emit_signature(struct ir_function *f, int body)
+{
+    if (!f->fdef)
+    {
+        fprintf(out, "int main() {\n");
+        return;
+    }
+
+    const char *prefix = f->memo && !body ? effects_wrapper_prefix(f->name) : effects_prefix(f->name);
+    if (body && f->memo && !*prefix)
+        prefix = "static ";
+    fprintf(out, "%s%s %s%s(", prefix, f->ret_type ? lua_type_to_c_string(f->ret_type) : "void", f->name,
+            body && f->memo ? "_memo" : "");
+    int first = 1;
+    for (struct AstNode *p = f->fdef->node.fdef->params; p; p = p->next)
+    {
+        struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+        if (var->nodetype == VAR_T)
+            fprintf(out, "%s%s %s", first ? "" : ", ", lua_type_to_c_string(param_type(p, root_symtab)),
+                    var->node.var->name);
+        else
+            fprintf(out, "%svoid* param%d", first ? "" : ", ", first ? 1 : 0);
+        first = 0;
+    }
+    fprintf(out, ") {\n");
+}
+
+static const char *memo_param_name(struct AstNode *p)
+{
+    return (p->nodetype == DECL_T ? p->node.decl->var : p)->node.var->name;
+}
+
+/* Wrapper di una funzione memoizzata, con il nome della funzione: le
+   chiamate, comprese quelle ricorsive del corpo, passano dalla cache. Con un
+   solo parametro intero i valori piccoli e non negativi usano una tabella
+   diretta; gli altri argomenti finiscono in una tabella hash a indirizzamento
+   diretto, dove una collisione sostituisce la voce precedente. Entrambe hanno
+   dimensione fissa.
+*/
+static void emit_memo_wrapper(struct ir_function *f)
+{
+    struct AstNode *params = f->fdef->node.fdef->params;
+    const char *ret = lua_type_to_c_string(f->ret_type);
+    int i;
+
+    emit_signature(f, 0);
+    if (!params->next && param_type(params, root_symtab) == INT_T)
+    {
+        const char *name = memo_param_name(params);
+        fprintf(out, "    static bool _memo_used[%d];\n", IR_MEMO_DIRECT_SIZE);
+        fprintf(out, "    static %s _memo_value[%d];\n", ret, IR_MEMO_DIRECT_SIZE);
+        fprintf(out, "    if (%s >= 0 && %s < %d) {\n", name, name, IR_MEMO_DIRECT_SIZE);
+        fprintf(out, "        if (!_memo_used[%s]) {\n", name);
+        fprintf(out, "            %s _memo_r = %s_memo(%s);\n", ret, f->name, name);
+        fprintf(out, "            _memo_value[%s] = _memo_r;\n", name);
+        fprintf(out, "            _memo_used[%s] = true;\n", name);
+        fprintf(out, "        }\n");
+        fprintf(out, "        return _memo_value[%s];\n", name);
+        fprintf(out, "    }\n");
+    }
+
+    fprintf(out, "    static struct {\n        bool used;\n");
+    i = 0;
+    for (struct AstNode *p = params; p; p = p->next, i++)
+        fprintf(out, "        %s a%d;\n", lua_type_to_c_string(param_type(p, root_symtab)), i);
+    fprintf(out, "        %s r;\n    } _memo[%d];\n", ret, IR_MEMO_HASH_SIZE);
+
+    // I float entrano nell'hash con i loro bit
+    fprintf(out, "    unsigned _memo_h = 0;\n");
+    for (struct AstNode *p = params; p; p = p->next)
+    {
+        const char *name = memo_param_name(p);
+        if (param_type(p, root_symtab) == INT_T || param_type(p, root_symtab) == BOOLEAN_T)
+            fprintf(out, "    _memo_h = _memo_h * 31u + (unsigned)%s;\n", name);
+        else
+            fprintf(out, "    { union { float f; unsigned u; } _memo_k; _memo_k.f = %s; _memo_h = _memo_h * 31u + _memo_k.u; }\n",
+                    name);
+    }
+    fprintf(out, "    _memo_h %%= %du;\n", IR_MEMO_HASH_SIZE);
+    fprintf(out, "    if (!_memo[_memo_h].used");
+    i = 0;
+    for (struct AstNode *p = params; p; p = p->next, i++)
+        fprintf(out, " || _memo[_memo_h].a%d != %s", i, memo_param_name(p));
+    fprintf(out, ") {\n        %s _memo_r = %s_memo(", ret, f->name);
+    for (struct AstNode *p = params; p; p = p->next)
+        fprintf(out, "%s%s", p == params ? "" : ", ", memo_param_name(p));
+    fprintf(out, ");\n        _memo[_memo_h].used = true;\n");
+    i = 0;
+    for (struct AstNode *p = params; p; p = p->next, i++)
+        fprintf(out, "        _memo[_memo_h].a%d = %s;\n", i, memo_param_name(p));
+    fprintf(out, "        _memo[_memo_h].r = _memo_r;\n    }\n");
+    fprintf(out, "    return _memo[_memo_h].r;\n}\n");
+}
+
+static void emit_function(struct ir_function *f)
+{
+    emit_signature(f, 1);
+    emit_declarations(f);
+    mark_labels(f);
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        struct ir_block *b = f->layout[i];
+        if (b->label)
+            fprintf(out, "_b%d:;\n", b->id);
+        for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+        {
+            if (has_temp(phi))
+                fprintf(out, "    _r%d = _r%d_in;\n", phi->id, phi->id);
+        }
+        for (struct ir_value *v = b->first; v; v = v->next)
+            emit_value(v);
+        emit_terminator(f, b);
+    }
+    fprintf(out, "}\n");
+    if (f->memo)
+        emit_memo_wrapper(f);
+}
+
+void ir_emit(struct ir_program *program, FILE *output)
+{
+    out = output;
+    for (struct ir_function *f = program->functions; f; f = f->next)
+        emit_function(f);
+}
+
+void ir_emit_function(struct ir_function *f, FILE *output)
+{
+    out = output;
+    emit_function(f);
+}
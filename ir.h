@@ -0,0 +1,145 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "symtab.h"
+
+/* Rappresentazione intermedia in forma SSA, costruita dall'AST dopo l'analisi
+   semantica. Ogni funzione è un grafo di blocchi base; ogni valore è definito
+   una sola volta e ha un tipo derivato da LUA_TYPE. Le variabili Lua non
+   compaiono nell'IR: ogni assegnazione produce un nuovo valore e i punti di
+   confluenza del flusso di controllo usano nodi phi.
+*/
+
+// Operazioni dell'IR
+enum IR_OP
+{
+    IR_CONST,  // letterale, usato direttamente come operando
+    IR_PARAM,  // parametro della funzione
+    IR_CAST,   // conversione al tipo della variabile assegnata
+    IR_BINARY, // operatore binario (expr_type)
+    IR_UNARY,  // NEG_T o NOT_T
+    IR_CALL,   // chiamata a funzione utente o di runtime
+    IR_PRINT,  // print: text è la stringa di formato
+    IR_TABLE,  // costruttore di tabella, un argomento per campo
+    IR_PHI,    // un argomento per predecessore del blocco
+    IR_JUMP,   // terminatori dei blocchi
+    IR_BRANCH,
+    IR_RETURN
+};
+
+struct ir_block;
+struct ir_def;
+
+// Valore (istruzione) dell'IR
+struct ir_value
+{
+    int id;
+    enum IR_OP op;
+    enum LUA_TYPE type;
+    enum EXPRESSION_TYPE expr_type; // IR_BINARY, IR_UNARY
+    const char *text;               // IR_CONST: testo C, IR_PARAM: nome, IR_CALL: funzione, IR_PRINT: formato
+    struct AstNode *ast;            // IR_TABLE: nodo della tabella, per le chiavi dei campi
+
+    struct ir_value **args;
+    int nargs;
+    int cap;
+
+    struct ir_block *block;      // blocco che lo contiene (NULL per costanti e parametri)
+    struct ir_block *targets[2]; // IR_JUMP, IR_BRANCH
+    struct ir_value *forward;    // phi banale: valore che la sostituisce
+    int var;                     // IR_PHI: variabile di cui unisce le definizioni
+    int incomplete;              // IR_PHI creata in un blocco non ancora sigillato
+    int uses;
+
+    struct ir_value *next; // istruzione successiva nel blocco
+};
+
+// Blocco base
+struct ir_block
+{
+    int id;
+    struct ir_value *phis;
+    struct ir_value *first;
+    struct ir_value *last;
+    struct ir_value *term; // terminatore, NULL finché il blocco è aperto
+
+    struct ir_block **preds;
+    int npreds;
+    int cap;
+    int sealed; // tutti i predecessori sono noti
+
+    int order; // posizione nel layout (reverse postorder), -1 se irraggiungibile
+    int label; // serve un'etichetta per i salti
+
+    struct ir_def *defs; // durante la costruzione: ultima definizione delle variabili nel blocco
+    int defs_cap;
+    int ndefs;
+
+    struct ir_block *next;
+};
+
+// Variabile Lua di una funzione
+struct ir_var
+{
+    char *name; // chiave della hash table
+    int id;
+    enum LUA_TYPE type;
+
+    UT_hash_handle hh;
+};
+
+struct ir_function
+{
+    char *name;            // NULL per main
+    struct AstNode *fdef;  // definizione, NULL per main
+    enum LUA_TYPE ret_type;
+    struct ir_block *entry;
+    struct ir_block *last_block;
+    struct ir_block **layout; // blocchi raggiungibili in reverse postorder
+    int nlayout;
+    struct ir_var *vars;
+    int nvars;
+    int nblocks;
+    int nvalues;
+    int memo; // emessa come corpo statico più un wrapper con la cache dei risultati
+
+    struct ir_function *next;
+    UT_hash_handle hh; // per nome, solo le funzioni utente
+};
+
+struct ir_program
+{
+    struct ir_function *functions; // funzioni nell'ordine del sorgente, main per ultima
+};
+
+// Voci della cache di una funzione memoizzata: tabella diretta per un solo parametro intero, hash per gli altri casi
+#define IR_MEMO_DIRECT_SIZE 1024
+#define IR_MEMO_HASH_SIZE 4096
+
+// Seleziona il backend basato sull'IR (--ir)
+extern int ir_flag;
+
+struct ir_program *ir_lower(struct AstNode *root);
+void ir_print(struct ir_program *program, FILE *out);
+void ir_emit(struct ir_program *program, FILE *out);
+// Una sola funzione, per le unità di --split
+void ir_emit_function(struct ir_function *f, FILE *out);
+
+// Usate dai passi di ottimizzazione (optimize.c)
+struct ir_value *ir_new_value(struct ir_function *fn, enum IR_OP op, enum LUA_TYPE type);
+struct ir_value *ir_new_const(struct ir_function *fn, enum LUA_TYPE type, const char *text);
+struct ir_value *ir_new_literal(struct ir_function *fn, struct AstNode *val);
+struct ir_block *ir_new_block(struct ir_function *fn);
+void ir_add_arg(struct ir_value *v, struct ir_value *arg);
+struct ir_value *ir_convert(struct ir_function *fn, struct ir_value *v, enum LUA_TYPE type);
+struct ir_function *ir_find_function(const char *name);
+// Tipo di una variabile di funzione alla prima assegnazione, usato anche da eval.c
+enum LUA_TYPE ir_local_type(struct AstNode *value, enum LUA_TYPE value_type);
+struct ir_value *ir_resolve(struct ir_value *v);
+void ir_add_pred(struct ir_block *b, struct ir_block *pred);
+void ir_remove_pred(struct ir_block *b, struct ir_block *pred);
+void ir_update(struct ir_function *fn);
+
+#endif
@@ -0,0 +1,198 @@
+#include "mem.h"
+#include "global.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/resource.h>
+
+#define MEM_MAX_PHASES 16
+
+// Header anteposto ad ogni blocco, allineato come max_align_t
+union mem_header
+{
+    struct
+    {
+        size_t size;
+        enum MEM_SUBSYSTEM sub;
+    } h;
+    max_align_t align;
+};
+
+// Contatori per sottosistema
+struct mem_counter
+{
+    long allocs;
+    size_t allocated; // byte allocati in totale
+    size_t live;      // byte ancora allocati
+};
+
+// Istantanea registrata al confine di una fase
+struct mem_snapshot
+{
+    const char *phase;
+    size_t live;
+    size_t peak;
+    long rss_kb;
+};
+
+size_t mem_budget = 0;
+
+static struct mem_counter counters[MEM_COUNT];
+static size_t live_total = 0;
+static size_t peak_total = 0;
+static struct mem_snapshot snapshots[MEM_MAX_PHASES];
+static int snapshot_count = 0;
+
+static const char *subsystem_names[MEM_COUNT] = {
+    "tokens", "ast", "symbols", "diagnostics", "output", "ir",
+};
+
+// Picco di memoria residente del processo in KB
+static long peak_rss_kb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss;
+}
+
+void *mem_alloc(enum MEM_SUBSYSTEM sub, size_t size)
+{
+    union mem_header *hdr = malloc(sizeof(union mem_header) + size);
+    if (!hdr)
+    {
+        fprintf(stderr, RED "fatal error:" RESET " out of memory allocating %zu bytes for %s\n", size,
+                subsystem_names[sub]);
+        exit(1);
+    }
+    hdr->h.size = size;
+    hdr->h.sub = sub;
+
+    counters[sub].allocs++;
+    counters[sub].allocated += size;
+    counters[sub].live += size;
+    live_total += size;
+    if (live_total > peak_total)
+        peak_total = live_total;
+
+    if (mem_budget && live_total > mem_budget)
+    {
+        fprintf(stderr,
+                RED "fatal error:" RESET " memory budget of %zu bytes exceeded (%zu bytes live, allocating %s)\n",
+                mem_budget, live_total, subsystem_names[sub]);
+        mem_report_text(stderr);
+        exit(1);
+    }
+
+    return hdr + 1;
+}
+
+// Ridimensiona un blocco mantenendone il sottosistema
+void *mem_realloc(void *p, size_t size)
+{
+    union mem_header *hdr = (union mem_header *)p - 1;
+    void *copy = mem_alloc(hdr->h.sub, size);
+    memcpy(copy, p, hdr->h.size < size ? hdr->h.size : size);
+    mem_free(p);
+    return copy;
+}
+
+char *mem_strdup(enum MEM_SUBSYSTEM sub, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *copy = mem_alloc(sub, len);
+    memcpy(copy, s, len);
+    return copy;
+}
+
+void mem_free(void *p)
+{
+    if (!p)
+        return;
+
+    union mem_header *hdr = (union mem_header *)p - 1;
+    counters[hdr->h.sub].live -= hdr->h.size;
+    live_total -= hdr->h.size;
+    free(hdr);
+}
+
+void mem_phase(const char *phase)
+{
+    if (snapshot_count == MEM_MAX_PHASES)
+        return;
+
+    snapshots[snapshot_count].phase = phase;
+    snapshots[snapshot_count].live = live_total;
+    snapshots[snapshot_count].peak = peak_total;
+    snapshots[snapshot_count].rss_kb = peak_rss_kb();
+    snapshot_count++;
+}
+
+size_t mem_parse_size(const char *s)
+{
+    char *end;
+    unsigned long long n = strtoull(s, &end, 10);
+
+    if (end == s)
+        return 0;
+
+    switch (*end)
+    {
+    case 'K':
+    case 'k':
+        n <<= 10;
+        end++;
+        break;
+    case 'M':
+    case 'm':
+        n <<= 20;
+        end++;
+        break;
+    case 'G':
+    case 'g':
+        n <<= 30;
+        end++;
+        break;
+    }
+
+    return *end == '\0' ? (size_t)n : 0;
+}
+
+void mem_report_text(FILE *out)
+{
+    fprintf(out, "\n%-26s %12s %14s %12s\n", "memoria", "allocazioni", "byte allocati", "byte vivi");
+    for (int i = 0; i < MEM_COUNT; i++)
+    {
+        fprintf(out, "%-26s %12ld %14zu %12zu\n", subsystem_names[i], counters[i].allocs, counters[i].allocated,
+                counters[i].live);
+    }
+    fprintf(out, "%-26s %12s %14s %12zu\n", "totale", "", "", live_total);
+    fprintf(out, "%-26s %zu byte, RSS massimo %ld KB\n", "picco", peak_total, peak_rss_kb());
+    if (mem_budget)
+        fprintf(out, "%-26s %zu byte\n", "budget", mem_budget);
+
+    for (int i = 0; i < snapshot_count; i++)
+    {
+        fprintf(out, "  dopo %-20s vivi %zu, picco %zu, RSS %ld KB\n", snapshots[i].phase, snapshots[i].live,
+                snapshots[i].peak, snapshots[i].rss_kb);
+    }
+}
+
+void mem_report_json(FILE *out)
+{
+    fprintf(out, "{\n    \"subsystems\": {");
+    for (int i = 0; i < MEM_COUNT; i++)
+    {
+        fprintf(out, "%s\n      \"%s\": {\"allocs\": %ld, \"allocated\": %zu, \"live\": %zu}", i ? "," : "",
+                subsystem_names[i], counters[i].allocs, counters[i].allocated, counters[i].live);
+    }
+    fprintf(out, "\n    },\n    \"live\": %zu,\n    \"peak\": %zu,\n    \"peak_rss_kb\": %ld,\n    \"budget\": %zu,\n",
+            live_total, peak_total, peak_rss_kb(), mem_budget);
+    fprintf(out, "    \"phases\": [");
+    for (int i = 0; i < snapshot_count; i++)
+    {
+        fprintf(out, "%s\n      {\"phase\": \"%s\", \"live\": %zu, \"peak\": %zu, \"rss_kb\": %ld}", i ? "," : "",
+                snapshots[i].phase, snapshots[i].live, snapshots[i].peak, snapshots[i].rss_kb);
+    }
+    fprintf(out, "\n    ]\n  }");
+}
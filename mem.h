@@ -0,0 +1,40 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Sottosistemi a cui vengono attribuite le allocazioni
+enum MEM_SUBSYSTEM
+{
+    MEM_TOKENS,
+    MEM_AST,
+    MEM_SYMBOLS,
+    MEM_DIAGNOSTICS,
+    MEM_OUTPUT,
+    MEM_IR,
+    MEM_COUNT
+};
+
+// Budget di memoria in byte (--mem-budget), 0 = nessun limite
+extern size_t mem_budget;
+
+/* Allocazione con contabilità: ogni blocco è preceduto da un header con
+   dimensione e sottosistema, così mem_free può aggiornare i byte vivi.
+   Se il budget viene superato il transpiler termina con errore.
+*/
+void *mem_alloc(enum MEM_SUBSYSTEM sub, size_t size);
+void *mem_realloc(void *p, size_t size);
+char *mem_strdup(enum MEM_SUBSYSTEM sub, const char *s);
+void mem_free(void *p);
+
+// Registra byte vivi, picco e RSS al confine di una fase
+void mem_phase(const char *phase);
+
+// Converte una dimensione con suffisso opzionale K, M o G; 0 se non valida
+size_t mem_parse_size(const char *s);
+
+void mem_report_text(FILE *out);
+void mem_report_json(FILE *out);
+
+#endif
@@ -0,0 +1,2042 @@
+#include "optimize.h"
+#include "fold.h"
+#include "global.h"
+#include "translate.h"
+#include "mem.h"
+#include <limits.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Propagazione sparsa delle costanti con archi condizionali (Wegman e
+   Zadeck). Ogni valore parte da TOP (nessuna informazione) e può solo
+   scendere a una costante e poi a BOTTOM (non costante). Un blocco è
+   eseguibile se lo è almeno uno dei suoi archi entranti; le phi considerano
+   solo gli argomenti che arrivano da archi eseguibili, così una variabile
+   che resta costante lungo tutti i cammini possibili diventa una costante
+   anche attraverso cicli e if con condizione nota.
+*/
+
+enum LATTICE
+{
+    LAT_TOP,
+    LAT_CONST,
+    LAT_BOTTOM
+};
+
+struct sccp
+{
+    struct ir_function *f;
+    int nvalues; // i valori creati dopo l'analisi non hanno uno stato
+
+    char *state;
+    struct const_value *value;
+
+    // Istruzioni che usano ogni valore: quelle di id sono users[user_start[id]] .. users[user_start[id + 1] - 1]
+    struct ir_value **users;
+    int *user_start;
+    int *user_pos;
+
+    char *executable; // per blocco
+    char **pred_exec; // per blocco, un flag per ogni arco entrante
+
+    struct ir_block **block_work;
+    int nblock_work;
+    struct ir_value **value_work;
+    int nvalue_work;
+};
+
+// Stato di un valore; costanti e conversioni non stanno in un blocco e sono valutate al momento
+static enum LATTICE value_state(struct sccp *s, struct ir_value *v, struct const_value *out)
+{
+    v = ir_resolve(v);
+    switch (v->op)
+    {
+    case IR_CONST:
+        return const_parse_c(v->type, v->text, out) ? LAT_CONST : LAT_BOTTOM;
+    case IR_PARAM:
+        return LAT_BOTTOM;
+    case IR_CAST:
+    {
+        struct const_value a;
+        enum LATTICE st = value_state(s, v->args[0], &a);
+        if (st != LAT_CONST)
+            return st;
+        return const_convert(&a, v->type, out) ? LAT_CONST : LAT_BOTTOM;
+    }
+    default:
+        if (v->id >= s->nvalues)
+            return LAT_BOTTOM;
+        if (s->state[v->id] == LAT_CONST)
+            *out = s->value[v->id];
+        return s->state[v->id];
+    }
+}
+
+// Valore usato da un'istruzione, attraversando le conversioni in linea
+static struct ir_value *underlying(struct ir_value *v)
+{
+    v = ir_resolve(v);
+    while (v->op == IR_CAST)
+        v = ir_resolve(v->args[0]);
+    return v;
+}
+
+/* Le catene def-uso sono costruite in due passate sulle stesse istruzioni:
+   la prima conta gli utenti di ogni valore, la seconda li scrive in un
+   unico array. Un vettore allocato per ogni valore sparpaglierebbe le liste
+   nella memoria, e la costruzione costerebbe più che linearmente al
+   crescere della funzione.
+*/
+static void add_user(struct sccp *s, struct ir_value *v, struct ir_value *user)
+{
+    v = underlying(v);
+    if (v->op == IR_CONST || v->op == IR_PARAM)
+        return;
+
+    if (s->users)
+        s->users[s->user_pos[v->id]++] = user;
+    else
+        s->user_start[v->id + 1]++;
+}
+
+static void add_users(struct sccp *s, struct ir_value *user)
+{
+    for (int i = 0; i < user->nargs; i++)
+        add_user(s, user->args[i], user);
+}
+
+// Abbassa lo stato di un valore; se cambia, i suoi utenti vanno rivalutati
+static void update(struct sccp *s, struct ir_value *v, enum LATTICE st, const struct const_value *c)
+{
+    int id = v->id;
+    if (s->state[id] == LAT_BOTTOM || st == LAT_TOP)
+        return;
+
+    if (st == LAT_CONST && s->state[id] == LAT_CONST)
+    {
+        struct const_value same;
+        const struct const_value *old = &s->value[id];
+        if (const_binary(EQ_T, old, c, &same) && same.b && old->type == c->type)
+            return;
+        st = LAT_BOTTOM;
+    }
+
+    s->state[id] = st;
+    if (st == LAT_CONST)
+        s->value[id] = *c;
+    s->value_work[s->nvalue_work++] = v;
+}
+
+static void visit_phi(struct sccp *s, struct ir_value *phi)
+{
+    struct ir_block *b = phi->block;
+    enum LATTICE result = LAT_TOP;
+    struct const_value c, first;
+
+    for (int k = 0; k < phi->nargs && k < b->npreds && result != LAT_BOTTOM; k++)
+    {
+        if (!s->pred_exec[b->id][k])
+            continue;
+
+        enum LATTICE st = value_state(s, phi->args[k], &c);
+        if (st == LAT_TOP)
+            continue;
+        if (st == LAT_BOTTOM)
+        {
+            result = LAT_BOTTOM;
+        }
+        else if (result == LAT_TOP)
+        {
+            result = LAT_CONST;
+            first = c;
+        }
+        else
+        {
+            struct const_value same;
+            if (!const_binary(EQ_T, &first, &c, &same) || !same.b || first.type != c.type)
+                result = LAT_BOTTOM;
+        }
+    }
+    update(s, phi, result, &first);
+}
+
+static void visit_instruction(struct sccp *s, struct ir_value *v)
+{
+    struct const_value a, b, r, c;
+    enum LATTICE sa, sb;
+
+    switch (v->op)
+    {
+    case IR_UNARY:
+        sa = value_state(s, v->args[0], &a);
+        if (sa != LAT_CONST)
+        {
+            update(s, v, sa, NULL);
+            return;
+        }
+        if (const_unary(v->expr_type, &a, &r) && const_convert(&r, v->type, &c))
+            update(s, v, LAT_CONST, &c);
+        else
+            update(s, v, LAT_BOTTOM, NULL);
+        break;
+    case IR_BINARY:
+        sa = value_state(s, v->args[0], &a);
+        sb = value_state(s, v->args[1], &b);
+        if (sa == LAT_BOTTOM || sb == LAT_BOTTOM)
+        {
+            update(s, v, LAT_BOTTOM, NULL);
+            return;
+        }
+        if (sa == LAT_TOP || sb == LAT_TOP)
+            return;
+        if (const_binary(v->expr_type, &a, &b, &r) && const_convert(&r, v->type, &c))
+            update(s, v, LAT_CONST, &c);
+        else
+            update(s, v, LAT_BOTTOM, NULL);
+        break;
+    default:
+        // Chiamate, print e costruttori di tabella non sono costanti
+        update(s, v, LAT_BOTTOM, NULL);
+        break;
+    }
+}
+
+static void mark_edge(struct sccp *s, struct ir_block *from, struct ir_block *to)
+{
+    int already = s->executable[to->id];
+
+    for (int k = 0; k < to->npreds; k++)
+    {
+        if (to->preds[k] == from)
+            s->pred_exec[to->id][k] = 1;
+    }
+
+    if (!already)
+    {
+        s->executable[to->id] = 1;
+        s->block_work[s->nblock_work++] = to;
+    }
+    else
+    {
+        // Un nuovo arco verso un blocco già visitato cambia solo le sue phi
+        for (struct ir_value *phi = to->phis; phi; phi = phi->next)
+        {
+            if (!phi->forward)
+                visit_phi(s, phi);
+        }
+    }
+}
+
+static void visit_terminator(struct sccp *s, struct ir_value *t)
+{
+    struct const_value c;
+    int truth;
+
+    if (t->op == IR_JUMP)
+    {
+        mark_edge(s, t->block, t->targets[0]);
+    }
+    else if (t->op == IR_BRANCH)
+    {
+        enum LATTICE st = value_state(s, t->args[0], &c);
+        if (st == LAT_TOP)
+            return;
+        if (st == LAT_CONST && const_truth(&c, &truth))
+        {
+            mark_edge(s, t->block, t->targets[truth ? 0 : 1]);
+        }
+        else
+        {
+            mark_edge(s, t->block, t->targets[0]);
+            mark_edge(s, t->block, t->targets[1]);
+        }
+    }
+}
+
+static void visit_user(struct sccp *s, struct ir_value *u)
+{
+    if (!s->executable[u->block->id])
+        return;
+    if (u == u->block->term)
+        visit_terminator(s, u);
+    else if (u->op == IR_PHI)
+        visit_phi(s, u);
+    else
+        visit_instruction(s, u);
+}
+
+static void visit_block(struct sccp *s, struct ir_block *b)
+{
+    for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+    {
+        if (!phi->forward)
+            visit_phi(s, phi);
+    }
+    for (struct ir_value *v = b->first; v; v = v->next)
+        visit_instruction(s, v);
+    if (b->term)
+        visit_terminator(s, b->term);
+}
+
+// Sostituisce con una costante l'operando k di un'istruzione, se l'analisi lo ha dimostrato costante
+static long replace_operand(struct sccp *s, struct ir_value *v, int k)
+{
+    struct ir_value *a = ir_resolve(v->args[k]);
+    struct const_value c;
+
+    if (a->op == IR_CONST || value_state(s, a, &c) != LAT_CONST)
+        return 0;
+
+    char *text = const_to_text(&c, MEM_IR);
+    if (!text)
+        return 0;
+    v->args[k] = ir_new_const(s->f, a->type, text);
+    return 1;
+}
+
+static long rewrite(struct sccp *s)
+{
+    long changes = 0;
+
+    for (int i = 0; i < s->f->nlayout; i++)
+    {
+        struct ir_block *b = s->f->layout[i];
+        if (!s->executable[b->id])
+            continue;
+
+        for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+        {
+            for (int k = 0; !phi->forward && k < phi->nargs && k < b->npreds; k++)
+            {
+                if (s->pred_exec[b->id][k])
+                    changes += replace_operand(s, phi, k);
+            }
+        }
+        for (struct ir_value *v = b->first; v; v = v->next)
+        {
+            for (int k = 0; k < v->nargs; k++)
+                changes += replace_operand(s, v, k);
+        }
+
+        if (b->term && b->term->op == IR_RETURN)
+        {
+            for (int k = 0; k < b->term->nargs; k++)
+                changes += replace_operand(s, b->term, k);
+        }
+    }
+
+    // Dopo le sostituzioni, perché togliere un arco sposta gli indici dei predecessori
+    for (int i = 0; i < s->f->nlayout; i++)
+    {
+        struct ir_block *b = s->f->layout[i];
+        struct ir_value *t = b->term;
+        if (!s->executable[b->id] || !t)
+            continue;
+
+        // Salto condizionato con un solo arco eseguibile: diventa un salto semplice
+        struct const_value c;
+        int truth;
+        if (t->op == IR_BRANCH && value_state(s, t->args[0], &c) == LAT_CONST && const_truth(&c, &truth))
+        {
+            struct ir_block *taken = t->targets[truth ? 0 : 1];
+            struct ir_block *other = t->targets[truth ? 1 : 0];
+
+            ir_remove_pred(other, b);
+            t->op = IR_JUMP;
+            t->nargs = 0;
+            t->targets[0] = taken;
+            t->targets[1] = NULL;
+            changes++;
+        }
+    }
+    return changes;
+}
+
+// Registra gli utenti degli operandi delle istruzioni dei blocchi raggiungibili
+static void collect_users(struct sccp *s)
+{
+    for (int i = 0; i < s->f->nlayout; i++)
+    {
+        struct ir_block *b = s->f->layout[i];
+        for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+        {
+            if (!phi->forward)
+                add_users(s, phi);
+        }
+        for (struct ir_value *v = b->first; v; v = v->next)
+            add_users(s, v);
+        if (b->term)
+            add_users(s, b->term);
+    }
+}
+
+/* L'analisi e la riscrittura considerano solo i blocchi del layout: quelli
+   irraggiungibili non diventano mai eseguibili, e dopo il primo giro di
+   propagazione possono essere la maggior parte dei blocchi della funzione.
+*/
+long ir_sccp(struct ir_function *f)
+{
+    struct sccp s;
+    int nblocks = f->nblocks;
+
+    memset(&s, 0, sizeof(s));
+    s.f = f;
+    s.nvalues = f->nvalues;
+    s.state = mem_alloc(MEM_IR, s.nvalues);
+    s.value = mem_alloc(MEM_IR, s.nvalues * sizeof(struct const_value));
+    s.user_start = mem_alloc(MEM_IR, (s.nvalues + 1) * sizeof(int));
+    s.user_pos = mem_alloc(MEM_IR, (s.nvalues + 1) * sizeof(int));
+    s.value_work = mem_alloc(MEM_IR, (2 * s.nvalues + 1) * sizeof(struct ir_value *));
+    memset(s.state, LAT_TOP, s.nvalues);
+    memset(s.user_start, 0, (s.nvalues + 1) * sizeof(int));
+
+    s.executable = mem_alloc(MEM_IR, nblocks);
+    s.pred_exec = mem_alloc(MEM_IR, nblocks * sizeof(char *));
+    s.block_work = mem_alloc(MEM_IR, nblocks * sizeof(struct ir_block *));
+    memset(s.executable, 0, nblocks);
+
+    // Catene def-uso e archi dei blocchi raggiungibili
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        struct ir_block *b = f->layout[i];
+        s.pred_exec[b->id] = mem_alloc(MEM_IR, b->npreds + 1);
+        memset(s.pred_exec[b->id], 0, b->npreds + 1);
+    }
+    collect_users(&s);
+    for (int i = 0; i < s.nvalues; i++)
+        s.user_start[i + 1] += s.user_start[i];
+    memcpy(s.user_pos, s.user_start, (s.nvalues + 1) * sizeof(int));
+    s.users = mem_alloc(MEM_IR, (s.user_start[s.nvalues] + 1) * sizeof(struct ir_value *));
+    collect_users(&s);
+
+    s.executable[f->entry->id] = 1;
+    s.block_work[s.nblock_work++] = f->entry;
+    while (s.nblock_work > 0 || s.nvalue_work > 0)
+    {
+        if (s.nblock_work > 0)
+        {
+            visit_block(&s, s.block_work[--s.nblock_work]);
+            continue;
+        }
+        struct ir_value *v = s.value_work[--s.nvalue_work];
+        for (int i = s.user_start[v->id]; i < s.user_start[v->id + 1]; i++)
+            visit_user(&s, s.users[i]);
+    }
+
+    long changes = rewrite(&s);
+
+    for (int i = 0; i < f->nlayout; i++)
+        mem_free(s.pred_exec[f->layout[i]->id]);
+    mem_free(s.state);
+    mem_free(s.value);
+    mem_free(s.users);
+    mem_free(s.user_start);
+    mem_free(s.user_pos);
+    mem_free(s.value_work);
+    mem_free(s.executable);
+    mem_free(s.pred_exec);
+    mem_free(s.block_work);
+    return changes;
+}
+
+/* Salto dei blocchi vuoti */
+
+// Il blocco non emette istruzioni: solo valori puri senza usi
+static int block_is_empty(struct ir_block *b)
+{
+    for (struct ir_value *v = b->first; v; v = v->next)
+    {
+        if (v->uses || v->op == IR_CALL || v->op == IR_PRINT)
+            return 0;
+    }
+    return 1;
+}
+
+// Blocco vuoto che salta a un blocco senza phi: i salti verso di esso possono andare oltre
+static struct ir_block *jump_target(struct ir_block *b)
+{
+    int steps = 0;
+    while (block_is_empty(b) && b->term->op == IR_JUMP && b->term->targets[0] != b && steps++ < 64)
+    {
+        struct ir_block *next = b->term->targets[0];
+        for (struct ir_value *phi = next->phis; phi; phi = phi->next)
+        {
+            if (!phi->forward)
+                return b;
+        }
+        for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+        {
+            if (!phi->forward)
+                return b;
+        }
+        b = next;
+    }
+    return b;
+}
+
+/* Salta i blocchi vuoti, ad esempio l'uscita di un ciclo seguita dalla fine
+   di un if. I blocchi scavalcati diventano irraggiungibili e spariscono dal
+   layout al successivo ir_update. Restituisce il numero di archi spostati.
+*/
+long ir_thread_jumps(struct ir_function *f)
+{
+    long changes = 0;
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        struct ir_block *b = f->layout[i];
+        int n = b->term->op == IR_BRANCH ? 2 : b->term->op == IR_JUMP ? 1 : 0;
+        for (int k = 0; k < n; k++)
+        {
+            struct ir_block *old = b->term->targets[k];
+            struct ir_block *target = jump_target(old);
+            if (target != old)
+            {
+                b->term->targets[k] = target;
+                ir_remove_pred(old, b);
+                ir_add_pred(target, b);
+                changes++;
+            }
+        }
+    }
+    return changes;
+}
+
+/* Espansione in linea */
+
+// Costo massimo (istruzioni vive e phi) di una funzione espandibile
+#define INLINE_MAX_COST 40
+// Istruzioni che una singola esecuzione del passo può aggiungere a una funzione
+#define INLINE_MAX_GROWTH 400
+
+struct clone
+{
+    struct ir_function *f;      // chiamante
+    struct ir_function *callee;
+    struct ir_value **values;   // copie, per id del valore nel chiamato
+    struct ir_block **blocks;   // copie, per id del blocco nel chiamato
+    struct ir_value **params;   // argomenti già convertiti, per posizione
+};
+
+/* Costo della funzione chiamata, -1 se non può essere espansa: è ricorsiva,
+   il blocco d'ingresso ha predecessori o, se il risultato serve, qualche
+   return non ha valore.
+*/
+static int inline_cost(struct ir_function *callee, int needs_value)
+{
+    int cost = 0;
+
+    if (callee->entry->npreds > 0)
+        return -1;
+    // Il valore deve avere un tipo C che il chiamante sa convertire
+    if (needs_value && callee->ret_type != INT_T && callee->ret_type != FLOAT_T && callee->ret_type != NUMBER_T &&
+        callee->ret_type != STRING_T && callee->ret_type != BOOLEAN_T)
+        return -1;
+    for (int i = 0; i < callee->nlayout; i++)
+    {
+        struct ir_block *b = callee->layout[i];
+        for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+        {
+            if (!phi->forward && phi->uses)
+                cost++;
+        }
+        for (struct ir_value *v = b->first; v; v = v->next)
+        {
+            if (v->op == IR_CALL && strcmp(v->text, callee->name) == 0)
+                return -1;
+            if (v->uses || v->op == IR_CALL || v->op == IR_PRINT)
+                cost++;
+        }
+        if (b->term->op == IR_RETURN && needs_value && !b->term->nargs)
+            return -1;
+        cost++;
+    }
+    return cost;
+}
+
+static int count_params(struct ir_function *callee)
+{
+    int n = 0;
+    for (struct AstNode *p = callee->fdef->node.fdef->params; p; p = p->next)
+        n++;
+    return n;
+}
+
+static int param_index(struct ir_function *callee, const char *name)
+{
+    int i = 0;
+    for (struct AstNode *p = callee->fdef->node.fdef->params; p; p = p->next, i++)
+    {
+        struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+        if (var->nodetype == VAR_T && strcmp(var->node.var->name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Argomenti convertiti al tipo dei parametri, come nella chiamata C; i
+   parametri con valore di default non passati prendono il default.
+   Restituisce 0 se il numero di argomenti non corrisponde.
+*/
+static int bind_params(struct clone *c, struct ir_value *call)
+{
+    int i = 0;
+    for (struct AstNode *p = c->callee->fdef->node.fdef->params; p; p = p->next, i++)
+    {
+        struct ir_value *arg;
+        if (i < call->nargs)
+            arg = call->args[i];
+        else if (p->nodetype == DECL_T && p->node.decl->expr && p->node.decl->expr->nodetype == VAL_T)
+            arg = ir_new_literal(c->f, p->node.decl->expr);
+        else
+            return 0;
+        c->params[i] = ir_convert(c->f, arg, param_type(p, root_symtab));
+    }
+    return call->nargs <= i;
+}
+
+// Copia di un valore del chiamato; gli argomenti delle phi sono collegati dopo aver copiato tutti i blocchi
+static struct ir_value *clone_value(struct clone *c, struct ir_value *v)
+{
+    v = ir_resolve(v);
+    if (v->op == IR_PARAM)
+        return c->params[param_index(c->callee, v->text)];
+    if (c->values[v->id])
+        return c->values[v->id];
+
+    struct ir_value *copy = ir_new_value(c->f, v->op, v->type);
+    copy->expr_type = v->expr_type;
+    copy->text = v->text;
+    copy->ast = v->ast;
+    copy->var = v->var;
+    c->values[v->id] = copy;
+    if (v->op != IR_PHI)
+    {
+        for (int i = 0; i < v->nargs; i++)
+            ir_add_arg(copy, clone_value(c, v->args[i]));
+    }
+    return copy;
+}
+
+// Divide il blocco dopo l'istruzione: il resto e il terminatore passano a un nuovo blocco
+static struct ir_block *split_after(struct ir_function *f, struct ir_value *call)
+{
+    struct ir_block *b = call->block;
+    struct ir_block *rest = ir_new_block(f);
+    struct ir_value *prev = NULL;
+
+    for (struct ir_value *v = b->first; v != call; v = v->next)
+        prev = v;
+    rest->first = call->next;
+    rest->last = call->next ? b->last : NULL;
+    for (struct ir_value *v = rest->first; v; v = v->next)
+        v->block = rest;
+    if (prev)
+        prev->next = NULL;
+    else
+        b->first = NULL;
+    b->last = prev;
+    call->next = NULL;
+
+    rest->term = b->term;
+    rest->term->block = rest;
+    b->term = NULL;
+    int n = rest->term->op == IR_BRANCH ? 2 : rest->term->op == IR_JUMP ? 1 : 0;
+    for (int k = 0; k < n; k++)
+    {
+        struct ir_block *succ = rest->term->targets[k];
+        if (k == 1 && succ == rest->term->targets[0])
+            break;
+        for (int j = 0; j < succ->npreds; j++)
+        {
+            if (succ->preds[j] == b)
+                succ->preds[j] = rest;
+        }
+    }
+    return rest;
+}
+
+/* Copia i blocchi raggiungibili del chiamato nella funzione e restituisce la
+   copia del blocco d'ingresso. Con rest ogni return diventa un salto a rest
+   e il suo valore, convertito come farebbe il return del C e poi al tipo
+   della chiamata, diventa un argomento della phi result; senza rest i
+   return restano return della funzione.
+*/
+static struct ir_block *clone_blocks(struct clone *c, struct ir_block *rest, struct ir_value *result)
+{
+    struct ir_function *f = c->f;
+    struct ir_function *callee = c->callee;
+
+    for (int i = 0; i < callee->nlayout; i++)
+        c->blocks[callee->layout[i]->id] = ir_new_block(f);
+
+    for (int i = 0; i < callee->nlayout; i++)
+    {
+        struct ir_block *from = callee->layout[i];
+        struct ir_block *to = c->blocks[from->id];
+
+        for (int k = 0; k < from->npreds; k++)
+        {
+            if (from->preds[k]->order >= 0)
+                ir_add_pred(to, c->blocks[from->preds[k]->id]);
+        }
+        for (struct ir_value *phi = from->phis; phi; phi = phi->next)
+        {
+            if (phi->forward)
+                continue;
+            struct ir_value *copy = clone_value(c, phi);
+            copy->block = to;
+            copy->next = to->phis;
+            to->phis = copy;
+        }
+        for (struct ir_value *v = from->first; v; v = v->next)
+        {
+            struct ir_value *copy = clone_value(c, v);
+            copy->block = to;
+            if (to->last)
+                to->last->next = copy;
+            else
+                to->first = copy;
+            to->last = copy;
+        }
+
+        struct ir_value *t = from->term;
+        struct ir_value *term = ir_new_value(f, t->op == IR_RETURN && rest ? IR_JUMP : t->op, NIL_T);
+        term->block = to;
+        to->term = term;
+        if (t->op == IR_RETURN && rest)
+        {
+            term->targets[0] = rest;
+            ir_add_pred(rest, to);
+            if (result)
+                ir_add_arg(result, ir_convert(f, ir_convert(f, clone_value(c, t->args[0]), callee->ret_type),
+                                              result->type));
+        }
+        else
+        {
+            for (int k = 0; k < t->nargs; k++)
+                ir_add_arg(term, clone_value(c, t->args[k]));
+            if (t->op != IR_RETURN)
+            {
+                term->targets[0] = c->blocks[t->targets[0]->id];
+                term->targets[1] = t->op == IR_BRANCH ? c->blocks[t->targets[1]->id] : NULL;
+            }
+        }
+    }
+
+    // Argomenti delle phi copiate, nell'ordine dei predecessori raggiungibili
+    for (int i = 0; i < callee->nlayout; i++)
+    {
+        struct ir_block *from = callee->layout[i];
+        for (struct ir_value *phi = from->phis; phi; phi = phi->next)
+        {
+            if (phi->forward)
+                continue;
+            for (int k = 0; k < phi->nargs; k++)
+            {
+                if (from->preds[k]->order >= 0)
+                    ir_add_arg(c->values[phi->id], clone_value(c, phi->args[k]));
+            }
+        }
+    }
+    return c->blocks[callee->entry->id];
+}
+
+static void jump_to(struct ir_function *f, struct ir_block *b, struct ir_block *target)
+{
+    struct ir_value *jump = ir_new_value(f, IR_JUMP, NIL_T);
+    jump->targets[0] = target;
+    jump->block = b;
+    b->term = jump;
+    ir_add_pred(target, b);
+}
+
+static void clone_init(struct clone *c, struct ir_function *f, struct ir_function *callee)
+{
+    c->f = f;
+    c->callee = callee;
+    c->values = mem_alloc(MEM_IR, callee->nvalues * sizeof(struct ir_value *));
+    c->blocks = mem_alloc(MEM_IR, callee->nblocks * sizeof(struct ir_block *));
+    memset(c->values, 0, callee->nvalues * sizeof(struct ir_value *));
+    memset(c->blocks, 0, callee->nblocks * sizeof(struct ir_block *));
+}
+
+static void clone_free(struct clone *c)
+{
+    mem_free(c->values);
+    mem_free(c->blocks);
+}
+
+/* Sostituisce la chiamata con una copia del corpo della funzione: il blocco
+   viene diviso dopo la chiamata, salta all'ingresso della copia e ogni
+   return diventa un salto al resto del blocco, dove una phi raccoglie il
+   risultato.
+*/
+static void inline_call(struct clone *c, struct ir_value *call)
+{
+    struct ir_function *f = c->f;
+    struct ir_block *b = call->block;
+    struct ir_block *rest = split_after(f, call);
+    struct ir_value *result = NULL;
+
+    if (call->uses)
+    {
+        result = ir_new_value(f, IR_PHI, call->type);
+        result->block = rest;
+        rest->phis = result;
+    }
+
+    jump_to(f, b, clone_blocks(c, rest, result));
+    call->forward = result ? result : ir_new_const(f, call->type, "0");
+}
+
+/* Espande nei chiamanti le funzioni piccole e non ricorsive. Le chiamate
+   sono raccolte prima di iniziare, quindi quelle contenute nei corpi appena
+   copiati aspettano l'iterazione successiva della pipeline (-O2).
+*/
+long ir_inline(struct ir_function *f)
+{
+    struct ir_value **calls = NULL;
+    int ncalls = 0, cap = 0;
+    long changes = 0;
+    int growth = 0;
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+        {
+            if (v->op != IR_CALL)
+                continue;
+            if (ncalls == cap)
+            {
+                cap = cap ? cap * 2 : 8;
+                calls = calls ? mem_realloc(calls, cap * sizeof(struct ir_value *))
+                              : mem_alloc(MEM_IR, cap * sizeof(struct ir_value *));
+            }
+            calls[ncalls++] = v;
+        }
+    }
+
+    for (int i = 0; i < ncalls; i++)
+    {
+        struct ir_value *call = calls[i];
+        struct ir_function *callee = ir_find_function(call->text);
+        if (!callee || callee == f)
+            continue;
+        int cost = inline_cost(callee, call->uses > 0);
+        if (cost < 0 || cost > INLINE_MAX_COST || growth + cost > INLINE_MAX_GROWTH)
+            continue;
+
+        struct clone c;
+        c.f = f;
+        c.callee = callee;
+        c.params = mem_alloc(MEM_IR, (count_params(callee) + 1) * sizeof(struct ir_value *));
+        if (bind_params(&c, call))
+        {
+            clone_init(&c, f, callee);
+            inline_call(&c, call);
+            clone_free(&c);
+            growth += cost;
+            changes++;
+        }
+        mem_free(c.params);
+    }
+
+    if (calls)
+        mem_free(calls);
+    return changes;
+}
+
+/* Chiamate in coda */
+
+// Funzioni massime in un gruppo mutuamente ricorsivo e costo massimo di ogni membro copiato negli altri
+#define TAIL_MAX_GROUP 8
+#define TAIL_MAX_COST 200
+// Funzioni massime visitate cercando un ciclo di chiamate in coda
+#define TAIL_MAX_SEEN 64
+
+// Funzioni già trasformate, da sole o come membri di un gruppo
+struct tail_done
+{
+    const char *name;
+    UT_hash_handle hh;
+};
+
+static struct tail_done *tail_done;
+
+// Testa di un membro del gruppo dentro la funzione trasformata: una phi per parametro
+struct tail_head
+{
+    struct ir_function *fn;
+    struct ir_block *block;
+    struct ir_value **phis;
+    int nparams;
+};
+
+// Tipo C di ritorno, come nella firma emessa: NIL_T è void
+static const char *ret_c_type(enum LUA_TYPE type)
+{
+    return type ? lua_type_to_c_string(type) : "void";
+}
+
+// Return raggiunto dal blocco, direttamente o attraverso blocchi vuoti senza phi
+static struct ir_value *reached_return(struct ir_block *b)
+{
+    if (b->term->op == IR_RETURN)
+        return b->term;
+    if (b->term->op != IR_JUMP)
+        return NULL;
+
+    struct ir_block *r = jump_target(b->term->targets[0]);
+    if (r->term->op != IR_RETURN || !block_is_empty(r))
+        return NULL;
+    for (struct ir_value *phi = r->phis; phi; phi = phi->next)
+    {
+        if (!phi->forward)
+            return NULL;
+    }
+    return r->term;
+}
+
+/* Chiamata in coda che termina il blocco, NULL se non c'è: l'ultima
+   istruzione chiama una funzione utente con lo stesso tipo C di ritorno e
+   il return raggiunto dal blocco ne restituisce il valore, o non ha valore
+   in una funzione void.
+*/
+static struct ir_value *tail_call(struct ir_function *f, struct ir_block *b)
+{
+    struct ir_value *call = b->last;
+    struct ir_value *t = reached_return(b);
+    struct ir_function *callee;
+
+    if (!call || call->op != IR_CALL || !t)
+        return NULL;
+    callee = ir_find_function(call->text);
+    if (!callee || strcmp(ret_c_type(callee->ret_type), ret_c_type(f->ret_type)) != 0)
+        return NULL;
+    if (t->nargs)
+        return ir_resolve(t->args[0]) == call ? call : NULL;
+    return !f->ret_type ? call : NULL;
+}
+
+static int tail_is_done(struct ir_function *f)
+{
+    struct tail_done *d;
+    HASH_FIND_STR(tail_done, f->name, d);
+    return d != NULL;
+}
+
+static int group_index(struct ir_function **group, int n, const char *name)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (strcmp(group[i]->name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// La funzione raggiunge target seguendo solo chiamate in coda
+static int tail_reaches(struct ir_function *from, struct ir_function *target, struct ir_function **seen, int *nseen)
+{
+    if (from == target)
+        return 1;
+    if (tail_is_done(from) || *nseen == TAIL_MAX_SEEN || group_index(seen, *nseen, from->name) >= 0)
+        return 0;
+    seen[(*nseen)++] = from;
+    for (int i = 0; i < from->nlayout; i++)
+    {
+        struct ir_value *call = tail_call(from, from->layout[i]);
+        if (call && tail_reaches(ir_find_function(call->text), target, seen, nseen))
+            return 1;
+    }
+    return 0;
+}
+
+// Istruzioni della funzione, -1 se non può essere copiata
+static int tail_cost(struct ir_function *f)
+{
+    int cost = 0;
+
+    if (f->entry->npreds > 0)
+        return -1;
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+            cost++;
+        cost++;
+    }
+    return cost;
+}
+
+/* Gruppo della funzione: le funzioni che chiama in coda, direttamente o
+   tramite altri membri, e che a loro volta la richiamano in coda. Restano
+   fuori quelle già trasformate, troppo grandi per essere copiate o con un
+   tipo di ritorno diverso.
+*/
+static int tail_group(struct ir_function *f, struct ir_function **group)
+{
+    int n = 1;
+    group[0] = f;
+
+    for (int g = 0; g < n; g++)
+    {
+        for (int i = 0; i < group[g]->nlayout; i++)
+        {
+            struct ir_value *call = tail_call(group[g], group[g]->layout[i]);
+            struct ir_function *callee = call ? ir_find_function(call->text) : NULL;
+            if (!callee || group_index(group, n, callee->name) >= 0 || tail_is_done(callee))
+                continue;
+
+            struct ir_function *seen[TAIL_MAX_SEEN];
+            int nseen = 0;
+            int cost = tail_cost(callee);
+            if (n < TAIL_MAX_GROUP && cost >= 0 && cost <= TAIL_MAX_COST && tail_cost(f) >= 0 &&
+                tail_reaches(callee, f, seen, &nseen))
+                group[n++] = callee;
+        }
+    }
+    return n;
+}
+
+static void add_param_phis(struct ir_function *f, struct tail_head *h, struct ir_block *block)
+{
+    int i = 0;
+    h->block = block;
+    h->nparams = count_params(h->fn);
+    h->phis = mem_alloc(MEM_IR, (h->nparams + 1) * sizeof(struct ir_value *));
+    for (struct AstNode *p = h->fn->fdef->node.fdef->params; p; p = p->next, i++)
+    {
+        struct ir_value *phi = ir_new_value(f, IR_PHI, param_type(p, root_symtab));
+        phi->block = block;
+        phi->next = block->phis;
+        block->phis = phi;
+        h->phis[i] = phi;
+    }
+}
+
+// Sposta istruzioni e terminatore dell'ingresso in un nuovo blocco, raggiunto con un salto
+static struct ir_block *split_entry(struct ir_function *f)
+{
+    struct ir_block *entry = f->entry;
+    struct ir_block *body = ir_new_block(f);
+
+    body->first = entry->first;
+    body->last = entry->last;
+    for (struct ir_value *v = body->first; v; v = v->next)
+        v->block = body;
+    entry->first = entry->last = NULL;
+
+    body->term = entry->term;
+    body->term->block = body;
+    int n = body->term->op == IR_BRANCH ? 2 : body->term->op == IR_JUMP ? 1 : 0;
+    for (int k = 0; k < n; k++)
+    {
+        struct ir_block *succ = body->term->targets[k];
+        if (k == 1 && succ == body->term->targets[0])
+            break;
+        for (int j = 0; j < succ->npreds; j++)
+        {
+            if (succ->preds[j] == entry)
+                succ->preds[j] = body;
+        }
+    }
+    jump_to(f, entry, body);
+    return body;
+}
+
+// Inoltra i valori IR_PARAM usati dal valore alle phi della testa
+static void forward_params(struct ir_function *f, struct tail_head *h, struct ir_value *v)
+{
+    for (int i = 0; i < v->nargs; i++)
+    {
+        struct ir_value *a = ir_resolve(v->args[i]);
+        int k = a->op == IR_PARAM ? param_index(f, a->text) : -1;
+        if (k >= 0)
+            a->forward = h->phis[k];
+        else if (a->op == IR_CAST)
+            forward_params(f, h, a);
+    }
+}
+
+static void forward_block_params(struct ir_function *f, struct tail_head *h, struct ir_block *b)
+{
+    for (struct ir_value *phi = b->phis; phi; phi = phi->next)
+        forward_params(f, h, phi);
+    for (struct ir_value *v = b->first; v; v = v->next)
+        forward_params(f, h, v);
+    forward_params(f, h, b->term);
+}
+
+/* Sostituisce la chiamata in coda con un salto alla testa del membro
+   chiamato; gli argomenti, convertiti come nella chiamata C, diventano
+   argomenti delle sue phi. Restituisce 0 se il numero di argomenti non
+   corrisponde ai parametri.
+*/
+static int tail_jump(struct ir_function *f, struct ir_block *b, struct ir_value *call, struct tail_head *h)
+{
+    struct clone c;
+    c.f = f;
+    c.callee = h->fn;
+    c.params = mem_alloc(MEM_IR, (h->nparams + 1) * sizeof(struct ir_value *));
+    if (!bind_params(&c, call))
+    {
+        mem_free(c.params);
+        return 0;
+    }
+
+    struct ir_value *prev = NULL;
+    for (struct ir_value *v = b->first; v != call; v = v->next)
+        prev = v;
+    if (prev)
+        prev->next = NULL;
+    else
+        b->first = NULL;
+    b->last = prev;
+
+    if (b->term->op == IR_JUMP)
+        ir_remove_pred(b->term->targets[0], b);
+    jump_to(f, b, h->block);
+    for (int i = 0; i < h->nparams; i++)
+        ir_add_arg(h->phis[i], c.params[i]);
+    mem_free(c.params);
+    return 1;
+}
+
+// Stato della trasformazione di un membro: le teste di tutti i membri e i blocchi dove cercare le chiamate
+struct tail_member
+{
+    struct ir_function *f;
+    struct tail_head heads[TAIL_MAX_GROUP];
+    struct ir_block **blocks;
+    int nblocks;
+    int cap;
+};
+
+static void add_block(struct tail_member *m, struct ir_block *b)
+{
+    if (m->nblocks == m->cap)
+    {
+        m->cap *= 2;
+        m->blocks = mem_realloc(m->blocks, m->cap * sizeof(struct ir_block *));
+    }
+    m->blocks[m->nblocks++] = b;
+}
+
+/* Copia nel membro gli altri membri del gruppo, ognuno preceduto dalla sua
+   testa: i parametri della copia sono le phi della testa. Va fatto su tutti
+   i membri prima di modificarne uno, perché le copie partono dai corpi
+   originali.
+*/
+static void tail_copy_group(struct tail_member *m, struct ir_function **group, int n)
+{
+    struct ir_function *f = m->f;
+
+    m->cap = f->nlayout * 2 + 8;
+    m->blocks = mem_alloc(MEM_IR, m->cap * sizeof(struct ir_block *));
+    m->nblocks = 0;
+    for (int i = 0; i < f->nlayout; i++)
+        add_block(m, f->layout[i]);
+
+    for (int g = 0; g < n; g++)
+    {
+        struct tail_head *h = &m->heads[g];
+        h->fn = group[g];
+        if (group[g] == f)
+            continue;
+
+        struct clone c;
+        add_param_phis(f, h, ir_new_block(f));
+        clone_init(&c, f, group[g]);
+        c.params = h->phis;
+        jump_to(f, h->block, clone_blocks(&c, NULL, NULL));
+        for (int i = 0; i < group[g]->nlayout; i++)
+            add_block(m, c.blocks[group[g]->layout[i]->id]);
+        clone_free(&c);
+    }
+}
+
+/* Il corpo originale del membro passa a un nuovo blocco che diventa la sua
+   testa: le phi dei parametri hanno come primo argomento un nuovo valore
+   IR_PARAM e i vecchi vengono inoltrati alle phi. Poi ogni chiamata in coda
+   a un membro, nel corpo originale o nelle copie, diventa un salto.
+*/
+static long tail_rewrite(struct tail_member *m, struct ir_function **group, int n)
+{
+    struct ir_function *f = m->f;
+    int self = group_index(group, n, f->name);
+    struct tail_head *h = &m->heads[self];
+    long changes = 0;
+
+    struct ir_block *body = split_entry(f);
+    add_param_phis(f, h, body);
+    for (int i = 0; i < m->nblocks; i++)
+        forward_block_params(f, h, m->blocks[i] == f->entry ? body : m->blocks[i]);
+
+    int i = 0;
+    for (struct AstNode *p = f->fdef->node.fdef->params; p; p = p->next, i++)
+    {
+        struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+        struct ir_value *param = ir_new_value(f, IR_PARAM, h->phis[i]->type);
+        param->text = var->node.var->name;
+        ir_add_arg(h->phis[i], param);
+    }
+
+    for (int k = 0; k < m->nblocks; k++)
+    {
+        struct ir_block *b = m->blocks[k] == f->entry ? body : m->blocks[k];
+        struct ir_value *call = tail_call(f, b);
+        int g = call ? group_index(group, n, call->text) : -1;
+        if (g >= 0 && tail_jump(f, b, call, &m->heads[g]))
+            changes++;
+    }
+    mem_free(m->blocks);
+    return changes;
+}
+
+/* Elimina le chiamate in coda. Le chiamate in coda alla funzione stessa
+   diventano un ciclo; un gruppo di funzioni che si chiamano in coda a
+   vicenda viene trasformato tutto insieme quando si incontra il primo
+   membro: ognuno riceve una copia degli altri e le chiamate in coda tra
+   membri diventano salti tra le copie. In entrambi i casi lo stack resta
+   costante.
+*/
+long ir_tail_calls(struct ir_function *f)
+{
+    struct ir_function *group[TAIL_MAX_GROUP];
+    struct tail_member *members;
+    long changes = 0;
+    int found = 0;
+
+    if (!f->fdef || tail_is_done(f))
+        return 0;
+
+    int n = tail_group(f, group);
+    for (int g = 0; g < n; g++)
+    {
+        struct tail_done *d = mem_alloc(MEM_IR, sizeof(struct tail_done));
+        d->name = group[g]->name;
+        HASH_ADD_KEYPTR(hh, tail_done, d->name, strlen(d->name), d);
+
+        for (int i = 0; i < group[g]->nlayout; i++)
+        {
+            struct ir_value *call = tail_call(group[g], group[g]->layout[i]);
+            if (call && group_index(group, n, call->text) >= 0)
+                found = 1;
+        }
+    }
+    if (!found)
+        return 0;
+
+    members = mem_alloc(MEM_IR, n * sizeof(struct tail_member));
+    for (int g = 0; g < n; g++)
+    {
+        members[g].f = group[g];
+        tail_copy_group(&members[g], group, n);
+    }
+    for (int g = 0; g < n; g++)
+    {
+        changes += tail_rewrite(&members[g], group, n);
+        // Le altre funzioni del gruppo non ripassano da questo passo
+        if (group[g] != f)
+            ir_update(group[g]);
+    }
+    mem_free(members);
+    return changes;
+}
+
+/* Memoizzazione */
+
+// Funzioni raggiungibili dalle chiamate, compresa quella di partenza
+struct call_set
+{
+    struct ir_function **fns;
+    int n;
+    int cap;
+};
+
+static int call_set_index(struct call_set *s, struct ir_function *f)
+{
+    for (int i = 0; i < s->n; i++)
+    {
+        if (s->fns[i] == f)
+            return i;
+    }
+    return -1;
+}
+
+static void collect_callees(struct call_set *s, struct ir_function *f)
+{
+    if (call_set_index(s, f) >= 0)
+        return;
+    if (s->n == s->cap)
+    {
+        s->cap = s->cap ? s->cap * 2 : 8;
+        s->fns = s->fns ? mem_realloc(s->fns, s->cap * sizeof(struct ir_function *))
+                        : mem_alloc(MEM_IR, s->cap * sizeof(struct ir_function *));
+    }
+    s->fns[s->n++] = f;
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+        {
+            struct ir_function *callee = v->op == IR_CALL ? ir_find_function(v->text) : NULL;
+            if (callee)
+                collect_callees(s, callee);
+        }
+    }
+}
+
+static int calls_function(struct ir_function *f, struct ir_function *callee)
+{
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+        {
+            if (v->op == IR_CALL && strcmp(v->text, callee->name) == 0)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* La funzione, presa da sola, non ha effetti e il risultato dipende solo
+   dagli argomenti: niente print, tabelle o chiamate al runtime (io.read).
+   Le variabili globali non servono, perché nell'IR sono locali della
+   funzione.
+*/
+static int locally_pure(struct ir_function *f)
+{
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        for (struct ir_value *v = f->layout[i]->first; v; v = v->next)
+        {
+            if (v->op == IR_PRINT || v->op == IR_TABLE || v->type == TABLE_T)
+                return 0;
+            if (v->op == IR_CALL && !ir_find_function(v->text))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static int memo_type(enum LUA_TYPE type)
+{
+    return type == INT_T || type == FLOAT_T || type == NUMBER_T || type == BOOLEAN_T;
+}
+
+/* Purezza della funzione: si parte assumendo pure tutte le funzioni
+   raggiungibili che lo sono localmente, così la ricorsione non blocca
+   l'analisi, e si tolgono quelle che chiamano una funzione impura finché
+   non cambia più niente.
+*/
+static int is_pure(struct call_set *s)
+{
+    int *pure = mem_alloc(MEM_IR, s->n * sizeof(int));
+    int changed = 1;
+
+    for (int i = 0; i < s->n; i++)
+        pure[i] = locally_pure(s->fns[i]);
+    while (changed)
+    {
+        changed = 0;
+        for (int i = 0; i < s->n; i++)
+        {
+            for (int k = 0; pure[i] && k < s->n; k++)
+            {
+                if (!pure[k] && calls_function(s->fns[i], s->fns[k]))
+                {
+                    pure[i] = 0;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    int result = pure[0];
+    mem_free(pure);
+    return result;
+}
+
+/* Memoizza le funzioni ricorsive pure con parametri e risultato numerici o
+   booleani: il corpo diventa statico e un wrapper con lo stesso nome
+   consulta una cache di dimensione fissa prima di eseguirlo (vedi
+   emit_memo_wrapper in ir.c). Le chiamate ricorsive passano dal wrapper,
+   quindi una ricorsione come quella di fibonacci diventa lineare.
+*/
+long ir_memoize(struct ir_function *f)
+{
+    struct call_set s = {NULL, 0, 0};
+    int ok;
+
+    if (!f->fdef || f->memo || !f->fdef->node.fdef->params || !memo_type(f->ret_type))
+        return 0;
+    for (struct AstNode *p = f->fdef->node.fdef->params; p; p = p->next)
+    {
+        struct AstNode *var = p->nodetype == DECL_T ? p->node.decl->var : p;
+        if (var->nodetype != VAR_T || !memo_type(param_type(p, root_symtab)))
+            return 0;
+    }
+
+    collect_callees(&s, f);
+    ok = 0;
+    for (int i = 0; i < s.n && !ok; i++)
+        ok = calls_function(s.fns[i], f);
+    ok = ok && is_pure(&s);
+    mem_free(s.fns);
+
+    f->memo = ok;
+    return ok;
+}
+
+/* Eliminazione delle sottoespressioni comuni */
+
+// Valore già calcolato nel blocco, per chiave testuale dell'operazione e degli operandi
+struct cse_entry
+{
+    char *key;
+    struct ir_value *value;
+    UT_hash_handle hh;
+};
+
+// Purezza delle funzioni chiamate, calcolata una volta per esecuzione del passo
+struct cse_callee
+{
+    const char *name;
+    int pure;
+    UT_hash_handle hh;
+};
+
+struct cse_key
+{
+    char *s;
+    size_t len;
+    size_t cap;
+};
+
+static void key_append(struct cse_key *k, const char *fmt, ...)
+{
+    char tmp[64];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+
+    const char *src = tmp;
+    char *big = NULL;
+    if ((size_t)n >= sizeof(tmp))
+    {
+        big = mem_alloc(MEM_IR, n + 1);
+        va_start(ap, fmt);
+        vsnprintf(big, n + 1, fmt, ap);
+        va_end(ap);
+        src = big;
+    }
+    if (k->len + n + 1 > k->cap)
+    {
+        k->cap = (k->len + n + 1) * 2;
+        k->s = k->s ? mem_realloc(k->s, k->cap) : mem_alloc(MEM_IR, k->cap);
+    }
+    memcpy(k->s + k->len, src, n + 1);
+    k->len += n;
+    if (big)
+        mem_free(big);
+}
+
+// Operando nella chiave: le costanti e le conversioni sono copie in linea, quindi contano per contenuto
+static void key_operand(struct cse_key *k, struct ir_value *v)
+{
+    v = ir_resolve(v);
+    if (v->op == IR_CONST)
+        key_append(k, "k%d:%s", v->type, v->text);
+    else if (v->op == IR_CAST)
+    {
+        key_append(k, "t%d(", v->type);
+        key_operand(k, v->args[0]);
+        key_append(k, ")");
+    }
+    else
+        key_append(k, "v%d", v->id);
+}
+
+static int callee_is_pure(struct cse_callee **cache, struct ir_function *callee)
+{
+    struct cse_callee *c;
+    HASH_FIND_STR(*cache, callee->name, c);
+    if (!c)
+    {
+        struct call_set s = {NULL, 0, 0};
+        collect_callees(&s, callee);
+        c = mem_alloc(MEM_IR, sizeof(struct cse_callee));
+        c->name = callee->name;
+        c->pure = is_pure(&s);
+        mem_free(s.fns);
+        HASH_ADD_KEYPTR(hh, *cache, c->name, strlen(c->name), c);
+    }
+    return c->pure;
+}
+
+/* Chiave del valore, NULL se non può essere riusato: operazioni
+   aritmetiche, logiche e di confronto, e chiamate a funzioni utente pure.
+*/
+static char *cse_key(struct cse_callee **cache, struct ir_value *v)
+{
+    struct cse_key k = {NULL, 0, 0};
+
+    switch (v->op)
+    {
+    case IR_BINARY:
+    case IR_UNARY:
+        key_append(&k, "%d:%d:%d", v->op, v->expr_type, v->type);
+        break;
+    case IR_CALL:
+    {
+        struct ir_function *callee = ir_find_function(v->text);
+        if (!callee || !callee_is_pure(cache, callee))
+            return NULL;
+        key_append(&k, "%d:%d:%s", v->op, v->type, v->text);
+        break;
+    }
+    default:
+        return NULL;
+    }
+    for (int i = 0; i < v->nargs; i++)
+    {
+        key_append(&k, ",");
+        key_operand(&k, v->args[i]);
+    }
+    return k.s;
+}
+
+/* Riusa nel blocco i valori già calcolati: in forma SSA gli operandi non
+   cambiano, quindi un'operazione con la stessa chiave di una precedente
+   viene inoltrata a quella e tolta dal blocco. Nel C emesso il risultato
+   resta nel temporaneo della prima.
+*/
+long ir_cse(struct ir_function *f)
+{
+    struct cse_callee *cache = NULL, *c, *ctmp;
+    long changes = 0;
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        struct ir_block *b = f->layout[i];
+        struct cse_entry *seen = NULL, *e, *tmp;
+        struct ir_value *prev = NULL;
+
+        for (struct ir_value *v = b->first; v; v = v->next)
+        {
+            char *key = cse_key(&cache, v);
+            if (!key)
+            {
+                prev = v;
+                continue;
+            }
+            HASH_FIND_STR(seen, key, e);
+            if (!e)
+            {
+                e = mem_alloc(MEM_IR, sizeof(struct cse_entry));
+                e->key = key;
+                e->value = v;
+                HASH_ADD_KEYPTR(hh, seen, e->key, strlen(e->key), e);
+                prev = v;
+                continue;
+            }
+            mem_free(key);
+
+            v->forward = e->value;
+            if (prev)
+                prev->next = v->next;
+            else
+                b->first = v->next;
+            if (b->last == v)
+                b->last = prev;
+            changes++;
+        }
+
+        HASH_ITER(hh, seen, e, tmp)
+        {
+            HASH_DEL(seen, e);
+            mem_free(e->key);
+            mem_free(e);
+        }
+    }
+
+    HASH_ITER(hh, cache, c, ctmp)
+    {
+        HASH_DEL(cache, c);
+        mem_free(c);
+    }
+    return changes;
+}
+
+/* Spostamento del codice invariante fuori dai cicli */
+
+// Funzione chiamata che si può eseguire anche quando il ciclo non fa iterazioni
+struct licm_callee
+{
+    const char *name;
+    int hoist;
+    UT_hash_handle hh;
+};
+
+/* La chiamata si può anticipare se la funzione è pura e termina sempre:
+   nel sottoinsieme di Lua i cicli for hanno passo costante, quindi basta
+   che tra le funzioni raggiungibili non ci sia ricorsione. Si tolgono
+   quelle che non chiamano altre funzioni rimaste finché è possibile; se ne
+   resta qualcuna c'è un ciclo nel grafo delle chiamate.
+*/
+static int callee_can_hoist(struct licm_callee **cache, struct ir_function *callee)
+{
+    struct licm_callee *c;
+    HASH_FIND_STR(*cache, callee->name, c);
+    if (c)
+        return c->hoist;
+
+    struct call_set s = {NULL, 0, 0};
+    collect_callees(&s, callee);
+    int hoist = is_pure(&s);
+    if (hoist)
+    {
+        int *removed = mem_alloc(MEM_IR, s.n * sizeof(int));
+        int left = s.n, changed = 1;
+        memset(removed, 0, s.n * sizeof(int));
+        while (changed)
+        {
+            changed = 0;
+            for (int i = 0; i < s.n; i++)
+            {
+                int leaf = !removed[i];
+                for (int k = 0; leaf && k < s.n; k++)
+                    leaf = removed[k] || !calls_function(s.fns[i], s.fns[k]);
+                if (leaf)
+                {
+                    removed[i] = 1;
+                    left--;
+                    changed = 1;
+                }
+            }
+        }
+        hoist = left == 0;
+        mem_free(removed);
+    }
+    mem_free(s.fns);
+
+    c = mem_alloc(MEM_IR, sizeof(struct licm_callee));
+    c->name = callee->name;
+    c->hoist = hoist;
+    HASH_ADD_KEYPTR(hh, *cache, c->name, strlen(c->name), c);
+    return hoist;
+}
+
+// Il valore non cambia nel ciclo: costante, parametro o definito fuori dai blocchi del ciclo
+static int loop_invariant(struct ir_value *v, const char *in_loop)
+{
+    v = ir_resolve(v);
+    if (v->op == IR_CAST)
+        return loop_invariant(v->args[0], in_loop);
+    return !v->block || v->block->order < 0 || !in_loop[v->block->order];
+}
+
+/* Operazioni che si possono spostare nel preheader: quelle aritmetiche,
+   logiche e di confronto non hanno effetti e non possono fallire (la
+   divisione è sempre in virgola mobile), le chiamate solo verso funzioni
+   pure che terminano.
+*/
+static int licm_candidate(struct licm_callee **cache, struct ir_value *v, const char *in_loop)
+{
+    if (v->op == IR_CALL)
+    {
+        struct ir_function *callee = ir_find_function(v->text);
+        if (!callee || !callee_can_hoist(cache, callee))
+            return 0;
+    }
+    else if (v->op != IR_BINARY && v->op != IR_UNARY)
+        return 0;
+    for (int k = 0; k < v->nargs; k++)
+    {
+        if (!loop_invariant(v->args[k], in_loop))
+            return 0;
+    }
+    return 1;
+}
+
+/* Blocchi del ciclo con intestazione h: quelli da cui si torna a h senza
+   passarci, risalendo i predecessori dai blocchi che saltano indietro.
+   Restituisce il numero dei salti all'indietro.
+*/
+static int loop_blocks(struct ir_function *f, struct ir_block *h, char *in_loop, struct ir_block **stack)
+{
+    int top = 0, latches = 0;
+
+    memset(in_loop, 0, f->nlayout);
+    in_loop[h->order] = 1;
+    for (int k = 0; k < h->npreds; k++)
+    {
+        struct ir_block *p = h->preds[k];
+        if (p->order >= h->order && !in_loop[p->order])
+        {
+            in_loop[p->order] = 1;
+            stack[top++] = p;
+        }
+        latches += p->order >= h->order;
+    }
+    while (top > 0)
+    {
+        struct ir_block *b = stack[--top];
+        for (int k = 0; k < b->npreds; k++)
+        {
+            struct ir_block *p = b->preds[k];
+            if (p->order >= 0 && !in_loop[p->order])
+            {
+                in_loop[p->order] = 1;
+                stack[top++] = p;
+            }
+        }
+    }
+    return latches;
+}
+
+// Unico predecessore esterno dell'intestazione, se termina con un salto: lì vanno i valori invarianti
+static struct ir_block *preheader(struct ir_block *h, const char *in_loop)
+{
+    struct ir_block *pre = NULL;
+    for (int k = 0; k < h->npreds; k++)
+    {
+        struct ir_block *p = h->preds[k];
+        if (p->order >= 0 && in_loop[p->order])
+            continue;
+        if (pre || p->order < 0)
+            return NULL;
+        pre = p;
+    }
+    return pre && pre->term && pre->term->op == IR_JUMP ? pre : NULL;
+}
+
+/* Sposta nel preheader dei cicli le operazioni i cui operandi non cambiano
+   tra un'iterazione e l'altra. I cicli sono riconosciuti dai salti verso un
+   blocco che precede nel reverse postorder, e vengono visitati dal più
+   interno: i valori portati fuori da un ciclo annidato possono poi uscire
+   anche da quello esterno. Il limite e il passo dei for sono già calcolati
+   una volta prima dell'intestazione dall'abbassamento.
+*/
+long ir_licm(struct ir_function *f)
+{
+    struct licm_callee *cache = NULL, *c, *ctmp;
+    char *in_loop = mem_alloc(MEM_IR, f->nlayout);
+    struct ir_block **stack = mem_alloc(MEM_IR, f->nlayout * sizeof(struct ir_block *));
+    long changes = 0;
+
+    for (int i = f->nlayout - 1; i >= 0; i--)
+    {
+        struct ir_block *h = f->layout[i];
+        struct ir_block *pre;
+
+        if (!loop_blocks(f, h, in_loop, stack) || !(pre = preheader(h, in_loop)))
+            continue;
+
+        int moved = 1;
+        while (moved)
+        {
+            moved = 0;
+            for (int j = h->order; j < f->nlayout; j++)
+            {
+                struct ir_block *b = f->layout[j];
+                struct ir_value *prev = NULL, *next;
+                if (!in_loop[j])
+                    continue;
+                for (struct ir_value *v = b->first; v; v = next)
+                {
+                    next = v->next;
+                    if (!licm_candidate(&cache, v, in_loop))
+                    {
+                        prev = v;
+                        continue;
+                    }
+                    if (prev)
+                        prev->next = next;
+                    else
+                        b->first = next;
+                    if (b->last == v)
+                        b->last = prev;
+
+                    v->next = NULL;
+                    v->block = pre;
+                    if (pre->last)
+                        pre->last->next = v;
+                    else
+                        pre->first = v;
+                    pre->last = v;
+                    moved = 1;
+                    changes++;
+                }
+            }
+        }
+    }
+
+    HASH_ITER(hh, cache, c, ctmp)
+    {
+        HASH_DEL(cache, c);
+        mem_free(c);
+    }
+    mem_free(in_loop);
+    mem_free(stack);
+    return changes;
+}
+
+/* Variabili di induzione */
+
+// Valore intero nel C generato
+static int int_value(struct ir_value *v)
+{
+    return strcmp(lua_type_to_c_string(ir_resolve(v)->type), "int") == 0;
+}
+
+/* Aggiunge un'operazione binaria intera in fondo al blocco, prima del
+   terminatore; tra due costanti il risultato è calcolato subito, se non
+   esce dal range di int.
+*/
+static struct ir_value *append_binary(struct ir_function *f, struct ir_block *b, enum EXPRESSION_TYPE op,
+                                      struct ir_value *l, struct ir_value *r)
+{
+    struct ir_value *cl = ir_resolve(l), *cr = ir_resolve(r);
+    if (cl->op == IR_CONST && cr->op == IR_CONST && cl->type == INT_T && cr->type == INT_T)
+    {
+        long long a = strtoll(cl->text, NULL, 10), c = strtoll(cr->text, NULL, 10);
+        long long x = op == MUL_T ? a * c : a + c;
+        if (x >= INT_MIN && x <= INT_MAX)
+        {
+            char *text = mem_alloc(MEM_IR, 24);
+            snprintf(text, 24, "%lld", x);
+            return ir_new_const(f, INT_T, text);
+        }
+    }
+
+    struct ir_value *v = ir_new_value(f, IR_BINARY, INT_T);
+    v->expr_type = op;
+    ir_add_arg(v, l);
+    ir_add_arg(v, r);
+    v->block = b;
+    if (b->last)
+        b->last->next = v;
+    else
+        b->first = v;
+    b->last = v;
+    return v;
+}
+
+/* Passo della variabile di induzione: la phi dell'intestazione riceve dal
+   preheader il valore iniziale e dal blocco che torna indietro la phi
+   stessa più un valore invariante. NULL se la phi non ha questa forma.
+*/
+static struct ir_value *induction_step(struct ir_value *phi, int latch, const char *in_loop)
+{
+    struct ir_value *next = ir_resolve(phi->args[latch]);
+
+    if (phi->op != IR_PHI || phi->type != INT_T || next->op != IR_BINARY || next->expr_type != ADD_T)
+        return NULL;
+    for (int k = 0; k < 2; k++)
+    {
+        struct ir_value *step = next->args[1 - k];
+        if (ir_resolve(next->args[k]) == phi && int_value(step) && loop_invariant(step, in_loop))
+            return step;
+    }
+    return NULL;
+}
+
+/* Riduzione di forza sui cicli con un solo salto all'indietro: un prodotto
+   intero i * k, con i variabile di induzione e k invariante, diventa una
+   nuova variabile di induzione che parte da init * k e a ogni iterazione
+   cresce di step * k, calcolati nel preheader. Nel ciclo resta solo una
+   somma, e il prodotto di un'espressione derivata come base + i * stride
+   non viene più ricalcolato. Le nuove variabili sono a loro volta di
+   induzione, quindi anche (i * a) * b si riduce al giro successivo.
+*/
+long ir_induction(struct ir_function *f)
+{
+    char *in_loop = mem_alloc(MEM_IR, f->nlayout);
+    struct ir_block **stack = mem_alloc(MEM_IR, f->nlayout * sizeof(struct ir_block *));
+    long changes = 0;
+
+    for (int i = f->nlayout - 1; i >= 0; i--)
+    {
+        struct ir_block *h = f->layout[i];
+        struct ir_block *pre;
+
+        if (h->npreds != 2 || loop_blocks(f, h, in_loop, stack) != 1 || !(pre = preheader(h, in_loop)))
+            continue;
+        int entry = h->preds[0] == pre ? 0 : 1;
+        struct ir_block *latch = h->preds[1 - entry];
+        if (!latch->term || latch->term->op != IR_JUMP)
+            continue;
+
+        for (int j = h->order; j < f->nlayout; j++)
+        {
+            struct ir_block *b = f->layout[j];
+            struct ir_value *prev = NULL, *next;
+            if (!in_loop[j])
+                continue;
+            for (struct ir_value *v = b->first; v; v = next)
+            {
+                struct ir_value *iv = NULL, *factor = NULL, *step = NULL;
+                next = v->next;
+                if (v->op == IR_BINARY && v->expr_type == MUL_T && v->type == INT_T)
+                {
+                    for (int k = 0; k < 2 && !step; k++)
+                    {
+                        iv = ir_resolve(v->args[k]);
+                        factor = v->args[1 - k];
+                        if (iv->block == h && int_value(factor) && loop_invariant(factor, in_loop))
+                            step = induction_step(iv, 1 - entry, in_loop);
+                    }
+                }
+                if (!step)
+                {
+                    prev = v;
+                    continue;
+                }
+
+                struct ir_value *phi = ir_new_value(f, IR_PHI, INT_T);
+                struct ir_value *init = append_binary(f, pre, MUL_T, iv->args[entry], factor);
+                struct ir_value *stride = append_binary(f, pre, MUL_T, step, factor);
+                phi->block = h;
+                phi->next = h->phis;
+                h->phis = phi;
+                for (int k = 0; k < 2; k++)
+                    ir_add_arg(phi, k == entry ? init : append_binary(f, latch, ADD_T, phi, stride));
+
+                v->forward = phi;
+                if (prev)
+                    prev->next = next;
+                else
+                    b->first = next;
+                if (b->last == v)
+                    b->last = prev;
+                changes++;
+            }
+        }
+    }
+
+    mem_free(in_loop);
+    mem_free(stack);
+    return changes;
+}
+
+/* Semplificazioni algebriche */
+
+// Costante numerica con il valore dato
+static int const_equals(struct ir_value *v, double x)
+{
+    char *end;
+    v = ir_resolve(v);
+    if (v->op != IR_CONST || (v->type != INT_T && v->type != FLOAT_T && v->type != NUMBER_T))
+        return 0;
+    double d = strtod(v->text, &end);
+    return *end == '\0' && d == x;
+}
+
+/* Reciproco esatto di una costante potenza di due (0.5, 2, 4, ...): la
+   divisione per c dà lo stesso risultato della moltiplicazione per 1 / c.
+*/
+static const char *exact_reciprocal(struct ir_value *v)
+{
+    char *end;
+    v = ir_resolve(v);
+    if (v->op != IR_CONST || (v->type != INT_T && v->type != FLOAT_T && v->type != NUMBER_T))
+        return NULL;
+    double d = strtod(v->text, &end);
+    double m = d < 0 ? -d : d;
+    if (*end != '\0' || m < 0x1p-126 || m > 0x1p126)
+        return NULL;
+    while (m >= 2)
+        m /= 2;
+    while (m < 1)
+        m *= 2;
+    if (m != 1)
+        return NULL;
+    char *text = mem_alloc(MEM_IR, 32);
+    snprintf(text, 32, "%.17g", 1 / d);
+    if (!strpbrk(text, ".e"))
+        strcat(text, ".0");
+    return text;
+}
+
+/* Operando che sostituisce il valore, convertito al suo tipo: x * 1,
+   1 * x, x - 0 e, tra interi, x + 0, 0 + x e x * 0 (in virgola mobile
+   -0 + 0 è +0 e x * 0 può essere NaN). NULL se il valore non si
+   semplifica così.
+*/
+static struct ir_value *identity_operand(struct ir_function *f, struct ir_value *v)
+{
+    struct ir_value *l = v->args[0], *r = v->args[1], *x = NULL;
+
+    if (v->expr_type == MUL_T && v->type == INT_T && (const_equals(r, 0) || const_equals(l, 0)))
+        return ir_new_const(f, INT_T, "0");
+    if (v->expr_type == MUL_T)
+        x = const_equals(r, 1) ? l : const_equals(l, 1) ? r : NULL;
+    else if (v->expr_type == SUB_T)
+        x = const_equals(r, 0) ? l : NULL;
+    else if (v->expr_type == ADD_T && v->type == INT_T)
+        x = const_equals(r, 0) ? l : const_equals(l, 0) ? r : NULL;
+    return x ? ir_convert(f, x, v->type) : NULL;
+}
+
+/* Riscrive le operazioni con un operando costante in forme più economiche
+   nel C generato: gli elementi neutri spariscono, x * 2 intero diventa
+   x + x e la divisione per una potenza di due una moltiplicazione per il
+   reciproco. Le altre moltiplicazioni per potenze di due restano, perché lo
+   shift a sinistra di un intero negativo non è definito in C e gcc le
+   riduce comunque.
+*/
+long ir_simplify(struct ir_function *f)
+{
+    long changes = 0;
+
+    for (int i = 0; i < f->nlayout; i++)
+    {
+        struct ir_block *b = f->layout[i];
+        struct ir_value *prev = NULL, *next;
+
+        for (struct ir_value *v = b->first; v; v = next)
+        {
+            struct ir_value *x = NULL;
+            const char *reciprocal;
+            next = v->next;
+            if (v->op != IR_BINARY)
+            {
+                prev = v;
+                continue;
+            }
+
+            if ((x = identity_operand(f, v)))
+            {
+                v->forward = x;
+                if (prev)
+                    prev->next = next;
+                else
+                    b->first = next;
+                if (b->last == v)
+                    b->last = prev;
+                changes++;
+                continue;
+            }
+            if (v->expr_type == MUL_T && v->type == INT_T && (const_equals(v->args[0], 2) || const_equals(v->args[1], 2)))
+            {
+                struct ir_value *other = const_equals(v->args[0], 2) ? v->args[1] : v->args[0];
+                v->expr_type = ADD_T;
+                v->args[0] = v->args[1] = other;
+                changes++;
+            }
+            else if (v->expr_type == DIV_T && (reciprocal = exact_reciprocal(v->args[1])))
+            {
+                v->expr_type = MUL_T;
+                v->args[1] = ir_new_const(f, FLOAT_T, reciprocal);
+                changes++;
+            }
+            prev = v;
+        }
+    }
+    return changes;
+}
@@ -0,0 +1,20 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ir.h"
+
+/* Passi di ottimizzazione sull'IR, registrati in passes.c. Ognuno lavora su
+   una funzione e restituisce il numero di modifiche fatte.
+*/
+
+long ir_inline(struct ir_function *fn);
+long ir_tail_calls(struct ir_function *fn);
+long ir_memoize(struct ir_function *fn);
+long ir_cse(struct ir_function *fn);
+long ir_licm(struct ir_function *fn);
+long ir_induction(struct ir_function *fn);
+long ir_simplify(struct ir_function *fn);
+long ir_sccp(struct ir_function *fn);
+long ir_thread_jumps(struct ir_function *fn);
+
+#endif
@@ -7,8 +7,26 @@
 #include "global.h"
 #include "pretty.h"
 #include "translate.h"
+#include "stats.h"
+#include "mem.h"
+#include "ir.h"
+#include "passes.h"
+#include "unroll.h"
+#include "vectorize.h"
 
 extern int yylex();
+
+/* Wrapper di yylex usato dal parser: conta i token e ne misura il tempo per --stats */
+static void parallel_hint_token(int token);
+static int counted_yylex() {
+    stats_begin(TIMER_LEX);
+    int token = yylex();
+    stats_end(TIMER_LEX);
+    stats.tokens++;
+    parallel_hint_token(token);
+    return token;
+}
+#define yylex counted_yylex
 extern FILE *yyin;
 extern int yylineno;
 extern char *line;
@@ -23,6 +41,7 @@ void fill_symtab (struct symlist * syml, struct AstNode *node, enum LUA_TYPE typ
 
 int print_symtab_flag = 0;
 int print_ast_flag = 0;
+int dump_ir_flag = 0;
 void print_usage();
 
 void check_fcall(struct AstNode *func_expr, struct AstNode *args);
@@ -30,22 +49,21 @@ void check_fcall(struct AstNode *func_expr, struct AstNode *args);
 // Funzione helper per creare l'identificatore per io.read e liberare le stringhe originali
 static struct AstNode* new_io_read_identifier_node(char* ns_token, char* func_token) {
     if (strcmp(ns_token, "io") == 0 && strcmp(func_token, "read") == 0) {
-        char* full_name = malloc(strlen(ns_token) + 1 + strlen(func_token) + 1);
-        if (!full_name) { /* Gestione errore malloc */ perror("malloc failed for io.read id"); exit(EXIT_FAILURE); }
+        char* full_name = mem_alloc(MEM_AST, strlen(ns_token) + 1 + strlen(func_token) + 1);
         sprintf(full_name, "%s.%s", ns_token, func_token);
 
         // new_variable assegna direttamente il puntatore 'full_name'.
         // 'full_name' sarà quindi gestito (eventualmente liberato) insieme al nodo AST.
         struct AstNode* var_node = new_variable(VAR_T, full_name, NULL);
 
-        free(ns_token); 
-        free(func_token); 
+        mem_free(ns_token);
+        mem_free(func_token);
         return var_node;
     }
     // Se non è "io.read" è un errore
     yyerror(error_string_format("Unsupported table member access: %s.%s. Only 'io.read' is supported.", ns_token, func_token));
-    free(ns_token);
-    free(func_token);
+    mem_free(ns_token);
+    mem_free(func_token);
     return new_error(ERROR_NODE_T);
 }
 %}
@@ -59,7 +77,8 @@ static struct AstNode* new_io_read_identifier_node(char* ns_token, char* func_to
 }
 
 %token <s> INT_NUM FLOAT_NUM
-%token  IF ELSE THEN FOR DO END RETURN
+%token  IF ELSE THEN DO END RETURN
+%token <t> FOR // 1 se preceduto da --@parallel
 %token  FUNCTION
 %token <s> STRING BOOL NIL
 %token DOT
@@ -89,13 +108,15 @@ static struct AstNode* new_io_read_identifier_node(char* ns_token, char* func_to
 %%
 
 program
-    : { scope_enter(); } global_statement_list                        { root = $2; scope_exit(); }
+    : { scope_enter(); } global_statement_list                        { root = reverse_AstNode($2); scope_exit(); }
     ;
 
-
+/* Le liste sono ricorsive a sinistra, così lo stack del parser non cresce con la
+   lunghezza dell'input: vengono costruite al contrario e girate una volta completate
+*/
 global_statement_list
     : global_statement
-    | global_statement global_statement_list                        { $$ = link_AstNode($1, $2); }
+    | global_statement_list global_statement                        { $$ = link_AstNode($2, $1); }
     ;
 
 global_statement
@@ -145,7 +166,7 @@ global_statement
            if ($1->nodetype == VAR_T && $1->node.var) {
                func_name_str = $1->node.var->name;
            }
-           struct AstNode* fdef_node = new_func_def(FDEF_T, func_name_str ? strdup(func_name_str) : NULL, $5, $8, ret);
+           struct AstNode* fdef_node = new_func_def(FDEF_T, func_name_str ? mem_strdup(MEM_AST, func_name_str) : NULL, $5, $8, ret);
 
            $$ = fdef_node;
 
@@ -181,7 +202,7 @@ param
 
 table_list
     : table_field
-    | table_field ',' table_list                                    { $$ = link_AstNode($1, $3); }
+    | table_list ',' table_field                                    { $$ = link_AstNode($3, $1); }
     ;
 
 table_field
@@ -198,7 +219,7 @@ table_field
     | BOOL
         { $$ = new_table_field(TABLE_FIELD_T, NULL, new_value(VAL_T, eval_bool($1), $1)); }
     | '{' table_list '}'
-        { $$ = new_table(TABLE_NODE_T, $2); }
+        { $$ = new_table(TABLE_NODE_T, reverse_AstNode($2)); }
     | /* empty */
         { $$ = new_table_field(TABLE_FIELD_T, NULL, NULL); }
 
@@ -208,12 +229,12 @@ table_field
      ;
 
 chunk
-    : statement_list                                               { $$ = $1; }
+    : statement_list                                               { $$ = reverse_AstNode($1); }
     ;
 
 statement_list
     : statement
-    | statement statement_list                                       { $$ = link_AstNode($1, $2); }
+    | statement_list statement                                       { $$ = link_AstNode($2, $1); }
     ;
 
 statement
@@ -253,7 +274,8 @@ if_cond
     ;
 
 iteration_statement
-    : FOR ID '=' start_expr ',' end_expr step DO { scope_enter(); } chunk END               { $$ = new_for(FOR_T, $2, $4, $6, $7, $10); scope_exit(); }
+    : FOR ID '=' start_expr ',' end_expr step DO { scope_enter(); } chunk END
+        { $$ = new_for(FOR_T, $2, $4, $6, $7, $10); $$->node.forn->parallel = $1; scope_exit(); }
     ;
 
 start_expr
@@ -284,7 +306,7 @@ return_statement
 
 optional_expr_list
     : /* empty */ { $$ = NULL; } %prec LOWEST
-    | args        { $$ = $1; } %prec LOWEST
+    | args        { $$ = reverse_AstNode($1); } %prec LOWEST
     ;
 
 // Espressioni, con precedenza e associatività
@@ -313,7 +335,7 @@ primary_expr
     | STRING                   { $$ = new_value(VAL_T, STRING_T, $1); }
     | NIL                      { $$ = new_value(VAL_T, NIL_T, NULL); }
     | BOOL                     { $$ = new_value(VAL_T, eval_bool($1), $1); }
-    | '{' table_list '}'       { $$ = new_table(TABLE_NODE_T, $2); }
+    | '{' table_list '}'       { $$ = new_table(TABLE_NODE_T, reverse_AstNode($2)); }
     | func_call                { $$ = $1; }
     | '(' expr ')'             { $$ = new_expression(EXPR_T, PAR_T, NULL, $2); }
     ;
@@ -332,8 +354,9 @@ number
 
 func_call
     : name_or_ioread '(' args ')' { // name_or_ioread può essere 'ID' o 'io.read'
-                                     $$ = new_func_call(FCALL_T, $1, $3);
-                                     check_fcall($1, $3);
+                                     struct AstNode *args = reverse_AstNode($3);
+                                     $$ = new_func_call(FCALL_T, $1, args);
+                                     check_fcall($1, args);
 
                                      // Aggiorna il tipo di ritorno in base alla definizione della funzione
                                      if ($1->nodetype == VAR_T) {
@@ -358,15 +381,27 @@ func_call
 
 args
     : expr
-    | expr ',' args                                                 { $$ = link_AstNode($1, $3); }
+    | args ',' expr                                                 { $$ = link_AstNode($3, $1); }
     ;
 
 %%
 
+/* --@parallel vale solo per il token che lo segue: se è un for diventa il
+   valore del token, altrimenti l'annotazione è ignorata con un avviso.
+*/
+static void parallel_hint_token(int token) {
+    if(token == FOR)
+        yylval.t = parallel_hint != 0;
+    else if(parallel_hint)
+        fprintf(stderr, YELLOW "ATTENZIONE:" RESET " --@parallel ignorato alla riga %d: non precede un ciclo for\n", parallel_hint);
+    parallel_hint = 0;
+}
 
 int main(int argc, char **argv) {
     int file_count = 0;
 
+    stats_init();
+
     if(argc < 2) {
         fprintf(stderr, RED "fatal error:" RESET " no input file\n");
         exit(1);
@@ -376,9 +411,70 @@ int main(int argc, char **argv) {
                 print_symtab_flag = 1;
             else if(strcmp(argv[i], "-t") == 0)
                 print_ast_flag = 1;
+            else if(strcmp(argv[i], "--ir") == 0)
+                ir_flag = 1;
+            else if(strcmp(argv[i], "--dump-ir") == 0)
+                dump_ir_flag = 1;
+            else if(strcmp(argv[i], "--vec-report") == 0)
+                vec_report_flag = 1;
+            else if(strcmp(argv[i], "--runtime-lib") == 0)
+                runtime_lib_flag = 1;
+            else if(strcmp(argv[i], "--split") == 0)
+                split_functions = 1;
+            else if(strncmp(argv[i], "--split=", 8) == 0){
+                char *end;
+                long per_unit = strtol(argv[i] + 8, &end, 10);
+                if(*end != '\0' || end == argv[i] + 8 || per_unit < 1){
+                    fprintf(stderr, RED "error:" RESET " invalid functions per unit " BOLD "%s \n" RESET, argv[i] + 8);
+                    exit(1);
+                }
+                split_functions = per_unit;
+            }
+            else if(strcmp(argv[i], "--list-passes") == 0){
+                passes_list(stdout);
+                exit(0);
+            }
+            else if(strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0)
+                stats_format = STATS_TEXT;
+            else if(strcmp(argv[i], "--stats=json") == 0)
+                stats_format = STATS_JSON;
+            else if(strncmp(argv[i], "--stats-file=", 13) == 0)
+                stats_filename = argv[i] + 13;
+            else if(strncmp(argv[i], "--mem-budget=", 13) == 0){
+                mem_budget = mem_parse_size(argv[i] + 13);
+                if(mem_budget == 0){
+                    fprintf(stderr, RED "error:" RESET " invalid memory budget " BOLD "%s \n" RESET, argv[i] + 13);
+                    exit(1);
+                }
+            }
+            else if(strncmp(argv[i], "--unroll-factor=", 16) == 0){
+                char *end;
+                long factor = strtol(argv[i] + 16, &end, 10);
+                if(*end != '\0' || factor < 1 || factor > 64){
+                    fprintf(stderr, RED "error:" RESET " invalid unroll factor " BOLD "%s \n" RESET, argv[i] + 16);
+                    exit(1);
+                }
+                unroll_factor = factor;
+            }
+            else if(strncmp(argv[i], "--parallel-min-trips=", 21) == 0){
+                char *end;
+                long trips = strtol(argv[i] + 21, &end, 10);
+                if(*end != '\0' || end == argv[i] + 21 || trips < 0){
+                    fprintf(stderr, RED "error:" RESET " invalid trip count " BOLD "%s \n" RESET, argv[i] + 21);
+                    exit(1);
+                }
+                parallel_min_trips = trips;
+            }
             else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0){
                 print_usage();
                 exit(0);
+            }else if(argv[i][0] == '-' && (argv[i][1] == 'O' || argv[i][1] == 'f')){
+                // -O<n>, -f<passo>, -fno-<passo>
+                if(passes_parse_option(argv[i]) <= 0){
+                    fprintf(stderr, RED "error:" RESET " unrecognized optimization option " BOLD "%s \n" RESET, argv[i]);
+                    fprintf(stderr, "use --list-passes to see the available passes \n");
+                    exit(1);
+                }
             }else {
                 if(argv[i][0] == '-'){
                     fprintf(stderr, RED "error:" RESET " unrecognized command line option " BOLD "%s \n" RESET, argv[i]);
@@ -416,17 +512,35 @@ int main(int argc, char **argv) {
     current_scope_lvl = 0;
     current_symtab = NULL;
 
-    if(yyparse() == 0) {
+    stats_begin(TIMER_PARSE);
+    int parse_result = yyparse();
+    ast_share_end(root);
+    stats_end(TIMER_PARSE);
+    mem_phase("parse");
+
+    if(parse_result == 0) {
 
         if(print_ast_flag)
             print_ast(root);
         if(error_num == 0){
-
-            translate(root);
+            struct ir_program *program = NULL;
+            passes_run_ast(root);
+            if(passes_need_ir())
+                ir_flag = 1;
+            parallelize_hints(root, ir_flag);
+            if(ir_flag || dump_ir_flag)
+                program = ir_lower(root);
+            if(dump_ir_flag)
+                ir_print(program, stdout);
+
+            translate(root, ir_flag ? program : NULL);
+            mem_phase("translate");
+            vectorize_report(stderr, ir_flag);
         }
     }
 
     fclose(yyin);
+    stats_report();
 }
 
 
@@ -494,4 +608,17 @@ void print_usage(){
     printf(" -h \t\t Display this information. \n");
     printf(" -s \t\t Print Symbol Table. \n");
     printf(" -t \t\t Print Abstract Syntax Tree. \n");
+    printf(" --ir \t\t Generate C from the SSA intermediate representation. \n");
+    printf(" --dump-ir \t Print the SSA intermediate representation. \n");
+    printf(" -O<n> \t\t Optimization level: 0 (default), 1, 2. \n");
+    printf(" -f<pass> \t Enable an optimization pass, -fno-<pass> disables it. \n");
+    printf(" --list-passes \t List the optimization passes and their -O level. \n");
+    printf(" --unroll-factor=<n> \t Loop body copies per iteration of partially unrolled loops (default 4). \n");
+    printf(" --parallel-min-trips=<n> Iterations below which a parallel loop runs in one thread (default 10000). \n");
+    printf(" --split[=<n>] \t Emit <n> functions per .c file (default 1), main in its own file, and a Makefile fragment. \n");
+    printf(" --runtime-lib \t Include runtime/lua2c_rt.h instead of defining the runtime helpers in the header. \n");
+    printf(" --vec-report \t Report which loops -fvectorize and -fparallelize transform, and why the others are not. \n");
+    printf(" --stats[=text|json] \t Print per-phase timings and counters on stderr. \n");
+    printf(" --stats-file=<file> \t Write the --stats report to <file>. \n");
+    printf(" --mem-budget=<n>[K|M|G] Abort if live transpiler memory exceeds the budget. \n");
 }
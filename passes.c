@@ -0,0 +1,283 @@
+#include "passes.h"
+#include "fold.h"
+#include "eval.h"
+#include "effects.h"
+#include "unroll.h"
+#include "vectorize.h"
+#include "dispatch.h"
+#include "dce.h"
+#include "optimize.h"
+#include "global.h"
+#include "pretty.h"
+#include "stats.h"
+#include <string.h>
+#include <time.h>
+
+// Iterazioni massime della pipeline sull'IR a -O2, che la ripete finché qualche passo modifica la funzione
+#define PASS_MAX_ROUNDS 4
+
+int opt_level = 0;
+
+/* Tabella dei passi, nell'ordine di esecuzione */
+static struct pass passes[] = {
+    {.name = "eval",
+     .description = "esegue le chiamate a funzioni pure con argomenti costanti",
+     .kind = PASS_AST,
+     .level = 2,
+     .run_ast = eval_ast},
+    {.name = "unroll",
+     .description = "srotola i cicli for con estremi letterali, del tutto se brevi o per --unroll-factor",
+     .kind = PASS_AST,
+     .level = 2,
+     .run_ast = unroll_ast},
+    {.name = "fold",
+     .description = "valuta le espressioni costanti dell'AST",
+     .kind = PASS_AST,
+     .level = 1,
+     .run_ast = fold_ast},
+    {.name = "dce",
+     .description = "toglie statement irraggiungibili, rami costanti, assegnazioni mai lette e funzioni mai chiamate",
+     .kind = PASS_AST,
+     .level = 1,
+     .run_ast = dce_ast},
+    {.name = "attributes",
+     .description = "emette static, const, pure, inline, hot, cold e nonnull dagli effetti delle funzioni",
+     .kind = PASS_AST,
+     .level = 1,
+     .run_ast = effects_ast},
+    {.name = "vectorize",
+     .description = "emette i cicli di sole riduzioni in forma canonica con #pragma omp simd",
+     .kind = PASS_AST,
+     .level = PASS_FLAG_ONLY,
+     .run_ast = vectorize_ast},
+    {.name = "parallelize",
+     .description = "divide tra più thread i cicli di sole riduzioni, con OpenMP o un runtime pthread",
+     .kind = PASS_AST,
+     .level = PASS_FLAG_ONLY,
+     .run_ast = parallelize_ast},
+    {.name = "switch",
+     .description = "emette le catene di if su una variabile e costanti distinte come switch, "
+                    "hash perfetto per le stringhe",
+     .kind = PASS_AST,
+     .level = PASS_FLAG_ONLY,
+     .run_ast = dispatch_ast},
+    {.name = "tail-calls",
+     .description = "trasforma le chiamate in coda in salti, anche tra funzioni mutuamente ricorsive",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_tail_calls},
+    {.name = "inline",
+     .description = "espande le funzioni piccole e non ricorsive nei chiamanti",
+     .kind = PASS_IR,
+     .level = 2,
+     .run_ir = ir_inline},
+    {.name = "sccp",
+     .description = "propaga le costanti sull'IR ed elimina i rami con condizione nota",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_sccp},
+    {.name = "licm",
+     .description = "porta fuori dai cicli le operazioni e le chiamate pure invarianti",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_licm},
+    {.name = "simplify",
+     .description = "semplifica le operazioni con elementi neutri, x * 2 e divisioni per potenze di due",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_simplify},
+    {.name = "induction",
+     .description = "sostituisce i prodotti delle variabili di induzione con somme incrementali",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_induction},
+    {.name = "cse",
+     .description = "riusa nel blocco le operazioni e le chiamate pure già calcolate",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_cse},
+    {.name = "thread-jumps",
+     .description = "salta i blocchi vuoti che contengono solo un salto",
+     .kind = PASS_IR,
+     .level = 1,
+     .run_ir = ir_thread_jumps},
+    {.name = "memoize",
+     .description = "aggiunge una cache dei risultati alle funzioni ricorsive pure",
+     .kind = PASS_IR,
+     .level = PASS_FLAG_ONLY,
+     .run_ir = ir_memoize},
+};
+
+#define PASS_COUNT ((int)(sizeof(passes) / sizeof(passes[0])))
+
+static struct pass *find_pass(const char *name)
+{
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        if (strcmp(passes[i].name, name) == 0)
+            return &passes[i];
+    }
+    return NULL;
+}
+
+static int is_enabled(struct pass *p)
+{
+    return p->flag ? p->flag > 0 : opt_level >= p->level;
+}
+
+/* Interpreta le opzioni -O<n>, -f<nome> e -fno-<nome>. Restituisce 1 se
+   l'opzione è stata riconosciuta, 0 se non riguarda il gestore dei passi,
+   -1 se è malformata (livello non valido o passo inesistente).
+*/
+int passes_parse_option(const char *arg)
+{
+    if (strncmp(arg, "-O", 2) == 0)
+    {
+        if (arg[2] == '\0')
+            opt_level = 1;
+        else if (arg[2] >= '0' && arg[2] <= '0' + PASS_MAX_LEVEL && arg[3] == '\0')
+            opt_level = arg[2] - '0';
+        else
+            return -1;
+        return 1;
+    }
+
+    if (strncmp(arg, "-f", 2) != 0)
+        return 0;
+
+    int value = 1;
+    const char *name = arg + 2;
+    if (strncmp(name, "no-", 3) == 0)
+    {
+        value = -1;
+        name += 3;
+    }
+
+    struct pass *p = find_pass(name);
+    if (!p)
+        return -1;
+    p->flag = value;
+    return 1;
+}
+
+int passes_enabled(const char *name)
+{
+    struct pass *p = find_pass(name);
+    return p && is_enabled(p);
+}
+
+/* Il codice C viene generato dall'IR con --ir o se un passo sull'IR è
+   richiesto con -f<nome>. Il livello -O da solo non cambia backend: l'IR
+   arrotonda a float ogni temporaneo, mentre il C generato dall'AST calcola
+   ogni espressione nei tipi del C (double con un letterale non intero), e
+   i risultati possono differire nelle ultime cifre.
+*/
+int passes_need_ir()
+{
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        if (passes[i].kind == PASS_IR && passes[i].flag > 0)
+            return 1;
+    }
+    return 0;
+}
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Esegue un passo misurandone il tempo (solo con --stats) e le modifiche
+static long run_pass(struct pass *p, struct AstNode *root, struct ir_function *fn)
+{
+    long long start = stats_format != STATS_OFF ? now_ns() : 0;
+    long changes = p->kind == PASS_AST ? p->run_ast(root) : p->run_ir(fn);
+
+    if (stats_format != STATS_OFF)
+        p->wall_ns += now_ns() - start;
+    p->runs++;
+    p->changes += changes;
+    return changes;
+}
+
+void passes_run_ast(struct AstNode *root)
+{
+    stats_begin(TIMER_OPT);
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        if (passes[i].kind == PASS_AST && is_enabled(&passes[i]))
+            run_pass(&passes[i], root, NULL);
+    }
+    stats_end(TIMER_OPT);
+}
+
+/* Esegue la pipeline sull'IR di una funzione. Dopo ogni passo che ha
+   modificato il grafo vengono ricalcolati layout, phi banali e usi, così
+   ogni passo trova l'IR in forma canonica.
+*/
+void passes_run_ir(struct ir_function *fn)
+{
+    int rounds = opt_level >= 2 ? PASS_MAX_ROUNDS : 1;
+
+    stats_begin(TIMER_OPT);
+    for (int round = 0; round < rounds; round++)
+    {
+        long changed = 0;
+        for (int i = 0; i < PASS_COUNT; i++)
+        {
+            if (passes[i].kind != PASS_IR || !is_enabled(&passes[i]))
+                continue;
+            if (run_pass(&passes[i], NULL, fn))
+            {
+                ir_update(fn);
+                changed = 1;
+            }
+        }
+        if (!changed)
+            break;
+    }
+    stats_end(TIMER_OPT);
+}
+
+// Elenco dei passi (--list-passes)
+void passes_list(FILE *out)
+{
+    fprintf(out, "%-20s %-5s %-6s %s\n", "passo", "tipo", "-O", "descrizione");
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        char level[8];
+        if (passes[i].level == PASS_FLAG_ONLY)
+            snprintf(level, sizeof(level), "-f");
+        else
+            snprintf(level, sizeof(level), "%d", passes[i].level);
+        fprintf(out, "%-20s %-5s %-6s %s\n", passes[i].name, passes[i].kind == PASS_AST ? "ast" : "ir", level,
+                passes[i].description);
+    }
+}
+
+void passes_report_text(FILE *out)
+{
+    char title[32];
+    snprintf(title, sizeof(title), "passi (-O%d)", opt_level);
+    fprintf(out, "\n%-26s %11s %11s %12s\n", title, "esecuzioni", "modifiche", "wall (ms)");
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        struct pass *p = &passes[i];
+        fprintf(out, "%-26s %11ld %11ld %12.3f%s\n", p->name, p->runs, p->changes, p->wall_ns / 1e6,
+                is_enabled(p) ? "" : "  (disattivato)");
+    }
+}
+
+void passes_report_json(FILE *out)
+{
+    fprintf(out, "{\"level\": %d", opt_level);
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        struct pass *p = &passes[i];
+        fprintf(out, ", \"%s\": {\"enabled\": %s, \"runs\": %ld, \"changes\": %ld, \"wall_ms\": %.3f}", p->name,
+                is_enabled(p) ? "true" : "false", p->runs, p->changes, p->wall_ns / 1e6);
+    }
+    fprintf(out, "}");
+}
@@ -0,0 +1,55 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "ir.h"
+
+/* Gestore dei passi di ottimizzazione. I passi sono registrati in un'unica
+   tabella ordinata: quelli sull'AST girano dopo l'analisi semantica, quelli
+   sull'IR su ogni funzione subito dopo la costruzione della forma SSA.
+   Il livello -O abilita i passi con livello minore o uguale, i flag
+   -f<nome> e -fno-<nome> li abilitano o disabilitano singolarmente.
+*/
+
+enum PASS_KIND
+{
+    PASS_AST,
+    PASS_IR
+};
+
+// Livello massimo accettato da -O
+#define PASS_MAX_LEVEL 2
+// Livello dei passi che nessun -O abilita
+#define PASS_FLAG_ONLY (PASS_MAX_LEVEL + 1)
+
+struct pass
+{
+    const char *name; // nome usato nei flag -f<nome>
+    const char *description;
+    enum PASS_KIND kind;
+    int level; // livello -O minimo a cui il passo è attivo, PASS_FLAG_ONLY se serve -f<nome>
+
+    // Eseguono il passo e restituiscono il numero di modifiche
+    long (*run_ast)(struct AstNode *root);
+    long (*run_ir)(struct ir_function *fn);
+
+    int flag; // 0 nessun flag, 1 -f<nome>, -1 -fno-<nome>
+    long runs;
+    long changes;
+    long long wall_ns;
+};
+
+// Livello di ottimizzazione (-O0, -O1, -O2), 0 di default
+extern int opt_level;
+
+int passes_parse_option(const char *arg);
+int passes_enabled(const char *name);
+int passes_need_ir();
+void passes_run_ast(struct AstNode *root);
+void passes_run_ir(struct ir_function *fn);
+void passes_list(FILE *out);
+void passes_report_text(FILE *out);
+void passes_report_json(FILE *out);
+
+#endif
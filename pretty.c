@@ -269,3 +269,37 @@ char* convert_var_type(enum LUA_TYPE type)
         return "unknown";
     }
 }
+
+// Convertire un tipo di nodo in una stringa
+char* convert_node_type(enum NODE_TYPE type)
+{
+    switch (type)
+    {
+    case EXPR_T:
+        return "EXPR_T";
+    case VAL_T:
+        return "VAL_T";
+    case VAR_T:
+        return "VAR_T";
+    case TABLE_FIELD_T:
+        return "TABLE_FIELD_T";
+    case TABLE_NODE_T:
+        return "TABLE_NODE_T";
+    case DECL_T:
+        return "DECL_T";
+    case RETURN_T:
+        return "RETURN_T";
+    case FCALL_T:
+        return "FCALL_T";
+    case FDEF_T:
+        return "FDEF_T";
+    case IF_T:
+        return "IF_T";
+    case FOR_T:
+        return "FOR_T";
+    case ERROR_NODE_T:
+        return "ERROR_NODE_T";
+    default:
+        return "unknown";
+    }
+}
@@ -10,6 +10,7 @@ void print_tab(int depth);
 
 char* convert_expr_type(enum EXPRESSION_TYPE expr_type);
 char* convert_var_type(enum LUA_TYPE type);
+char* convert_node_type(enum NODE_TYPE type);
 char* convert_func_name(char* name);
 
 #endif
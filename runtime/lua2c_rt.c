@@ -0,0 +1,102 @@
+#include "lua2c_rt.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+char *c_lua_io_read_line(void)
+{
+    char *buff;
+    if (scanf("%ms", &buff) != 1)
+        return NULL;
+    return buff;
+}
+
+float c_lua_io_read_number(void)
+{
+    float ret;
+    if (scanf("%f", &ret) != 1)
+        return 0;
+    return ret;
+}
+
+char *c_lua_io_read_bytes(int n)
+{
+    if (n < 0)
+        n = 0;
+    char *buff = (char *)malloc(sizeof(char) * (n + 1));
+    if (!buff)
+        return NULL;
+    size_t len = fread(buff, 1, n, stdin);
+    if (len == 0 && n > 0)
+    {
+        free(buff);
+        return NULL;
+    }
+    buff[len] = '\0';
+    return buff;
+}
+
+unsigned c_lua_switch_hash(const char *s, unsigned seed)
+{
+    unsigned h = 2166136261u ^ seed;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+int c_lua_switch_slot(const char *s, const char *const *keys, unsigned seed, unsigned mask)
+{
+    if (!s)
+        return -1;
+    unsigned slot = c_lua_switch_hash(s, seed) & mask;
+    return keys[slot] && strcmp(keys[slot], s) == 0 ? (int)slot : -1;
+}
+
+struct lua_parallel_task
+{
+    lua_parallel_body body;
+    void *ctx;
+    long long lo, hi;
+    void *acc;
+};
+
+static void *lua_parallel_run(void *arg)
+{
+    struct lua_parallel_task *t = arg;
+    t->body(t->ctx, t->lo, t->hi, t->acc);
+    return NULL;
+}
+
+int lua_parallel_for(long long trips, lua_parallel_body body, void *ctx, void *acc, size_t acc_size)
+{
+    pthread_t threads[LUA_PARALLEL_MAX_THREADS];
+    struct lua_parallel_task tasks[LUA_PARALLEL_MAX_THREADS];
+    int started[LUA_PARALLEL_MAX_THREADS];
+    char *env = getenv("OMP_NUM_THREADS");
+    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        n = 1;
+    if (n > LUA_PARALLEL_MAX_THREADS)
+        n = LUA_PARALLEL_MAX_THREADS;
+    if (n > trips)
+        n = trips;
+    for (long t = 0; t < n; t++)
+    {
+        tasks[t] = (struct lua_parallel_task){body, ctx, trips * t / n, trips * (t + 1) / n,
+                                              (char *)acc + t * acc_size};
+        started[t] = t > 0 && pthread_create(&threads[t], NULL, lua_parallel_run, &tasks[t]) == 0;
+    }
+    for (long t = 0; t < n; t++)
+    {
+        if (!started[t])
+            lua_parallel_run(&tasks[t]);
+    }
+    for (long t = 1; t < n; t++)
+    {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+    return (int)n;
+}
@@ -0,0 +1,61 @@
+/* Runtime dei programmi generati dal transpiler con --runtime-lib.
+
+   Invece di scrivere in ogni header le funzioni del runtime come static
+   inline, il C generato include questo header e si collega a
+   liblua2c_rt.a, compilata una volta dal Makefile con -O2 (con LTO=1
+   anche con oggetti LTO, che permettono a gcc -flto di espandere inline
+   le funzioni nel programma):
+
+       gcc -Iruntime prog.c runtime/liblua2c_rt.a -lpthread
+
+   Nomi, tipi e comportamento sono gli stessi delle funzioni che
+   translate.c scrive nell'header senza --runtime-lib. LUA2C_RT_VERSION
+   cambia quando cambia questa interfaccia.
+*/
+#ifndef LUA2C_RT_H
+#define LUA2C_RT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LUA2C_RT_VERSION 1
+
+// Campo di una tabella
+typedef struct
+{
+    char *key;
+    union value
+        {
+            int int_value;
+            double float_value;
+            char *string_value;
+            bool bool_value;
+        } value;
+} lua_field;
+
+/* io.read("*l"), io.read("*n") e io.read(n): a fine input le stringhe
+   sono NULL e il numero è 0; io.read(n) legge al più n byte.
+*/
+char *c_lua_io_read_line(void);
+float c_lua_io_read_number(void);
+char *c_lua_io_read_bytes(int n);
+
+/* Switch sulle stringhe: posizione di s nella tabella keys indicizzata
+   dall'hash perfetto (FNV-1a con seme) calcolato durante la traduzione,
+   -1 se s non è una delle chiavi.
+*/
+unsigned c_lua_switch_hash(const char *s, unsigned seed);
+int c_lua_switch_slot(const char *s, const char *const *keys, unsigned seed, unsigned mask);
+
+/* Cicli paralleli senza OpenMP: divide [0, trips) in un blocco contiguo
+   per thread (OMP_NUM_THREADS o i processori online, al più
+   LUA_PARALLEL_MAX_THREADS) e restituisce il numero di blocchi, ognuno
+   con i propri parziali in acc.
+*/
+#define LUA_PARALLEL_MAX_THREADS 64
+
+typedef void (*lua_parallel_body)(void *ctx, long long lo, long long hi, void *acc);
+
+int lua_parallel_for(long long trips, lua_parallel_body body, void *ctx, void *acc, size_t acc_size);
+
+#endif
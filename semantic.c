@@ -1,5 +1,6 @@
 #include "semantic.h"
 #include "global.h"
+#include "stats.h"
 #include <string.h>
 #include <stdlib.h>
 #include "symtab.h"
@@ -24,8 +25,20 @@ enum LUA_TYPE eval_bool(char *t)
     }
 }
 
-// Valuta il tipo di espressione - in Lua significa inferire il tipo a runtime
+static struct complex_type eval_expr_type_impl(struct AstNode *expr, struct symlist *current_scope);
+static enum LUA_TYPE infer_func_return_type_impl(struct AstNode *code, struct symlist *func_scope);
+
+// Valuta il tipo di espressione, misurandone il tempo per --stats
 struct complex_type eval_expr_type(struct AstNode *expr, struct symlist *current_scope)
+{
+    stats_begin(TIMER_EVAL_EXPR);
+    struct complex_type result = eval_expr_type_impl(expr, current_scope);
+    stats_end(TIMER_EVAL_EXPR);
+    return result;
+}
+
+// Valuta il tipo di espressione - in Lua significa inferire il tipo a runtime
+static struct complex_type eval_expr_type_impl(struct AstNode *expr, struct symlist *current_scope)
 {
     struct complex_type result;
     result.kind = DYNAMIC; // Default a dinamico per Lua
@@ -222,6 +235,7 @@ void check_division(struct AstNode *expr, struct symlist *current_scope)
 
 void check_fcall(struct AstNode *func_expr, struct AstNode *args)
 {
+    stats_begin(TIMER_CHECK_FCALL);
     if (func_expr->nodetype == VAR_T &&
         strcmp(func_expr->node.var->name, "io.read") == 0)
     {
@@ -299,10 +313,20 @@ void check_fcall(struct AstNode *func_expr, struct AstNode *args)
         // Chiamata a qualcosa che non è un ID semplice (es. (get_func())() )
         yywarning("calling a complex expression as a function is not fully checked yet");
     }
+    stats_end(TIMER_CHECK_FCALL);
 }
 
-// Inferisce il tipo di ritorno di una funzione analizzando il suo codice e le istruzioni di return
+// Inferisce il tipo di ritorno di una funzione, misurandone il tempo per --stats
 enum LUA_TYPE infer_func_return_type(struct AstNode *code, struct symlist *func_scope)
+{
+    stats_begin(TIMER_INFER_RET);
+    enum LUA_TYPE result = infer_func_return_type_impl(code, func_scope);
+    stats_end(TIMER_INFER_RET);
+    return result;
+}
+
+// Inferisce il tipo di ritorno di una funzione analizzando il suo codice e le istruzioni di return
+static enum LUA_TYPE infer_func_return_type_impl(struct AstNode *code, struct symlist *func_scope)
 {
     if (!code)
         return NIL_T;
@@ -0,0 +1,265 @@
+#include "stats.h"
+#include "global.h"
+#include "pretty.h"
+#include "fastscan.h"
+#include "mem.h"
+#include "passes.h"
+#include <stdio.h>
+#include <time.h>
+
+#define STATS_STACK_SIZE 64
+
+struct stats stats;
+enum STATS_FORMAT stats_format = STATS_OFF;
+char *stats_filename = NULL;
+
+// Elemento dello stack dei timer attivi
+struct timer_frame
+{
+    enum STATS_TIMER timer;
+    int nesting; // rientri dello stesso timer (es. ricorsione di eval_expr_type)
+};
+
+static struct timer_frame stack[STATS_STACK_SIZE];
+static int stack_top = 0;
+static long long last_switch;               // ultimo cambio del timer attivo
+static long long region_wall, region_cpu;   // inizio del timer di primo livello corrente
+static long long start_wall, start_cpu;     // inizio dell'esecuzione
+
+/* Tempo wall esclusivo di ogni timer, diviso per il timer di primo livello
+   sotto cui è stato misurato. Il tempo CPU viene letto solo all'apertura e
+   chiusura dei timer di primo livello (leggerlo per ogni token costerebbe
+   più del lexing stesso): quello dei timer annidati è stimato scalando il
+   wall con il rapporto cpu/wall del timer di primo livello che li contiene.
+*/
+static long long wall_ns[TIMER_COUNT][TIMER_COUNT];
+static long long top_wall_ns[TIMER_COUNT];
+static long long top_cpu_ns[TIMER_COUNT];
+
+static const char *timer_names[TIMER_COUNT] = {
+    "lex", "parse", "eval_expr_type", "infer_func_return_type", "check_fcall", "ir", "opt", "translate", "output",
+};
+
+static long long clock_ns(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Attribuisce il tempo trascorso dall'ultimo cambio al timer in cima allo stack
+static void charge(long long now)
+{
+    wall_ns[stack[stack_top - 1].timer][stack[0].timer] += now - last_switch;
+    last_switch = now;
+}
+
+void stats_init()
+{
+    start_wall = clock_ns(CLOCK_MONOTONIC);
+    start_cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void stats_begin(enum STATS_TIMER t)
+{
+    if (stats_format == STATS_OFF)
+        return;
+
+    // Rientro nello stesso timer o stack pieno: il tempo resta al frame corrente
+    if (stack_top > 0 && (stack[stack_top - 1].timer == t || stack_top == STATS_STACK_SIZE))
+    {
+        stack[stack_top - 1].nesting++;
+        return;
+    }
+
+    long long now = clock_ns(CLOCK_MONOTONIC);
+    if (stack_top > 0)
+    {
+        charge(now);
+    }
+    else
+    {
+        region_wall = now;
+        region_cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+        last_switch = now;
+    }
+
+    stack[stack_top].timer = t;
+    stack[stack_top].nesting = 0;
+    stack_top++;
+}
+
+void stats_end(enum STATS_TIMER t)
+{
+    if (stats_format == STATS_OFF || stack_top == 0)
+        return;
+
+    struct timer_frame *f = &stack[stack_top - 1];
+    if (f->nesting > 0)
+    {
+        f->nesting--;
+        return;
+    }
+
+    // Senza rientri il frame è stato aperto da stats_begin(f->timer): un altro t indica begin ed end non appaiati
+    if (f->timer != t)
+        fprintf(stderr, YELLOW "warning:" RESET " stats_end(%s) closes timer %s\n", timer_names[t],
+                timer_names[f->timer]);
+
+    long long now = clock_ns(CLOCK_MONOTONIC);
+    charge(now);
+    stack_top--;
+
+    if (stack_top == 0)
+    {
+        top_wall_ns[f->timer] += now - region_wall;
+        top_cpu_ns[f->timer] += clock_ns(CLOCK_PROCESS_CPUTIME_ID) - region_cpu;
+    }
+}
+
+// Tempo wall esclusivo totale di un timer
+static long long timer_wall(enum STATS_TIMER t)
+{
+    long long sum = 0;
+    for (int top = 0; top < TIMER_COUNT; top++)
+        sum += wall_ns[t][top];
+    return sum;
+}
+
+// Tempo CPU esclusivo di un timer, stimato come descritto sopra
+static long long timer_cpu(enum STATS_TIMER t)
+{
+    double sum = 0;
+    for (int top = 0; top < TIMER_COUNT; top++)
+    {
+        if (top_wall_ns[top] > 0)
+            sum += (double)wall_ns[t][top] * top_cpu_ns[top] / top_wall_ns[top];
+    }
+    return (long long)sum;
+}
+
+static long total_ast_nodes()
+{
+    long sum = 0;
+    for (int i = 0; i <= ERROR_NODE_T; i++)
+        sum += stats.ast_nodes[i];
+    return sum;
+}
+
+static double avg_scope_depth()
+{
+    return stats.find_symtab_calls ? (double)stats.scopes_walked / stats.find_symtab_calls : 0.0;
+}
+
+static void report_text(FILE *out, long long wall, long long cpu)
+{
+    fprintf(out, "\n>> Statistiche transpiler (%s, scansione %s)\n", filename ? filename : "-", fastscan_impl_name());
+    fprintf(out, "%-26s %12s %12s\n", "fase", "wall (ms)", "cpu (ms)");
+    for (int t = 0; t < TIMER_COUNT; t++)
+    {
+        fprintf(out, "%-26s %12.3f %12.3f\n", timer_names[t], timer_wall(t) / 1e6, timer_cpu(t) / 1e6);
+    }
+    fprintf(out, "%-26s %12.3f %12.3f\n", "totale", wall / 1e6, cpu / 1e6);
+
+    fprintf(out, "\n%-26s %ld\n", "token", stats.tokens);
+    fprintf(out, "%-26s %ld\n", "nodi AST", total_ast_nodes());
+    for (int i = 0; i <= ERROR_NODE_T; i++)
+    {
+        if (stats.ast_nodes[i])
+            fprintf(out, "  %-24s %ld\n", convert_node_type(i), stats.ast_nodes[i]);
+    }
+    fprintf(out, "%-26s %ld\n", "nodi AST condivisi", stats.ast_shared);
+    fprintf(out, "%-26s %ld\n", "simboli inseriti", stats.symbols_inserted);
+    fprintf(out, "%-26s %ld (profondità media %.2f)\n", "chiamate find_symtab", stats.find_symtab_calls,
+            avg_scope_depth());
+    if (stats.ir_blocks)
+        fprintf(out, "%-26s %ld blocchi, %ld valori, %ld phi\n", "IR", stats.ir_blocks, stats.ir_values,
+                stats.ir_phis);
+    fprintf(out, "%-26s %ld (.c %ld, .h %ld)\n", "byte emessi", stats.bytes_c + stats.bytes_h, stats.bytes_c,
+            stats.bytes_h);
+
+    passes_report_text(out);
+    mem_report_text(out);
+}
+
+// Stringa JSON tra virgolette: il nome del file può contenere " e \ o caratteri di controllo
+static void json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void report_json(FILE *out, long long wall, long long cpu)
+{
+    fprintf(out, "{\n  \"input\": ");
+    json_string(out, filename ? filename : "");
+    fprintf(out, ",\n  \"simd\": \"%s\",\n  \"phases\": {\n", fastscan_impl_name());
+    for (int t = 0; t < TIMER_COUNT; t++)
+    {
+        fprintf(out, "    \"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f}%s\n", timer_names[t], timer_wall(t) / 1e6,
+                timer_cpu(t) / 1e6, t + 1 < TIMER_COUNT ? "," : "");
+    }
+    fprintf(out, "  },\n  \"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f},\n", wall / 1e6, cpu / 1e6);
+
+    fprintf(out, "  \"counters\": {\n    \"tokens\": %ld,\n    \"ast_nodes\": {\"total\": %ld", stats.tokens,
+            total_ast_nodes());
+    for (int i = 0; i <= ERROR_NODE_T; i++)
+    {
+        fprintf(out, ", \"%s\": %ld", convert_node_type(i), stats.ast_nodes[i]);
+    }
+    fprintf(out, ", \"shared\": %ld},\n    \"symbols_inserted\": %ld,\n", stats.ast_shared, stats.symbols_inserted);
+    fprintf(out, "    \"find_symtab_calls\": %ld,\n    \"scopes_walked\": %ld,\n    \"avg_scope_depth\": %.3f,\n",
+            stats.find_symtab_calls, stats.scopes_walked, avg_scope_depth());
+    fprintf(out, "    \"ir\": {\"blocks\": %ld, \"values\": %ld, \"phis\": %ld},\n", stats.ir_blocks, stats.ir_values,
+            stats.ir_phis);
+    fprintf(out, "    \"bytes_emitted\": {\"c\": %ld, \"h\": %ld, \"total\": %ld}\n  },\n", stats.bytes_c,
+            stats.bytes_h, stats.bytes_c + stats.bytes_h);
+
+    fprintf(out, "  \"passes\": ");
+    passes_report_json(out);
+    fprintf(out, ",\n  \"memory\": ");
+    mem_report_json(out);
+    fprintf(out, "\n}\n");
+}
+
+/* Stampa il report nel formato richiesto, su stderr o sul file
+   indicato con --stats-file
+*/
+void stats_report()
+{
+    if (stats_format == STATS_OFF)
+        return;
+
+    long long wall = clock_ns(CLOCK_MONOTONIC) - start_wall;
+    long long cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - start_cpu;
+
+    FILE *out = stderr;
+    if (stats_filename)
+    {
+        out = fopen(stats_filename, "w");
+        if (!out)
+        {
+            fprintf(stderr, RED "error:" RESET " cannot open stats file %s: ", stats_filename);
+            perror("");
+            return;
+        }
+    }
+
+    if (stats_format == STATS_JSON)
+        report_json(out, wall, cpu);
+    else
+        report_text(out, wall, cpu);
+
+    if (out != stderr)
+        fclose(out);
+}
@@ -0,0 +1,58 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "ast.h"
+
+/* Timer delle fasi del transpiler. I timer possono essere annidati
+   (es. lexing e analisi semantica durante il parsing): il tempo viene
+   attribuito in modo esclusivo al timer più interno attivo.
+*/
+enum STATS_TIMER
+{
+    TIMER_LEX,
+    TIMER_PARSE,
+    TIMER_EVAL_EXPR,
+    TIMER_INFER_RET,
+    TIMER_CHECK_FCALL,
+    TIMER_IR,
+    TIMER_OPT,
+    TIMER_TRANSLATE,
+    TIMER_OUTPUT,
+    TIMER_COUNT
+};
+
+// Formato del report (--stats, --stats=json)
+enum STATS_FORMAT
+{
+    STATS_OFF,
+    STATS_TEXT,
+    STATS_JSON
+};
+
+// Contatori raccolti durante l'esecuzione, aggiornati anche con le statistiche disattivate
+struct stats
+{
+    long tokens;
+    long ast_nodes[ERROR_NODE_T + 1];
+    long ast_shared; // nodi riusati dal hash-consing invece di essere allocati
+    long symbols_inserted;
+    long find_symtab_calls;
+    long scopes_walked; // scope visitati in totale da find_symtab
+    long ir_blocks;
+    long ir_values;
+    long ir_phis; // phi rimaste dopo l'eliminazione di quelle banali
+    long bytes_c;
+    long bytes_h;
+};
+
+extern struct stats stats;
+extern enum STATS_FORMAT stats_format;
+extern char *stats_filename;
+
+void stats_init();
+void stats_begin(enum STATS_TIMER t);
+// Chiude il timer t, che deve essere quello aperto per ultimo (con --stats avvisa se non lo è)
+void stats_end(enum STATS_TIMER t);
+void stats_report();
+
+#endif
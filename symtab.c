@@ -1,6 +1,7 @@
 #include "symtab.h"
 #include "ast.h"
 #include "global.h"
+#include "stats.h"
 #include <stdio.h>
 
 /* Crea una nuova symbol table */
@@ -10,7 +11,7 @@ struct symlist *create_symtab(int scope, struct symlist *next)
         next = puntatore alla tabella precedente (a scope più esterno)
     */
     struct symbol *symtab = NULL; // creo una nuova tabella vuota
-    struct symlist *syml = malloc(sizeof(struct symlist));
+    struct symlist *syml = mem_alloc(MEM_SYMBOLS, sizeof(struct symlist));
 
     syml->scope = scope;
     syml->symtab = symtab;
@@ -29,13 +30,13 @@ struct symlist *delete_symtab(struct symlist *syml)
     {
         HASH_DEL(syml->symtab, s);
 
-        free(s->line);
-        free(s);
+        mem_free(s->line);
+        mem_free(s);
     }
 
     struct symlist *next;
     next = syml->next;
-    free(syml);
+    mem_free(syml);
     return next;
 }
 
@@ -64,8 +65,10 @@ struct symbol *find_symtab(struct symlist *syml, char *name)
     struct symlist *tmp = syml;
     struct symbol *s;
 
+    stats.find_symtab_calls++;
     while (tmp)
     {
+        stats.scopes_walked++;
         s = find_sym(tmp, name);
 
         if (s)
@@ -90,17 +93,32 @@ void insert_sym(struct symlist *syml, char *name, enum LUA_TYPE type, enum sym_t
     */
     struct symbol *s;
 
+    /* Simbolo già presente nello scope (riassegnazione): viene aggiornato.
+       Aggiungere un duplicato con la stessa chiave allungherebbe la catena
+       del bucket ad ogni assegnazione, rendendo la ricerca lineare.
+    */
     s = find_sym(syml, name);
+    if (s)
+    {
+        s->type = type;
+        s->sym_type = sym_type;
+        s->pl = pl;
+        s->lineno = lineno;
+        mem_free(s->line);
+        s->line = mem_strdup(MEM_SYMBOLS, line);
+        return;
+    }
 
-    s = malloc(sizeof(struct symbol));
+    s = mem_alloc(MEM_SYMBOLS, sizeof(struct symbol));
     s->name = name;
     s->type = type;
     s->sym_type = sym_type;
     s->pl = pl;
     s->lineno = lineno;
-    s->line = strdup(line);
+    s->line = mem_strdup(MEM_SYMBOLS, line);
     s->used_flag = 0;
 
+    stats.symbols_inserted++;
     HASH_ADD_STR(syml->symtab, name, s);
 }
 
@@ -1,6 +1,11 @@
 #ifndef SYMTAB_H
 #define SYMTAB_H
 
+#include "mem.h"
+
+// Le tabelle hash di uthash allocano tramite il contatore dei simboli
+#define uthash_malloc(sz) mem_alloc(MEM_SYMBOLS, sz)
+#define uthash_free(ptr, sz) mem_free(ptr)
 #include "uthash.h"
 #include "ast.h"
 #include "pretty.h"
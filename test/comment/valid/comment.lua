@@ -0,0 +1,19 @@
+-- Test per commenti lunghi, commenti di riga e corpi di stringa
+
+--[[ Commento lungo su una riga ]]
+--[[ Commento lungo
+     su più righe, con ] singole e "virgolette"
+     e 'apici' che non aprono stringhe
+]]
+--[ commento di riga che inizia con una sola parentesi
+--
+
+a = 1 --[[ commento lungo dopo uno statement ]] b = 2
+
+s1 = "stringa con \"escape\" e \\ backslash"
+s2 = 'stringa con \'apici\' e \\ backslash'
+s3 = "una stringa decisamente più lunga di trentadue caratteri, per coprire il percorso vettoriale"
+
+print(s1)
+print(s2)
+print(s3, a, b)
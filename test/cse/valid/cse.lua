@@ -0,0 +1,20 @@
+function square(x)
+    return x * x
+end
+
+function area(a, b)
+    return a * b + a * b
+end
+
+function mix(a, b)
+    c = (a + b) * (a - b)
+    d = (a + b) * (a - b) + 1
+    return c + d
+end
+
+print(area(3, 4))
+print(mix(7, 2))
+print(square(9) + square(9))
+x = 5
+y = x * 2 + x * 2
+print(y)
@@ -0,0 +1,24 @@
+function scaled(i)
+    return i * 2 + 1
+end
+
+s = 0
+for i = 1, 3 do
+    s = s + (i * 2 + 1)
+end
+print(s)
+
+t = 0
+for i = 10, 1, -3 do
+    t = t + (i * 2 + 1)
+end
+print(t)
+
+n = 7
+u = 0
+for i = 1, n do
+    u = u + (i * 2 + 1) + (2 * 3 + 1)
+end
+print(u)
+
+print(scaled(4) + (2 * 3 + 1))
@@ -0,0 +1,38 @@
+function unused(x)
+    return helper(x) + 1
+end
+
+function helper(x)
+    return x * 2
+end
+
+function sign(x)
+    if x < 0 then
+        return -1
+    else
+        return 1
+    end
+    print("never")
+end
+
+function used(x)
+    y = x + 1
+    return x * 3
+    print(x)
+end
+
+debug = false
+scratch = 0
+for i = 1, 3 do
+    scratch = scratch + i
+    print(used(i))
+end
+if 1 < 2 then
+    print("taken")
+else
+    print("not taken")
+end
+if 2 < 1 then
+    print("dropped")
+end
+print(sign(-5))
@@ -0,0 +1,73 @@
+-- Funzioni pure chiamate con argomenti costanti
+
+function square(x)
+    return x * x
+end
+
+function fibonacci(n)
+    if n <= 1 then
+        return n
+    end
+    a = 0
+    b = 1
+    for i = 2, n do
+        t = a + b
+        a = b
+        b = t
+    end
+    return b
+end
+
+function fact(n)
+    if n <= 1 then
+        return 1
+    end
+    return n * fact(n - 1)
+end
+
+function hyp(a, b)
+    return square(a) + square(b)
+end
+
+function half(x)
+    return x / 2
+end
+
+function sign(x)
+    if x < 0 then
+        return "negativo"
+    else
+        return "positivo"
+    end
+end
+
+function countdown(n)
+    s = 0
+    for i = n, 1, -1 do
+        s = s + i
+    end
+    return s
+end
+
+function overflow(n)
+    return n * 100000
+end
+
+function fib(n)
+    if n < 2 then
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+print("ricorsiva", fib(15), fib(40))
+print("quadrato", square(12))
+print("fibonacci", fibonacci(20), fibonacci(30))
+print("fattoriale", fact(10))
+print("ipotenusa", hyp(3, 4))
+print("meta", half(7))
+print("segno", sign(-3), sign(2))
+print("somma", countdown(100))
+print("overflow", overflow(100000))
+x = io.read("*n")
+print("dinamico", square(x))
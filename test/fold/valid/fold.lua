@@ -0,0 +1,27 @@
+function area(r)
+    k = 2 * 3 + 1
+    return k * r
+end
+
+x = 2 * 3 + 1
+y = x * 2
+z = 7 / 2
+print("x", x, y, z)
+flag = 1 < 2 and not false
+if flag then
+    print("sempre")
+else
+    print("mai")
+end
+n = 10
+if n > 20 then
+    n = 0
+end
+print(n - 1)
+s = 0
+for i = 1, 4 do
+    s = s + i
+end
+print(s, area(3), "a" < "b", 3 == 3.0)
+print(-(4 - 6))
+print("b" < "a", "b" >= "a")
@@ -0,0 +1,21 @@
+function sum(base, stride, n)
+    s = 0
+    for i = 0, n do
+        s = s + base + i * stride
+    end
+    return s
+end
+
+function scaled(n)
+    t = 0
+    for i = 1, n, 2 do
+        t = t + i * 3 * 5 + i * 2 + i / 4 + i * 1 + (i + 0) - 0
+    end
+    return t
+end
+
+print(sum(100, 8, 10))
+print(scaled(9))
+x = 7
+print(x / 0.5)
+print(x * 1.0)
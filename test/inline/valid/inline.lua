@@ -0,0 +1,40 @@
+function square(x)
+    return x * x
+end
+
+function sign(x)
+    r = 1
+    if x < 0 then
+        r = -1
+    end
+    return r
+end
+
+function scale(x, k = 3)
+    return x * k
+end
+
+function sum_to(n)
+    s = 0
+    for i = 1, n do
+        s = s + square(i)
+    end
+    return s
+end
+
+function half(x)
+    return x / 2
+end
+
+function shout(x)
+    print("valore", x)
+end
+
+total = 0
+for i = 1, 10 do
+    total = total + square(i) + sign(i - 5) + scale(i, 3)
+end
+print(total, sum_to(5), half(7), scale(2, 5))
+shout(4)
+y = io.read("*n")
+print(square(y), sign(y - 5), half(y))
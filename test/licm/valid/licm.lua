@@ -0,0 +1,31 @@
+function square(x)
+    return x * x
+end
+
+function sum(a, b, n)
+    s = 0
+    for i = 1, n do
+        s = s + a * b + square(a) + i
+    end
+    return s
+end
+
+print(sum(3, 4, 10))
+total = 0
+k = 7
+for i = 1, 5 do
+    for j = 1, 4 do
+        total = total + k * 2 + square(k) + j
+    end
+end
+print(total)
+for i = 10, 1, -3 do
+    print(i)
+end
+m = 2.5
+for i = 1, m * 2 do
+    print(i)
+end
+for i = -2, -m do
+    print(i)
+end
@@ -0,0 +1,17 @@
+function fib(n)
+    if n < 2 then
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+function paths(x, y)
+    if x == 0 or y == 0 then
+        return 1
+    end
+    return paths(x - 1, y) + paths(x, y - 1)
+end
+
+print(fib(25))
+print(fib(25) + fib(24))
+print(paths(8, 8))
@@ -0,0 +1,25 @@
+-- fold ed eval calcolano le costanti con i tipi del C generato: int tra
+-- interi, float per le variabili e per le divisioni tra interi
+n = -3
+z = -(-2 + 2)
+print(z, z * n, -(2 - 2) * n)
+third = 1 / 3
+print(third * 3 - 1, 1 / 3 * 3 - 1)
+big = 16777217
+print(big + 0.5, big - 16777216)
+
+function scaled(a, b)
+    v = a / b * 1.1 + 0.1
+    w = v * v - 1 / 3
+    return w * 1000000
+end
+
+function ratio(a, b)
+    s = 2 + b
+    t = a * s / b - 2 * b
+    u = 6.5 * (b / 2) - s / t / -(s + t)
+    return -(u / -(1.5 * s * -(u * u)))
+end
+
+print(scaled(1, 3), scaled(7, 9))
+print(ratio(6, 6))
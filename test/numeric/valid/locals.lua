@@ -0,0 +1,25 @@
+-- Le variabili assegnate con un'operazione aritmetica sono float anche nelle
+-- funzioni: il prodotto non va in overflow e -x * 0 resta uno zero negativo
+function scale(a)
+    v = a - 1
+    w = v * 100000 * 100000
+    return w
+end
+
+function zero(x)
+    v = x - 1
+    y = -v * 0
+    return y
+end
+
+function half(n)
+    h = n / 2
+    return h
+end
+
+print(scale(3))
+print(scale(-7))
+print(zero(3))
+print(zero(2.5))
+print(zero(-1))
+print(half(7))
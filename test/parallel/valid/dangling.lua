@@ -0,0 +1,14 @@
+--@parallel
+x = 1
+total = 0
+for i = 1, 100 do
+    total = total + i * x
+end
+print(total)
+
+--@parallel
+for i = 1, 100 do
+    total = total + i
+end
+print(total)
+--@parallel
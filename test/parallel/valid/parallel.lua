@@ -0,0 +1,32 @@
+function weighted(n, k)
+    s = 0
+    --@parallel
+    for i = 1, n do
+        s = s + i * k - 1
+    end
+    return s
+end
+
+print(weighted(1000, 3))
+
+lo = 1000000
+hi = -1000000
+count = 0
+--@parallel
+for i = 1, 50000 do
+    count = count + 1
+    if i * 3 - 70000 < lo then
+        lo = i * 3 - 70000
+    end
+    if hi < 20000 - i then
+        hi = 20000 - i
+    end
+end
+print(count)
+print(lo)
+print(hi)
+
+--@parallel
+for i = 3, 1, -1 do
+    print(i)
+end
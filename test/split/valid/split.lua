@@ -0,0 +1,20 @@
+function square(x)
+    return x * x
+end
+
+function cube(x)
+    return square(x) * x
+end
+
+function sum_to(n)
+    s = 0
+    --@parallel
+    for i = 1, n do
+        s = s + i
+    end
+    return s
+end
+
+print(square(7))
+print(cube(3))
+print(sum_to(1000))
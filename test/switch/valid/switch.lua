@@ -0,0 +1,42 @@
+function grade(n)
+    if n == 1 then
+        return "one"
+    else
+        if n == 2 then
+            return "two"
+        else
+            if 3 == n then
+                return "three"
+            else
+                if n == -4 then
+                    return "minus four"
+                else
+                    return "many"
+                end
+            end
+        end
+    end
+end
+
+for i = -4, 5 do
+    print(grade(i))
+end
+
+op = "mul"
+r = 0
+if op == "add" then
+    r = 1
+else
+    if op == "sub" then
+        r = 2
+    else
+        if op == "mul" then
+            r = 3
+        else
+            if op == "div" then
+                r = 4
+            end
+        end
+    end
+end
+print(r)
@@ -0,0 +1,34 @@
+function countdown(n, acc)
+    if n == 0 then
+        print(acc)
+        return
+    end
+    countdown(n - 1, acc + n)
+end
+
+function ping(n)
+    if n == 0 then
+        print("ping")
+    else
+        pong(n - 1)
+    end
+end
+
+function pong(n)
+    if n == 0 then
+        print("pong")
+    else
+        ping(n - 1)
+    end
+end
+
+function steps(n)
+    if n > 0 then
+        steps(n - 1)
+    end
+end
+
+countdown(50000, 0)
+ping(40001)
+pong(40001)
+steps(50000)
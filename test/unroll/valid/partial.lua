@@ -0,0 +1,20 @@
+s = 0
+for i = 1, 23 do
+    s = s + i * 3
+end
+print(s)
+
+t = 0
+for i = 50, 1, -3 do
+    t = t + i
+end
+print(t)
+
+for i = 40, 1, -3 do
+    print(i)
+end
+
+for i = -1, -30, -2 do
+    s = s - i
+end
+print(s)
@@ -0,0 +1,32 @@
+function weights(n)
+    s = 0
+    for i = 1, 3 do
+        s = s + i * n
+    end
+    return s
+end
+
+total = 0
+for i = 1, 10 do
+    total = total + i * 2
+end
+print(total)
+
+for i = 10, 1, -3 do
+    print(i)
+end
+
+sum = 0
+for i = 1, 4 do
+    for j = 0, 20, 2 do
+        sum = sum + i * j
+    end
+end
+print(sum)
+print(weights(5))
+
+for i = -2, 2 do
+    if i > 0 then
+        print(i)
+    end
+end
@@ -0,0 +1,32 @@
+function stats(n, k)
+    s = 0
+    p = 1
+    lo = 1000000
+    hi = -1000000
+    for i = 1, n do
+        s = s + i * k + 3
+        p = p * 2
+        if i * k - 50 < lo then
+            lo = i * k - 50
+        end
+        if hi < i - 7 then
+            hi = i - 7
+        end
+    end
+    return s + p + lo + hi
+end
+
+print(stats(10, 4))
+
+total = 0
+for i = 100, 1, -7 do
+    total = total - i * 2
+end
+print(total)
+
+count = 0
+for i = 1, 5 do
+    print(i)
+    count = count + 1
+end
+print(count)
@@ -3,16 +3,117 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <ctype.h>
 #include "ast.h"
 #include "pretty.h"
 #include "semantic.h"
 #include "symtab.h"
+#include "stats.h"
+#include "mem.h"
+#include "ir.h"
+#include "effects.h"
+#include "vectorize.h"
+#include "dispatch.h"
+#include "fold.h"
+
+#define OUTPUT_BUF_SIZE (64 * 1024) // buffer di scrittura dei file generati
 
 FILE *output_fp;
 FILE *output_fp_h;
 int translate_depth = 0;
 int scope_lvl = 0;
 int table_field_counter = 0;
+int for_limits = 0; // variabili _limit<n> dei cicli for
+
+int switch_tables = 0; // tabelle _keys<n> degli switch sulle stringhe
+int runtime_lib_flag = 0;
+int split_functions = 0;
+
+static int runtime_used; // RUNTIME_* da scrivere nell'header
+
+// Funzioni dei cicli paralleli per il runtime pthread, copiate nell'header
+static FILE *parallel_fp;
+static char *parallel_buf;
+static size_t parallel_len;
+
+/* Runtime pthread dei cicli paralleli, usato quando il C generato non è
+   compilato con OpenMP: divide [0, trips) in un blocco contiguo per thread
+   (OMP_NUM_THREADS o i processori online) e il primo blocco gira nel
+   thread chiamante. Restituisce il numero di blocchi, ognuno con i propri
+   parziali in acc.
+*/
+static const char parallel_runtime[] =
+    "#ifndef _OPENMP\n"
+    "#include <pthread.h>\n"
+    "#include <unistd.h>\n"
+    "\n"
+    "#define LUA_PARALLEL_MAX_THREADS 64\n"
+    "\n"
+    "typedef void (*lua_parallel_body)(void *ctx, long long lo, long long hi, void *acc);\n"
+    "\n"
+    "struct lua_parallel_task\n"
+    "{\n"
+    "    lua_parallel_body body;\n"
+    "    void *ctx;\n"
+    "    long long lo, hi;\n"
+    "    void *acc;\n"
+    "};\n"
+    "\n"
+    "static inline void *lua_parallel_run(void *arg)\n"
+    "{\n"
+    "    struct lua_parallel_task *t = arg;\n"
+    "    t->body(t->ctx, t->lo, t->hi, t->acc);\n"
+    "    return NULL;\n"
+    "}\n"
+    "\n"
+    "static inline int lua_parallel_for(long long trips, lua_parallel_body body, void *ctx, void *acc, size_t acc_size)\n"
+    "{\n"
+    "    pthread_t threads[LUA_PARALLEL_MAX_THREADS];\n"
+    "    struct lua_parallel_task tasks[LUA_PARALLEL_MAX_THREADS];\n"
+    "    int started[LUA_PARALLEL_MAX_THREADS];\n"
+    "    char *env = getenv(\"OMP_NUM_THREADS\");\n"
+    "    long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);\n"
+    "    if (n < 1)\n"
+    "        n = 1;\n"
+    "    if (n > LUA_PARALLEL_MAX_THREADS)\n"
+    "        n = LUA_PARALLEL_MAX_THREADS;\n"
+    "    if (n > trips)\n"
+    "        n = trips;\n"
+    "    for (long t = 0; t < n; t++)\n"
+    "    {\n"
+    "        tasks[t] = (struct lua_parallel_task){body, ctx, trips * t / n, trips * (t + 1) / n,\n"
+    "                                              (char *)acc + t * acc_size};\n"
+    "        started[t] = t > 0 && pthread_create(&threads[t], NULL, lua_parallel_run, &tasks[t]) == 0;\n"
+    "    }\n"
+    "    for (long t = 0; t < n; t++)\n"
+    "    {\n"
+    "        if (!started[t])\n"
+    "            lua_parallel_run(&tasks[t]);\n"
+    "    }\n"
+    "    for (long t = 1; t < n; t++)\n"
+    "    {\n"
+    "        if (started[t])\n"
+    "            pthread_join(threads[t], NULL);\n"
+    "    }\n"
+    "    return (int)n;\n"
+    "}\n"
+    "\n";
+
+void runtime_use(int helpers)
+{
+    runtime_used |= helpers;
+}
+
+int runtime_helper(const char *name)
+{
+    if (strcmp(name, "c_lua_io_read_line") == 0)
+        return RUNTIME_READ_LINE;
+    if (strcmp(name, "c_lua_io_read_number") == 0)
+        return RUNTIME_READ_NUMBER;
+    if (strcmp(name, "c_lua_io_read_bytes") == 0)
+        return RUNTIME_READ_BYTES;
+    return 0;
+}
 
 // Converte un LUA_TYPE nel corrispondente tipo stringa C
 const char *lua_type_to_c_string(enum LUA_TYPE type)
@@ -36,12 +137,88 @@ const char *lua_type_to_c_string(enum LUA_TYPE type)
     case NUMBER_T:
         return "float";
     case TABLE_T:
+        runtime_use(RUNTIME_FIELD);
         return "lua_field";
     default:
         return "/* unknown_type */ void*";
     }
 }
 
+// Conversione printf usata da print per un argomento del tipo dato
+const char *print_conversion(enum LUA_TYPE type)
+{
+    switch (type)
+    {
+    case INT_T:
+        return "%d";
+    case FLOAT_T:
+        return "%f";
+    case NUMBER_T:
+        return "%g";
+    case STRING_T:
+        return "%s";
+    case NIL_T:
+        return "NULL";
+    case TRUE_T:
+        return "true";
+    case FALSE_T:
+        return "false";
+    case BOOLEAN_T:
+        return "%s";
+    case FUNCTION_T:
+        return "function";
+    case TABLE_T:
+        return "table";
+    case USERDATA_T:
+        return "userdata";
+    default:
+        return "%s";
+    }
+}
+
+// Indica se print passa l'argomento a printf (gli altri tipi sono stampati come testo fisso)
+bool print_passes_arg(enum LUA_TYPE type)
+{
+    return type == INT_T || type == FLOAT_T || type == NUMBER_T || type == STRING_T || type == BOOLEAN_T;
+}
+
+/* Tipo del valore C di un'espressione: l'analisi semantica dà NUMBER_T a
+   ogni operazione aritmetica, ma in C una somma, differenza o prodotto tra
+   interi resta intera, non può essere stampata con %g e come dividendo
+   darebbe una divisione intera. Stessa regola dell'IR (arith_type), così i
+   due backend calcolano e stampano gli stessi valori. Anche un letterale
+   NUMBER_T prodotto da fold con un risultato intero è un int.
+*/
+static enum LUA_TYPE c_value_type(struct AstNode *n, struct symlist *scope)
+{
+    struct const_value c;
+
+    if (n->nodetype == VAL_T)
+    {
+        if (n->node.val->val_type == NUMBER_T && const_parse(NUMBER_T, n->node.val->string_val, &c) &&
+            c.type == INT_T)
+            return INT_T;
+        return n->node.val->val_type;
+    }
+    if (n->nodetype != EXPR_T)
+        return eval_expr_type(n, scope).type;
+
+    switch (n->node.expr->expr_type)
+    {
+    case PAR_T:
+    case NEG_T:
+        return c_value_type(n->node.expr->r, scope);
+    case ADD_T:
+    case SUB_T:
+    case MUL_T:
+        return c_value_type(n->node.expr->l, scope) == INT_T && c_value_type(n->node.expr->r, scope) == INT_T
+                   ? INT_T
+                   : NUMBER_T;
+    default:
+        return eval_expr_type(n, scope).type;
+    }
+}
+
 // Stampa l'indentazione
 void translate_tab()
 {
@@ -67,9 +244,376 @@ void translate_list(struct AstNode *l, const char *separator)
     }
 }
 
+// Intestazione del ciclo for, fino alla graffa aperta
+static void translate_for_header(struct AstNode *n, struct symlist *scope)
+{
+    struct forNode *forn = n->node.forn;
+
+    // Come in Lua il limite è valutato una sola volta, prima del ciclo: se non è un letterale va in una variabile
+    int limit = forn->end && forn->end->nodetype != VAL_T ? ++for_limits : 0;
+    enum LUA_TYPE limit_type = limit ? eval_expr_type(forn->end, scope).type : INT_T;
+    if (limit && limit_type != INT_T)
+    {
+        // Un limite non intero non può stare nella dichiarazione della variabile di controllo
+        fprintf(output_fp, "%s _limit%d = ", lua_type_to_c_string(limit_type), limit);
+        translate_node(forn->end, scope);
+        fprintf(output_fp, ";\n");
+        translate_tab();
+    }
+
+    fprintf(output_fp, "for (");
+
+    fprintf(output_fp, "int %s = ", forn->varname);
+    if (forn->start)
+    {
+        translate_node(forn->start, scope);
+    }
+    else
+    {
+        fprintf(output_fp, "0");
+    }
+    if (limit && limit_type == INT_T)
+    {
+        fprintf(output_fp, ", _limit%d = ", limit);
+        translate_node(forn->end, scope);
+    }
+
+    // Condizione finale del ciclo: con passo negativo si conta all'indietro
+    fprintf(output_fp, "; %s %s ", forn->varname, forn->step && forn->step->nodetype == EXPR_T ? ">=" : "<=");
+    if (limit)
+    {
+        fprintf(output_fp, "_limit%d", limit);
+    }
+    else if (forn->end)
+    {
+        translate_node(forn->end, scope);
+    }
+    else
+    {
+        fprintf(output_fp, "0");
+    }
+
+    fprintf(output_fp, "; ");
+
+    if (forn->step)
+    {
+        fprintf(output_fp, "%s += ", forn->varname);
+        translate_node(forn->step, scope);
+    }
+    else
+    {
+        fprintf(output_fp, "%s++", forn->varname); // Default step è 1
+    }
+
+    fprintf(output_fp, ") {\n");
+}
+
+// Corpo del ciclo for, con la variabile di controllo nel proprio scope
+static void translate_for_body(struct AstNode *n, struct symlist *scope)
+{
+    scope_lvl++;
+    struct symlist *for_scope = create_symtab(scope_lvl, scope);
+
+    insert_sym(for_scope, n->node.forn->varname, INT_T, VARIABLE, NULL, 0, "");
+
+    struct AstNode *for_body = n->node.forn->stmt;
+    while (for_body)
+    {
+        translate_tab();
+        translate_node(for_body, for_scope);
+
+        if (for_body->nodetype != FDEF_T && for_body->nodetype != FOR_T && for_body->nodetype != IF_T)
+        {
+            fprintf(output_fp, ";\n");
+        }
+        for_body = for_body->next;
+    }
+
+    delete_symtab(for_scope);
+    scope_lvl--;
+}
+
+// Prima istruzione del corpo in forma canonica: la variabile di controllo ricavata dal contatore
+static void translate_canonical_var(struct AstNode *n, const char *first, int id, struct symlist *scope)
+{
+    translate_tab();
+    fprintf(output_fp, "int %s = %s + (int)_k%d * ", n->node.forn->varname, first, id);
+    if (n->node.forn->step)
+        translate_node(n->node.forn->step, scope);
+    else
+        fprintf(output_fp, "1");
+    fprintf(output_fp, ";\n");
+}
+
+/* Le riduzioni devono essere già dichiarate, per le clausole, e tutte le
+   variabili del ciclo numeriche, anche quelle lette che vanno nel
+   contesto dei thread.
+*/
+static int canonical_vars_ok(struct vec_loop *vec, struct symlist *scope)
+{
+    for (int i = 0; i < vec->nreductions + vec->ncaptures; i++)
+    {
+        const char *name = i < vec->nreductions ? vec->reductions[i] : vec->captures[i - vec->nreductions];
+        struct symbol *sym = find_symtab(scope, (char *)name);
+        if (!sym || (i < vec->nreductions && !sym->used_flag))
+        {
+            vectorize_reject(vec, "%s non è dichiarata prima del ciclo", name);
+            return 0;
+        }
+        if (sym->type != INT_T && sym->type != FLOAT_T && sym->type != NUMBER_T &&
+            (i < vec->nreductions || sym->type != BOOLEAN_T))
+        {
+            vectorize_reject(vec, "%s non è numerica", name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void parallel_field(const char *fmt, const char *name, struct symlist *scope)
+{
+    const char *type = lua_type_to_c_string(find_symtab(scope, (char *)name)->type);
+    fprintf(parallel_fp, fmt, type, name, name);
+}
+
+/* Il corpo del ciclo id diventa la funzione _par<id> per il runtime
+   pthread, scritta nell'header: riceve nel contesto _par<id>_ctx il primo
+   valore della variabile di controllo, le variabili lette e i valori
+   iniziali delle riduzioni, e lascia i parziali delle riduzioni del suo
+   blocco di iterazioni in _par<id>_acc.
+*/
+static void translate_parallel_body(struct AstNode *n, struct vec_loop *vec, int id, struct symlist *scope)
+{
+    FILE *fp = output_fp;
+    int depth = translate_depth;
+
+    if (!parallel_fp)
+        parallel_fp = open_memstream(&parallel_buf, &parallel_len);
+
+    fprintf(parallel_fp, "struct _par%d_ctx\n{\n    int _first;\n", id);
+    for (int i = 0; i < vec->ncaptures; i++)
+        parallel_field("    %s %s;\n", vec->captures[i], scope);
+    for (int i = 0; i < vec->nreductions; i++)
+        parallel_field("    %s %s;\n", vec->reductions[i], scope);
+    fprintf(parallel_fp, "};\n\nstruct _par%d_acc\n{\n", id);
+    for (int i = 0; i < vec->nreductions; i++)
+        parallel_field("    %s %s;\n", vec->reductions[i], scope);
+    fprintf(parallel_fp, "};\n\n");
+
+    fprintf(parallel_fp, "static void _par%d(void *_ctx%d, long long _lo%d, long long _hi%d, void *_acc%d)\n{\n", id,
+            id, id, id, id);
+    fprintf(parallel_fp, "    struct _par%d_ctx *_c%d = _ctx%d;\n", id, id, id);
+    fprintf(parallel_fp, "    struct _par%d_acc *_a%d = _acc%d;\n", id, id, id);
+    for (int i = 0; i < vec->ncaptures; i++)
+    {
+        parallel_field("    %s %s = ", vec->captures[i], scope);
+        fprintf(parallel_fp, "_c%d->%s;\n", id, vec->captures[i]);
+    }
+    // Somme e prodotti partono dall'elemento neutro, minimo e massimo dal valore prima del ciclo
+    for (int i = 0; i < vec->nreductions; i++)
+    {
+        const char *op = vec->ops[i];
+        parallel_field("    %s %s = ", vec->reductions[i], scope);
+        if (op[0] == '+' || op[0] == '*')
+            fprintf(parallel_fp, "%s;\n", op[0] == '+' ? "0" : "1");
+        else
+            fprintf(parallel_fp, "_c%d->%s;\n", id, vec->reductions[i]);
+    }
+    if (vec->simd)
+        fprintf(parallel_fp, "    #pragma omp simd%s\n", vec->clauses);
+    fprintf(parallel_fp, "    for (long long _k%d = _lo%d; _k%d < _hi%d; _k%d++) {\n", id, id, id, id, id);
+
+    output_fp = parallel_fp;
+    translate_depth = 2;
+    char first[32];
+    snprintf(first, sizeof(first), "_c%d->_first", id);
+    translate_canonical_var(n, first, id, scope);
+    translate_for_body(n, scope);
+    output_fp = fp;
+    translate_depth = depth;
+
+    fprintf(parallel_fp, "    }\n");
+    for (int i = 0; i < vec->nreductions; i++)
+        fprintf(parallel_fp, "    _a%d->%s = %s;\n", id, vec->reductions[i], vec->reductions[i]);
+    fprintf(parallel_fp, "}\n\n");
+}
+
+/* Forma canonica per il vettorizzatore e per i thread: numero di
+   iterazioni calcolato prima del ciclo, contatore da 0 e pragma omp con le
+   riduzioni. La variabile di controllo è ricavata dal contatore all'inizio
+   del corpo. Un ciclo parallelo senza OpenMP passa dal runtime pthread se
+   supera la soglia di iterazioni, altrimenti resta sequenziale.
+   Restituisce il numero delle variabili _first<n>, _trips<n> e _k<n>, 0 se
+   il ciclo va emesso nella forma normale.
+*/
+static int translate_canonical_header(struct AstNode *n, struct vec_loop *vec, struct symlist *scope)
+{
+    struct forNode *forn = n->node.forn;
+    int descending = forn->step && forn->step->nodetype == EXPR_T;
+
+    if (!canonical_vars_ok(vec, scope))
+        return 0;
+    if (eval_expr_type(forn->start, scope).type != INT_T || eval_expr_type(forn->end, scope).type != INT_T)
+    {
+        vectorize_reject(vec, "estremi non interi", NULL);
+        return 0;
+    }
+
+    int id = ++for_limits;
+    fprintf(output_fp, "int _first%d = ", id);
+    translate_node(forn->start, scope);
+    fprintf(output_fp, ";\n");
+    translate_tab();
+    fprintf(output_fp, "int _limit%d = ", id);
+    translate_node(forn->end, scope);
+    fprintf(output_fp, ";\n");
+    translate_tab();
+    if (descending)
+        fprintf(output_fp, "long long _trips%d = _first%d >= _limit%d ? ((long long)_first%d - _limit%d) / ", id, id,
+                id, id, id);
+    else
+        fprintf(output_fp, "long long _trips%d = _limit%d >= _first%d ? ((long long)_limit%d - _first%d) / ", id, id,
+                id, id, id);
+    if (!forn->step)
+        fprintf(output_fp, "1");
+    else
+        translate_node(descending ? forn->step->node.expr->r : forn->step, scope);
+    fprintf(output_fp, " + 1 : 0;\n");
+
+    if (vec->parallel)
+    {
+        long min_trips = parallel_threshold(vec);
+        translate_parallel_body(n, vec, id, scope);
+
+        fprintf(output_fp, "#ifndef _OPENMP\n");
+        translate_tab();
+        fprintf(output_fp, "if (_trips%d >= %ld) {\n", id, min_trips);
+        translate_depth++;
+        translate_tab();
+        fprintf(output_fp, "struct _par%d_ctx _c%d = {_first%d", id, id, id);
+        for (int i = 0; i < vec->ncaptures; i++)
+            fprintf(output_fp, ", %s", vec->captures[i]);
+        for (int i = 0; i < vec->nreductions; i++)
+            fprintf(output_fp, ", %s", vec->reductions[i]);
+        fprintf(output_fp, "};\n");
+        translate_tab();
+        fprintf(output_fp, "struct _par%d_acc _a%d[LUA_PARALLEL_MAX_THREADS];\n", id, id);
+        translate_tab();
+        fprintf(output_fp, "int _n%d = lua_parallel_for(_trips%d, _par%d, &_c%d, _a%d, sizeof(_a%d[0]));\n", id, id,
+                id, id, id, id);
+        translate_tab();
+        fprintf(output_fp, "for (int _t%d = 0; _t%d < _n%d; _t%d++) {\n", id, id, id, id);
+        translate_depth++;
+        for (int i = 0; i < vec->nreductions; i++)
+        {
+            const char *r = vec->reductions[i], *op = vec->ops[i];
+            translate_tab();
+            if (op[0] == '+' || op[0] == '*')
+                fprintf(output_fp, "%s = %s %s _a%d[_t%d].%s;\n", r, r, op, id, id, r);
+            else
+                fprintf(output_fp, "if (_a%d[_t%d].%s %s %s) %s = _a%d[_t%d].%s;\n", id, id, r,
+                        strcmp(op, "min") == 0 ? "<" : ">", r, r, id, id, r);
+        }
+        translate_depth--;
+        translate_tab();
+        fprintf(output_fp, "}\n");
+        translate_depth--;
+        translate_tab();
+        fprintf(output_fp, "} else\n");
+        fprintf(output_fp, "#endif\n");
+        translate_tab();
+        fprintf(output_fp, "#pragma omp parallel for%s if(_trips%d >= %ld)%s\n", vec->simd ? " simd" : "", id,
+                min_trips, vec->clauses);
+    }
+    else
+    {
+        translate_tab();
+        fprintf(output_fp, "#pragma omp simd%s\n", vec->clauses);
+    }
+    translate_tab();
+    fprintf(output_fp, "for (long long _k%d = 0; _k%d < _trips%d; _k%d++) {\n", id, id, id, id);
+    return id;
+}
+
+// Statement di un ramo dello switch, nel proprio scope e chiusi da break
+static void translate_case_body(struct AstNode *body, struct symlist *scope)
+{
+    translate_depth++;
+    scope_lvl++;
+    struct symlist *case_scope = create_symtab(scope_lvl, scope);
+
+    for (; body; body = body->next)
+    {
+        translate_tab();
+        translate_node(body, case_scope);
+        if (body->nodetype != FDEF_T && body->nodetype != FOR_T && body->nodetype != IF_T)
+        {
+            fprintf(output_fp, ";\n");
+        }
+    }
+    translate_tab();
+    fprintf(output_fp, "break;\n");
+
+    delete_symtab(case_scope);
+    scope_lvl--;
+    translate_depth--;
+    translate_tab();
+    fprintf(output_fp, "}\n");
+}
+
+/* Catena di if come switch: sugli interi i casi sono le costanti, sulle
+   stringhe le posizioni delle chiavi nella tabella _keys<n>, che
+   c_lua_switch_slot trova con l'hash perfetto e verifica con strcmp.
+   Restituisce 0 se il tipo della variabile non corrisponde alle costanti
+   e la catena va emessa come sequenza di if.
+*/
+static int translate_switch(struct dispatch *d, struct symlist *scope)
+{
+    struct symbol *sym = find_symtab(scope, (char *)d->var);
+    if (!sym || sym->type != (d->strings ? STRING_T : INT_T))
+        return 0;
+
+    if (d->strings)
+    {
+        int id = ++switch_tables;
+        runtime_use(RUNTIME_SWITCH);
+        fprintf(output_fp, "static const char *const _keys%d[%u] = {", id, d->mask + 1);
+        for (int i = 0; i < d->ncases; i++)
+            fprintf(output_fp, "%s[%u] = \"%s\"", i ? ", " : "", d->cases[i].slot, d->cases[i].text);
+        fprintf(output_fp, "};\n");
+        translate_tab();
+        fprintf(output_fp, "switch (c_lua_switch_slot(%s, _keys%d, %uu, %uu)) {\n", d->var, id, d->seed, d->mask);
+    }
+    else
+        fprintf(output_fp, "switch (%s) {\n", d->var);
+
+    for (int i = 0; i < d->ncases; i++)
+    {
+        translate_tab();
+        if (d->strings)
+            fprintf(output_fp, "case %u: {\n", d->cases[i].slot);
+        else
+            fprintf(output_fp, "case %lld: {\n", d->cases[i].value);
+        translate_case_body(d->cases[i].body, scope);
+    }
+    if (d->default_body)
+    {
+        translate_tab();
+        fprintf(output_fp, "default: {\n");
+        translate_case_body(d->default_body, scope);
+    }
+    translate_tab();
+    fprintf(output_fp, "}\n");
+    return 1;
+}
+
 // Funzione per tradurre il nodo con consapevolezza del tipo
 void translate_node(struct AstNode *n, struct symlist *current_scope)
 {
+    struct vec_loop *vec;
+    int canonical;
+    struct dispatch *chain;
+
     if (!n)
         return;
 
@@ -192,10 +736,23 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
         {
             // ADD_T, SUB_T, DIV_T, MUL_T,
             // G_T, GE_T, L_T, LE_T, EQ_T, NE_T
+            // In Lua '/' dà sempre un float: tra due interi la divisione C sarebbe intera.
+            // Il cast riguarda tutto il dividendo, calcolato tra interi come nell'IR
+            bool int_division = n->node.expr->expr_type == DIV_T && n->node.expr->l && n->node.expr->r &&
+                                c_value_type(n->node.expr->l, current_scope) == INT_T &&
+                                c_value_type(n->node.expr->r, current_scope) == INT_T;
+            if (int_division)
+            {
+                fprintf(output_fp, "(float)(");
+            }
             if (n->node.expr->l)
             {
                 translate_node(n->node.expr->l, current_scope);
             }
+            if (int_division)
+            {
+                fprintf(output_fp, ")");
+            }
             // La funzione convert_expr_type restituisce il simbolo C corretto per i vari operatori
             // tranne che per NE_T che in lua è "~=" mentre in C è "!="
             const char *c_operator;
@@ -217,6 +774,8 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
         }
         break;
     case IF_T:
+        if ((chain = dispatch_find(n)) && translate_switch(chain, current_scope))
+            break;
         fprintf(output_fp, "if (");
         translate_node(n->node.ifn->cond, current_scope);
         fprintf(output_fp, ") {\n");
@@ -281,67 +840,21 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
         fprintf(output_fp, "\n");
         break;
     case FOR_T:
-        fprintf(output_fp, "for (");
-
-        fprintf(output_fp, "int %s = ", n->node.forn->varname);
-        if (n->node.forn->start)
-        {
-            translate_node(n->node.forn->start, current_scope);
-        }
-        else
-        {
-            fprintf(output_fp, "0");
-        }
-
-        fprintf(output_fp, "; %s <= ", n->node.forn->varname);
-
-        // Condizione finale del ciclo
-        if (n->node.forn->end)
-        {
-            translate_node(n->node.forn->end, current_scope);
-        }
-        else
-        {
-            fprintf(output_fp, "0");
-        }
-
-        fprintf(output_fp, "; ");
-
-        if (n->node.forn->step)
-        {
-            fprintf(output_fp, "%s += ", n->node.forn->varname);
-            translate_node(n->node.forn->step, current_scope);
-        }
-        else
-        {
-            fprintf(output_fp, "%s++", n->node.forn->varname); // Default step è 1
-        }
-
-        fprintf(output_fp, ") {\n");
+        vec = vectorize_find(n);
+        canonical = vec && vec->ok && (vec->simd || vec->parallel)
+                        ? translate_canonical_header(n, vec, current_scope)
+                        : 0;
+        if (!canonical)
+            translate_for_header(n, current_scope);
 
         translate_depth++;
-
-        scope_lvl++;
-        struct symlist *for_scope = create_symtab(scope_lvl, current_scope);
-
-        insert_sym(for_scope, n->node.forn->varname, INT_T, VARIABLE, NULL, 0, "");
-
-        struct AstNode *for_body = n->node.forn->stmt;
-        while (for_body)
+        if (canonical)
         {
-            translate_tab();
-            translate_node(for_body, for_scope);
-
-            if (for_body->nodetype != FDEF_T && for_body->nodetype != FOR_T && for_body->nodetype != IF_T)
-            {
-                fprintf(output_fp, ";\n");
-            }
-            for_body = for_body->next;
+            char first[32];
+            snprintf(first, sizeof(first), "_first%d", canonical);
+            translate_canonical_var(n, first, canonical, current_scope);
         }
-
-        delete_symtab(for_scope);
-        scope_lvl--;
-
+        translate_for_body(n, current_scope);
         translate_depth--;
 
         translate_tab();
@@ -515,8 +1028,7 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
                         fprintf(output_fp, " ");
                     }
 
-                    struct complex_type ct = eval_expr_type(current_arg_for_format, current_scope);
-                    enum LUA_TYPE type_of_arg = ct.type;
+                    enum LUA_TYPE type_of_arg = c_value_type(current_arg_for_format, current_scope);
 
                     // Controllo se l'argomento è un VALORE STRINGA LETTERALE
                     if (current_arg_for_format->nodetype == VAL_T &&
@@ -526,50 +1038,7 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
                     }
                     else
                     {
-                        if (current_arg_for_format->nodetype == VAL_T)
-                        {
-                            type_of_arg = current_arg_for_format->node.val->val_type;
-                        }
-
-                        switch (type_of_arg)
-                        {
-                        case INT_T:
-                            fprintf(output_fp, "%%d");
-                            break;
-                        case FLOAT_T:
-                            fprintf(output_fp, "%%f");
-                            break;
-                        case NUMBER_T:
-                            fprintf(output_fp, "%%g");
-                            break;
-                        case STRING_T:
-                            fprintf(output_fp, "%%s");
-                            break;
-                        case NIL_T:
-                            fprintf(output_fp, "NULL");
-                            break;
-                        case TRUE_T:
-                            fprintf(output_fp, "true");
-                            break;
-                        case FALSE_T:
-                            fprintf(output_fp, "false");
-                            break;
-                        case BOOLEAN_T:
-                            fprintf(output_fp, "%%s");
-                            break;
-                        case FUNCTION_T:
-                            fprintf(output_fp, "function");
-                            break;
-                        case TABLE_T:
-                            fprintf(output_fp, "table");
-                            break;
-                        case USERDATA_T:
-                            fprintf(output_fp, "userdata");
-                            break;
-                        default:
-                            fprintf(output_fp, "%%s");
-                            break;
-                        }
+                        fprintf(output_fp, "%s", print_conversion(type_of_arg));
                     }
                     first_item_in_format = false;
                     current_arg_for_format = current_arg_for_format->next;
@@ -578,11 +1047,9 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
 
                 // Fase 2: Aggiungere gli argomenti alla chiamata printf
                 struct AstNode *current_arg_for_value = arg;
-                bool needs_comma = false;
                 while (current_arg_for_value)
                 {
-                    struct complex_type ct = eval_expr_type(current_arg_for_value, current_scope);
-                    enum LUA_TYPE type_of_arg = ct.type;
+                    enum LUA_TYPE type_of_arg = c_value_type(current_arg_for_value, current_scope);
 
                     bool is_literal_string = (current_arg_for_value->nodetype == VAL_T &&
                                               current_arg_for_value->node.val->val_type == STRING_T);
@@ -590,36 +1057,19 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
                     if (!is_literal_string)
                     {
                         // Solo se non è un letterale stringa
-                        if (current_arg_for_value->nodetype == VAL_T)
-                        {
-                            type_of_arg = current_arg_for_value->node.val->val_type;
-                        }
-
-                        switch (type_of_arg)
+                        if (print_passes_arg(type_of_arg))
                         {
-                        case INT_T:
-                        case FLOAT_T:
-                        case NUMBER_T:
-                        case STRING_T:
-                            if (needs_comma)
-                                fprintf(output_fp, ", ");
-                            else
-                                fprintf(output_fp, ", "); // Stampare virgola se c'è un argomento
-                            translate_node(current_arg_for_value, current_scope);
-                            needs_comma = true;
-                            break;
-                        case BOOLEAN_T:
-                            if (needs_comma)
-                                fprintf(output_fp, ", ");
+                            fprintf(output_fp, ", ");
+                            if (type_of_arg == BOOLEAN_T)
+                            {
+                                fprintf(output_fp, "(");
+                                translate_node(current_arg_for_value, current_scope);
+                                fprintf(output_fp, ") ? \"true\" : \"false\"");
+                            }
                             else
-                                fprintf(output_fp, ", ");
-                            fprintf(output_fp, "(");
-                            translate_node(current_arg_for_value, current_scope);
-                            fprintf(output_fp, ") ? \"true\" : \"false\"");
-                            needs_comma = true;
-                            break;
-                        default:
-                            break;
+                            {
+                                translate_node(current_arg_for_value, current_scope);
+                            }
                         }
                     }
                     current_arg_for_value = current_arg_for_value->next;
@@ -636,6 +1086,7 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
             if (!arg1)
             {
                 // io.read() di default è "*l"
+                runtime_use(RUNTIME_READ_LINE);
                 fprintf(output_fp, "c_lua_io_read_line()");
             }
             else
@@ -645,15 +1096,18 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
                     const char *fmt = arg1->node.val->string_val;
                     if (strcmp(fmt, "*n") == 0)
                     {
+                        runtime_use(RUNTIME_READ_NUMBER);
                         fprintf(output_fp, "c_lua_io_read_number()");
                     }
                     else if (strcmp(fmt, "*l") == 0 || strcmp(fmt, "*L") == 0)
                     {
                         // *L è come *l
+                        runtime_use(RUNTIME_READ_LINE);
                         fprintf(output_fp, "c_lua_io_read_line()");
                     }
                     else if (strcmp(fmt, "*a") == 0)
                     {
+                        runtime_use(RUNTIME_READ_LINE);
                         fprintf(output_fp,
                                 "/* io.read(\"*a\") - read all; complex, using simplified line read */ c_lua_io_read_line()");
                     }
@@ -665,6 +1119,7 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
                 else if (arg1->nodetype == VAL_T && (arg1->node.val->val_type == INT_T || arg1->node.val->val_type ==
                                                                                               FLOAT_T))
                 {
+                    runtime_use(RUNTIME_READ_BYTES);
                     fprintf(output_fp, "c_lua_io_read_bytes(");
                     translate_node(arg1, current_scope);
                     fprintf(output_fp, ")");
@@ -700,7 +1155,8 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
         break;
 
     case FDEF_T:
-        // Funzione definita dall'utente
+        // Funzione definita dall'utente, con gli attributi calcolati dall'analisi degli effetti
+        fprintf(output_fp, "%s", effects_prefix(n->node.fdef->name));
         if (n->node.fdef->ret_type)
         {
             // Se la funzione ha un tipo di ritorno, lo indichiamo
@@ -816,6 +1272,21 @@ void translate_node(struct AstNode *n, struct symlist *current_scope)
     }
 }
 
+/* Tipo di un parametro nella firma della funzione: quello di un simbolo con lo
+   stesso nome visibile nello scope (intero se non esiste) o, per i parametri con
+   valore di default, quello del valore
+*/
+enum LUA_TYPE param_type(struct AstNode *param, struct symlist *current_symtab)
+{
+    if (param->nodetype == DECL_T)
+    {
+        return eval_expr_type(param->node.decl->expr, current_symtab).type;
+    }
+
+    struct symbol *param_sym = find_symtab(current_symtab, param->node.var->name);
+    return param_sym ? param_sym->type : INT_T;
+}
+
 // Funzione per tradurre una lista di parametri di funzione con i loro tipi
 void translate_params(struct AstNode *params, struct symlist *current_symtab)
 {
@@ -830,25 +1301,14 @@ void translate_params(struct AstNode *params, struct symlist *current_symtab)
         // Gestione dei parametri in base al loro tipo
         if (params->nodetype == VAR_T && params->node.var && params->node.var->name)
         {
-            // Trova il tipo del parametro nella tabella dei simboli
-            // Se non lo troviamo, assumiamo che sia un intero
-            enum LUA_TYPE param_type = INT_T;
-
-            struct symbol *param_sym = find_symtab(current_symtab, params->node.var->name);
-            if (param_sym)
-            {
-                param_type = param_sym->type;
-            }
-
-            fprintf(output_fp, "%s %s", lua_type_to_c_string(param_type), params->node.var->name);
+            fprintf(output_fp, "%s %s", lua_type_to_c_string(param_type(params, current_symtab)),
+                    params->node.var->name);
         }
         else if (params->nodetype == DECL_T && params->node.decl->var &&
                  params->node.decl->var->nodetype == VAR_T)
         {
             // Parametro con valore di default
-            // Trova il tipo del parametro dalla dichiarazione
-            enum LUA_TYPE param_type = eval_expr_type(params->node.decl->expr, current_symtab).type;
-            fprintf(output_fp, "%s %s", lua_type_to_c_string(param_type),
+            fprintf(output_fp, "%s %s", lua_type_to_c_string(param_type(params, current_symtab)),
                     params->node.decl->var->node.var->name);
         }
         else
@@ -868,7 +1328,12 @@ void generate_func_prototype(struct AstNode *func_node)
     if (!func_node || func_node->nodetype != FDEF_T || !output_fp_h)
         return;
 
-    // Generiamo il tipo di ritorno
+    // Attributi e tipo di ritorno, come nella definizione (del wrapper, se memoize l'ha aggiunto)
+    struct ir_function *ir_func = ir_find_function(func_node->node.fdef->name);
+    if (ir_func && ir_func->memo)
+        fprintf(output_fp_h, "%s", effects_wrapper_prefix(func_node->node.fdef->name));
+    else
+        fprintf(output_fp_h, "%s", effects_prefix(func_node->node.fdef->name));
     if (func_node->node.fdef->ret_type)
     {
         fprintf(output_fp_h, "%s ", lua_type_to_c_string(func_node->node.fdef->ret_type));
@@ -893,8 +1358,264 @@ void generate_func_prototype(struct AstNode *func_node)
     }
 }
 
-void translate(struct AstNode *root_ast_node)
+// Traduce le definizioni di funzione e gli statement globali, dentro main()
+static void translate_main(struct AstNode *root_ast_node)
+{
+    // Inizio della funzione main() C
+    fprintf(output_fp, "int main() {\n");
+    translate_depth++;
+
+    // Traduzione degli statement globali Lua (che non sono FDEF_T) dentro main()
+    struct AstNode *current_node = root_ast_node;
+
+    scope_lvl = 0;
+
+    while (current_node)
+    {
+        if (current_node->nodetype != FDEF_T)
+        {
+            // Salta le definizioni di funzione, già tradotte
+            translate_tab(); // Indenta lo statement corrente
+            translate_node(current_node, root_symtab);
+            if (current_node->nodetype != IF_T && current_node->nodetype != FOR_T)
+            {
+                fprintf(output_fp, ";\n");
+            }
+        }
+        current_node = current_node->next;
+    }
+
+    // Fine della funzione main() C
+    translate_tab();
+    fprintf(output_fp, "return 0;\n");
+    translate_depth--;
+    fprintf(output_fp, "}\n");
+}
+
+static void translate_program(struct AstNode *root_ast_node)
+{
+    // Traduzione le definizioni di funzione Lua PRIMA del main
+    struct AstNode *current_node = root_ast_node;
+    while (current_node)
+    {
+        if (current_node->nodetype == FDEF_T)
+        {
+            translate_node(current_node, root_symtab); // Passa la symbol table globale
+        }
+        current_node = current_node->next;
+    }
+    translate_main(root_ast_node);
+}
+
+/* Unità di traduzione di --split: main in <nome>.c, le funzioni a gruppi di
+   split_functions in <nome>_<k>.c, tutte con lo stesso header. Ogni unità
+   è scritta prima in un buffer e copiata nel file solo se il contenuto è
+   cambiato, così make -j ricompila solo le unità toccate.
+*/
+static char **unit_paths;
+static int nunits;
+static int units_written;
+static char *unit_buf;
+static size_t unit_len;
+static size_t unit_parallel_start; // corpi dei cicli paralleli scritti dalle unità precedenti
+
+// Scrive il file se il contenuto è diverso da quello presente; 1 se l'ha scritto
+static int write_if_changed(const char *path, const char *buf, size_t len)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp)
+    {
+        char chunk[4096];
+        size_t off = 0, n;
+        int same = 1;
+        while (same && (n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        {
+            same = off + n <= len && memcmp(chunk, buf + off, n) == 0;
+            off += n;
+        }
+        fclose(fp);
+        if (same && off == len)
+            return 0;
+    }
+    fp = fopen(path, "w");
+    if (!fp)
+    {
+        fprintf(stderr, RED "ERRORE:" RESET " Impossibile aprire il file di output '%s'.\n", path);
+        perror("fopen");
+        exit(1);
+    }
+    fwrite(buf, 1, len, fp);
+    fclose(fp);
+    return 1;
+}
+
+static void unit_begin(void)
+{
+    output_fp = open_memstream(&unit_buf, &unit_len);
+    unit_parallel_start = 0;
+    if (parallel_fp)
+    {
+        fflush(parallel_fp);
+        unit_parallel_start = parallel_len;
+    }
+}
+
+// Chiude l'unità: include dell'header, corpi dei cicli paralleli dell'unità e codice
+static void unit_end(char *path, const char *header_name)
+{
+    char *file_buf;
+    size_t file_len;
+    FILE *fp = open_memstream(&file_buf, &file_len);
+
+    fclose(output_fp);
+    fprintf(fp, "#include \"%s\"\n\n", header_name);
+    if (parallel_fp)
+    {
+        fflush(parallel_fp);
+        if (parallel_len > unit_parallel_start)
+        {
+            fprintf(fp, "#ifndef _OPENMP\n");
+            fwrite(parallel_buf + unit_parallel_start, 1, parallel_len - unit_parallel_start, fp);
+            fprintf(fp, "#endif\n\n");
+        }
+    }
+    fwrite(unit_buf, 1, unit_len, fp);
+    fclose(fp);
+    free(unit_buf);
+
+    stats.bytes_c += file_len;
+    units_written += write_if_changed(path, file_buf, file_len);
+    free(file_buf);
+    if (unit_paths)
+        unit_paths = mem_realloc(unit_paths, (nunits + 1) * sizeof(char *));
+    else
+        unit_paths = mem_alloc(MEM_OUTPUT, sizeof(char *));
+    unit_paths[nunits++] = path;
+}
+
+// <nome>_<k>.c, o <nome>.c per k = 0
+static char *unit_path(const char *path_c, int k)
+{
+    int base_len = (int)strlen(path_c) - 2;
+    char *path = mem_alloc(MEM_OUTPUT, base_len + 16);
+    if (k)
+        sprintf(path, "%.*s_%d.c", base_len, path_c, k);
+    else
+        sprintf(path, "%s", path_c);
+    return path;
+}
+
+static void translate_split(struct AstNode *root, struct ir_program *program, const char *path_c, const char *header_name)
+{
+    int index = 0;
+
+    // Una nuova unità ogni split_functions funzioni
+    if (program)
+    {
+        for (struct ir_function *f = program->functions; f; f = f->next)
+        {
+            if (!f->name)
+                continue;
+            if (index % split_functions == 0)
+            {
+                if (index)
+                    unit_end(unit_path(path_c, index / split_functions), header_name);
+                unit_begin();
+            }
+            ir_emit_function(f, output_fp);
+            index++;
+        }
+    }
+    else
+    {
+        for (struct AstNode *n = root; n; n = n->next)
+        {
+            if (n->nodetype != FDEF_T)
+                continue;
+            if (index % split_functions == 0)
+            {
+                if (index)
+                    unit_end(unit_path(path_c, index / split_functions), header_name);
+                unit_begin();
+            }
+            translate_node(n, root_symtab);
+            index++;
+        }
+    }
+    if (index)
+        unit_end(unit_path(path_c, (index - 1) / split_functions + 1), header_name);
+
+    unit_begin();
+    if (program)
+    {
+        struct ir_function *main_func = program->functions;
+        while (main_func->name)
+            main_func = main_func->next;
+        ir_emit_function(main_func, output_fp);
+    }
+    else
+        translate_main(root);
+    unit_end(unit_path(path_c, 0), header_name);
+}
+
+/* Frammento di Makefile accanto alle unità: sorgenti, oggetti e programma
+   in variabili con il prefisso del nome del programma, da includere in un
+   Makefile che compila con make -j. Con il runtime dei cicli paralleli
+   serve -lpthread; con --runtime-lib anche l'header e la libreria del
+   runtime, cercati in LUA2C_RT (di default runtime, come nel Makefile del
+   transpiler).
+*/
+static void write_makefile_fragment(const char *path_c, const char *path_h, int parallel, int runtime_lib)
 {
+    int base_len = (int)strlen(path_c) - 2;
+    const char *name = strrchr(path_c, '/');
+    name = name ? name + 1 : path_c;
+
+    char *prefix = mem_strdup(MEM_OUTPUT, name);
+    prefix[path_c + base_len - name] = '\0';
+    for (char *c = prefix; *c; c++)
+        *c = isalnum((unsigned char)*c) ? toupper((unsigned char)*c) : '_';
+
+    char *buf;
+    size_t len;
+    FILE *fp = open_memstream(&buf, &len);
+    fprintf(fp, "# Generated by lua2c from %s: include it and build with make -j\n", filename);
+    fprintf(fp, "%s_SRCS =", prefix);
+    for (int i = 0; i < nunits; i++)
+        fprintf(fp, " %s", unit_paths[i]);
+    fprintf(fp, "\n%s_OBJS = $(%s_SRCS:.c=.o)\n", prefix, prefix);
+    fprintf(fp, "%s_BIN = %.*s\n", prefix, base_len, path_c);
+    if (runtime_lib)
+    {
+        fprintf(fp, "LUA2C_RT ?= runtime\n");
+        fprintf(fp, "%s_LIBS = $(LUA2C_RT)/liblua2c_rt.a\n", prefix);
+        fprintf(fp, "CPPFLAGS += -I$(LUA2C_RT)\n");
+    }
+    else
+        fprintf(fp, "%s_LIBS =\n", prefix);
+    if (parallel || runtime_lib)
+        fprintf(fp, "LDLIBS += -lpthread\n");
+    fprintf(fp, "\n$(%s_BIN): $(%s_OBJS) $(%s_LIBS)\n\t$(CC) $(CFLAGS) $(LDFLAGS) $(%s_OBJS) $(%s_LIBS) $(LDLIBS) -o $@\n\n",
+            prefix, prefix, prefix, prefix, prefix);
+    fprintf(fp, "$(%s_OBJS): %s\n", prefix, path_h);
+    fclose(fp);
+
+    char *path_mk = mem_alloc(MEM_OUTPUT, base_len + 4);
+    sprintf(path_mk, "%.*s.mk", base_len, path_c);
+    write_if_changed(path_mk, buf, len);
+    printf(">> Codice C diviso in %d unità (%d riscritte), regole di build in '%s'.\n", nunits, units_written,
+           path_mk);
+    free(buf);
+    mem_free(path_mk);
+    mem_free(prefix);
+    for (int i = 0; i < nunits; i++)
+        mem_free(unit_paths[i]);
+    mem_free(unit_paths);
+}
+
+void translate(struct AstNode *root_ast_node, struct ir_program *program)
+{
+    stats_begin(TIMER_OUTPUT);
     printf(">> Inizio traduzione da Lua a C...\n");
 
     // Costruzione del nome del file di output
@@ -910,7 +1631,7 @@ void translate(struct AstNode *root_ast_node)
         {
             // Calcola la lunghezza della base del nome del file
             size_t base_len = dot_position - filename;
-            output_filename_base = (char *)malloc(base_len + 1);
+            output_filename_base = mem_alloc(MEM_OUTPUT, base_len + 1);
             if (output_filename_base)
             {
                 strncpy(output_filename_base, filename, base_len);
@@ -920,14 +1641,14 @@ void translate(struct AstNode *root_ast_node)
         else
         {
             // Nessuna estensione trovata, usa l'intero nome del file come base
-            output_filename_base = strdup(filename);
+            output_filename_base = mem_strdup(MEM_OUTPUT, filename);
         }
 
         if (output_filename_base)
         {
             size_t c_filename_len = strlen(output_filename_base) + 2 + 1;
-            output_filename_c = (char *)malloc(c_filename_len);
-            output_filename_h = (char *)malloc(c_filename_len);
+            output_filename_c = mem_alloc(MEM_OUTPUT, c_filename_len);
+            output_filename_h = mem_alloc(MEM_OUTPUT, c_filename_len);
             if (output_filename_c)
             {
                 sprintf(output_filename_c, "%s.c", output_filename_base);
@@ -936,7 +1657,7 @@ void translate(struct AstNode *root_ast_node)
             {
                 sprintf(output_filename_h, "%s.h", output_filename_base);
             }
-            free(output_filename_base);
+            mem_free(output_filename_base);
         }
     }
 
@@ -947,7 +1668,7 @@ void translate(struct AstNode *root_ast_node)
             stderr,
             YELLOW "ATTENZIONE:" RESET
                    " Impossibile derivare il nome del file di output dal sorgente. Uso 'output.c' come default.\n");
-        output_filename_c = strdup("output.c");
+        output_filename_c = mem_strdup(MEM_OUTPUT, "output.c");
         if (!output_filename_c)
         {
             fprintf(stderr, RED "ERRORE:" RESET " Fallimento critico nell'allocazione del nome del file di output.\n");
@@ -955,19 +1676,7 @@ void translate(struct AstNode *root_ast_node)
         }
     }
 
-    // Apri il file di output
-    output_fp = fopen(output_filename_c, "w");
-
-    if (!output_fp)
-    {
-        fprintf(stderr, RED "ERRORE:" RESET " Impossibile aprire il file di output C '%s'.\n", output_filename_c);
-        perror("fopen");
-        free(output_filename_c);
-        exit(1);
-    }
-
-    char *header_filename = (char *)malloc(strlen(output_filename_h) + 1);
-    header_filename = strrchr(output_filename_h, '/');
+    char *header_filename = strrchr(output_filename_h, '/');
     if (header_filename)
     {
         header_filename++; // Skippa il / se lo trova
@@ -976,82 +1685,184 @@ void translate(struct AstNode *root_ast_node)
     {
         header_filename = output_filename_h; // Usa tutta la stringa se non trova /
     }
-    fprintf(output_fp, "#include \"%s\"\n\n", header_filename);
 
-    // Traduzione le definizioni di funzione Lua PRIMA del main
-    struct AstNode *current_node = root_ast_node;
-    while (current_node)
+    if (split_functions)
     {
-        if (current_node->nodetype == FDEF_T)
+        // Unità separate, scritte solo se cambiate
+        stats_end(TIMER_OUTPUT);
+        stats_begin(TIMER_TRANSLATE);
+        translate_split(root_ast_node, program, output_filename_c, header_filename);
+        stats_end(TIMER_TRANSLATE);
+        stats_begin(TIMER_OUTPUT);
+    }
+    else
+    {
+        // Apri il file di output
+        output_fp = fopen(output_filename_c, "w");
+
+        if (!output_fp)
         {
-            translate_node(current_node, root_symtab); // Passa la symbol table globale
+            fprintf(stderr, RED "ERRORE:" RESET " Impossibile aprire il file di output C '%s'.\n", output_filename_c);
+            perror("fopen");
+            mem_free(output_filename_c);
+            exit(1);
         }
-        current_node = current_node->next;
-    }
+        char *output_buf_c = mem_alloc(MEM_OUTPUT, OUTPUT_BUF_SIZE);
+        setvbuf(output_fp, output_buf_c, _IOFBF, OUTPUT_BUF_SIZE);
 
-    // Inizio della funzione main() C
-    fprintf(output_fp, "int main() {\n");
-    translate_depth++;
+        fprintf(output_fp, "#include \"%s\"\n\n", header_filename);
+        stats_end(TIMER_OUTPUT);
+        stats_begin(TIMER_TRANSLATE);
 
-    // Traduzione degli statement globali Lua (che non sono FDEF_T) dentro main()
-    current_node = root_ast_node;
+        if (program)
+        {
+            // Backend basato sull'IR (--ir): funzioni e main sono emessi dalla forma SSA
+            ir_emit(program, output_fp);
+        }
+        else
+        {
+            translate_program(root_ast_node);
+        }
+        stats_end(TIMER_TRANSLATE);
+        stats_begin(TIMER_OUTPUT);
+
+        // Chiudi il file di output
+        stats.bytes_c = ftell(output_fp);
+        fclose(output_fp);
+        mem_free(output_buf_c);
+        printf(">> Traduzione completata. Codice C generato in '%s'.\n", output_filename_c);
+    }
 
-    scope_lvl = 0;
+    // Defnizione header
+    printf(">> Generazione del file header...\n");
 
+    /* I prototipi (scritti da translate_params su output_fp) possono usare
+       lua_field: vanno in un buffer e nell'header dopo il runtime, che
+       contiene solo ciò che il programma ha usato.
+    */
+    char *prototypes_buf = NULL;
+    size_t prototypes_len = 0;
+    FILE *prototypes_fp = open_memstream(&prototypes_buf, &prototypes_len);
+    output_fp = prototypes_fp;
+    output_fp_h = prototypes_fp;
+    struct AstNode *current_node = root_ast_node;
     while (current_node)
     {
-        if (current_node->nodetype != FDEF_T)
+        if (current_node->nodetype == FDEF_T)
         {
-            // Salta le definizioni di funzione, già tradotte
-            translate_tab(); // Indenta lo statement corrente
-            translate_node(current_node, root_symtab);
-            if (current_node->nodetype != IF_T && current_node->nodetype != FOR_T)
-            {
-                fprintf(output_fp, ";\n");
-            }
+            generate_func_prototype(current_node);
         }
         current_node = current_node->next;
     }
-
-    // Fine della funzione main() C
-    translate_tab();
-    fprintf(output_fp, "return 0;\n");
-    translate_depth--;
-    fprintf(output_fp, "}\n");
-
-    // Chiudi il file di output
-    fclose(output_fp);
-    printf(">> Traduzione completata. Codice C generato in '%s'.\n", output_filename_c);
-
-    // Defnizione header
-    printf(">> Generazione del file header...\n");
-    output_fp_h = fopen(output_filename_h, "w");
+    fclose(prototypes_fp);
+
+    // Con --split l'header passa da un buffer, per riscriverlo solo se cambia
+    char *output_buf_h = NULL;
+    char *header_buf = NULL;
+    size_t header_len = 0;
+    if (split_functions)
+        output_fp = open_memstream(&header_buf, &header_len);
+    else
+    {
+        output_fp = fopen(output_filename_h, "w");
+        output_buf_h = mem_alloc(MEM_OUTPUT, OUTPUT_BUF_SIZE);
+        setvbuf(output_fp, output_buf_h, _IOFBF, OUTPUT_BUF_SIZE);
+    }
+    output_fp_h = output_fp;
 
     // include C necessari all'inizio del file
     fprintf(output_fp, "#include <stdio.h>\n");
     fprintf(output_fp, "#include <stdlib.h>\n");
     fprintf(output_fp, "#include <stdbool.h>\n");
-    fprintf(output_fp_h, "char* c_lua_io_read_line(){\n \
+
+    // Con --runtime-lib gli helper sono in liblua2c_rt, altrimenti static inline qui
+    int inline_runtime = runtime_used;
+    int parallel = parallel_fp != NULL;
+    int runtime_lib = runtime_lib_flag && (runtime_used || parallel_fp);
+    if (runtime_lib)
+    {
+        fprintf(output_fp_h, "#include \"lua2c_rt.h\"\n");
+        inline_runtime = 0;
+    }
+    if (inline_runtime & RUNTIME_SWITCH)
+        fprintf(output_fp_h, "#include <string.h>\n");
+    fprintf(output_fp_h, "\n");
+
+    // Ricerca delle chiavi degli switch sulle stringhe, con lo stesso hash di dispatch_hash
+    if (inline_runtime & RUNTIME_SWITCH)
+    {
+        fprintf(output_fp_h, "static inline unsigned c_lua_switch_hash(const char *s, unsigned seed)\n\
+{\n\
+    unsigned h = 2166136261u ^ seed;\n\
+    while (*s)\n\
+        h = (h ^ (unsigned char)*s++) * 16777619u;\n\
+    return h;\n\
+}\n\n");
+        fprintf(output_fp_h, "static inline int c_lua_switch_slot(const char *s, const char *const *keys, unsigned seed, unsigned mask)\n\
+{\n\
+    if (!s)\n\
+        return -1;\n\
+    unsigned slot = c_lua_switch_hash(s, seed) & mask;\n\
+    return keys[slot] && strcmp(keys[slot], s) == 0 ? (int)slot : -1;\n\
+}\n\n");
+    }
+
+    // Runtime e corpi dei cicli paralleli, solo se il programma ne contiene
+    if (parallel_fp)
+    {
+        fclose(parallel_fp);
+        // Con --split i corpi sono già nelle unità che contengono i cicli
+        if (!runtime_lib_flag || !split_functions)
+        {
+            fputs(runtime_lib_flag ? "#ifndef _OPENMP\n" : parallel_runtime, output_fp_h);
+            if (!split_functions)
+                fwrite(parallel_buf, 1, parallel_len, output_fp_h);
+            fprintf(output_fp_h, "#endif\n\n");
+        }
+        free(parallel_buf);
+        parallel_fp = NULL;
+    }
+
+    // Funzioni di io.read usate dal programma
+    if (inline_runtime & RUNTIME_READ_LINE)
+        fprintf(output_fp_h, "static inline char *c_lua_io_read_line(void)\n\
+{\n\
     char *buff;\n\
-    scanf(\"%%ms\", &buff);\n\
+    if (scanf(\"%%ms\", &buff) != 1)\n\
+        return NULL;\n\
     return buff;\n\
 }\n\n");
 
-    fprintf(output_fp_h, "float c_lua_io_read_number(){\n \
+    if (inline_runtime & RUNTIME_READ_NUMBER)
+        fprintf(output_fp_h, "static inline float c_lua_io_read_number(void)\n\
+{\n\
     float ret;\n\
-    scanf(\"%%f\", &ret);\n\
+    if (scanf(\"%%f\", &ret) != 1)\n\
+        return 0;\n\
     return ret;\n\
 }\n\n");
 
-    fprintf(output_fp_h, "char *c_lua_io_read_bytes(int n)\n\
+    if (inline_runtime & RUNTIME_READ_BYTES)
+        fprintf(output_fp_h, "static inline char *c_lua_io_read_bytes(int n)\n\
 {\n\
+    if (n < 0)\n\
+        n = 0;\n\
     char *buff = (char *)malloc(sizeof(char) * (n + 1));\n\
-    scanf(\"%%ms\", &buff);\n\
-    buff[n] = \'\\0\';\n\
+    if (!buff)\n\
+        return NULL;\n\
+    size_t len = fread(buff, 1, n, stdin);\n\
+    if (len == 0 && n > 0)\n\
+    {\n\
+        free(buff);\n\
+        return NULL;\n\
+    }\n\
+    buff[len] = \'\\0\';\n\
     return buff;\n\
 }\n\n");
 
-    fprintf(output_fp_h, "typedef struct\n\
+    // Campo delle tabelle, se il programma ne dichiara
+    if (inline_runtime & RUNTIME_FIELD)
+        fprintf(output_fp_h, "typedef struct\n\
 {\n\
     char *key;\n\
     union value\n\
@@ -1063,17 +1874,21 @@ void translate(struct AstNode *root_ast_node)
         } value;\n\
 } lua_field;\n\n");
 
-    // Genera i prototipi delle funzioni nell'header
-    current_node = root_ast_node;
-    while (current_node)
+    // Prototipi delle funzioni
+    fwrite(prototypes_buf, 1, prototypes_len, output_fp_h);
+    free(prototypes_buf);
+    stats.bytes_h = ftell(output_fp_h);
+    fclose(output_fp_h);
+    if (split_functions)
     {
-        if (current_node->nodetype == FDEF_T)
-        {
-            generate_func_prototype(current_node);
-        }
-        current_node = current_node->next;
+        write_if_changed(output_filename_h, header_buf, header_len);
+        free(header_buf);
+        write_makefile_fragment(output_filename_c, output_filename_h, parallel, runtime_lib);
     }
+    else
+        mem_free(output_buf_h);
     printf(">> Header completo in '%s'.\n", output_filename_h);
-    fclose(output_fp_h);
-    free(output_filename_c);
+    mem_free(output_filename_c);
+    mem_free(output_filename_h);
+    stats_end(TIMER_OUTPUT);
 }
@@ -1,15 +1,45 @@
 #ifndef TRANSLATE_H
 #define TRANSLATE_H
 
+#include <stdbool.h>
 #include "ast.h"
 #include "symtab.h"
 
 // Contatore globale per gli indici dei campi delle tabelle
 extern int table_field_counter;
 
-void translate(struct AstNode *root);
+struct ir_program;
+
+// Con un programma IR il codice è emesso dalla forma SSA, altrimenti direttamente dall'AST
+void translate(struct AstNode *root, struct ir_program *program);
 void translate_node(struct AstNode *n, struct symlist *current_scope);
 void translate_list(struct AstNode *l, const char *separator);
 void translate_params(struct AstNode *params_list, struct symlist *func_param_scope);
 const char *lua_type_to_c_string(enum LUA_TYPE type);
+enum LUA_TYPE param_type(struct AstNode *param, struct symlist *current_symtab);
+
+// Traduzione di print: conversione printf per tipo e tipi passati come argomento
+const char *print_conversion(enum LUA_TYPE type);
+bool print_passes_arg(enum LUA_TYPE type);
+
+/* Funzioni e tipi del runtime: il codice generato segna quelli che usa e
+   l'header contiene solo quelli, come static inline o da liblua2c_rt.
+*/
+#define RUNTIME_READ_LINE 0x01   // c_lua_io_read_line
+#define RUNTIME_READ_NUMBER 0x02 // c_lua_io_read_number
+#define RUNTIME_READ_BYTES 0x04  // c_lua_io_read_bytes
+#define RUNTIME_FIELD 0x08       // typedef lua_field
+#define RUNTIME_SWITCH 0x10      // c_lua_switch_hash e c_lua_switch_slot
+
+// Con --runtime-lib l'header include runtime/lua2c_rt.h invece di definire gli helper
+extern int runtime_lib_flag;
+
+void runtime_use(int helpers);
+
+/* Con --split=<n> il main va in <nome>.c e le funzioni, n per unità, in
+   <nome>_<k>.c, con un frammento di Makefile in <nome>.mk; 0 per un solo .c
+*/
+extern int split_functions;
+// Helper del runtime chiamato con il nome dato, 0 se il nome non è del runtime
+int runtime_helper(const char *name);
 #endif
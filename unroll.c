@@ -0,0 +1,286 @@
+#include "unroll.h"
+#include "fold.h"
+#include "mem.h"
+#include <stdio.h>
+#include <string.h>
+
+int unroll_factor = UNROLL_DEFAULT_FACTOR;
+
+static long unrolled;
+
+// Valore di un letterale intero o della negazione di un letterale intero
+static int literal_int(struct AstNode *n, long long *out)
+{
+    struct const_value c;
+    int neg = n && n->nodetype == EXPR_T && n->node.expr->expr_type == NEG_T;
+
+    if (neg)
+        n = n->node.expr->r;
+    if (!n || n->nodetype != VAL_T || n->node.val->val_type != INT_T ||
+        !const_parse(INT_T, n->node.val->string_val, &c) || c.type != INT_T)
+        return 0;
+    *out = neg ? -c.i : c.i;
+    return 1;
+}
+
+// Letterale intero nella forma del parser: i negativi sono la negazione di un letterale
+static struct AstNode *int_literal(long long v)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%lld", v < 0 ? -v : v);
+    struct AstNode *lit = new_value(VAL_T, INT_T, mem_strdup(MEM_AST, text));
+    return v < 0 ? new_expression(EXPR_T, NEG_T, NULL, lit) : lit;
+}
+
+/* Nodi del corpo, -1 se non si può copiare: le definizioni di funzione
+   sarebbero ripetute nello stesso blocco C, così come le tabelle (array C
+   inizializzati alla dichiarazione); un'assegnazione alla variabile di
+   controllo o un for annidato con lo stesso nome renderebbero sbagliata la
+   sostituzione. La grammatica non ha local: DECL_T è solo un parametro con
+   valore di default (ID = letterale nella lista dei parametri), quindi sta
+   sempre dentro una definizione di funzione, che è già esclusa.
+*/
+static int body_size(struct AstNode *n, const char *var)
+{
+    int size = 0;
+
+    for (; n; n = n->next)
+    {
+        int sub = 0;
+        size++;
+        switch (n->nodetype)
+        {
+        case FDEF_T:
+        case DECL_T:
+        case TABLE_NODE_T:
+        case TABLE_FIELD_T:
+        case ERROR_NODE_T:
+            return -1;
+        case VAR_T:
+            sub = body_size(n->node.var->table_key, var);
+            break;
+        case EXPR_T:
+            if (n->node.expr->expr_type == ASS_T && n->node.expr->l->nodetype == VAR_T &&
+                strcmp(n->node.expr->l->node.var->name, var) == 0)
+                return -1;
+            sub = body_size(n->node.expr->l, var);
+            sub = sub < 0 ? sub : sub + body_size(n->node.expr->r, var);
+            break;
+        case RETURN_T:
+            sub = body_size(n->node.ret->expr, var);
+            break;
+        case FCALL_T:
+            sub = body_size(n->node.fcall->args, var);
+            break;
+        case IF_T:
+        {
+            int cond = body_size(n->node.ifn->cond, var);
+            int body = body_size(n->node.ifn->body, var);
+            int else_body = body_size(n->node.ifn->else_body, var);
+            sub = cond < 0 || body < 0 || else_body < 0 ? -1 : cond + body + else_body;
+            break;
+        }
+        case FOR_T:
+        {
+            if (strcmp(n->node.forn->varname, var) == 0)
+                return -1;
+            int start = body_size(n->node.forn->start, var);
+            int end = body_size(n->node.forn->end, var);
+            int stmt = body_size(n->node.forn->stmt, var);
+            sub = start < 0 || end < 0 || stmt < 0 ? -1 : start + end + stmt + 1;
+            break;
+        }
+        default:
+            break;
+        }
+        if (sub < 0)
+            return -1;
+        size += sub;
+    }
+    return size;
+}
+
+// Sostituzione della variabile di controllo nelle copie del corpo
+struct subst
+{
+    const char *var;
+    long long value; // valore del letterale, o distanza da var se relative
+    int relative;
+};
+
+static struct AstNode *copy_list(struct AstNode *list, const struct subst *s);
+
+static struct AstNode *replacement(const struct subst *s)
+{
+    if (!s->relative)
+        return int_literal(s->value);
+    struct AstNode *var = new_variable(VAR_T, (char *)s->var, NULL);
+    if (s->value == 0)
+        return var;
+    struct AstNode *offset = int_literal(s->value < 0 ? -s->value : s->value);
+    return new_expression(EXPR_T, PAR_T, NULL,
+                          new_expression(EXPR_T, s->value < 0 ? SUB_T : ADD_T, var, offset));
+}
+
+// Copia profonda di un nodo, con la variabile di controllo sostituita
+static struct AstNode *copy_node(struct AstNode *n, const struct subst *s)
+{
+    struct AstNode *c;
+
+    if (!n)
+        return NULL;
+    switch (n->nodetype)
+    {
+    case VAL_T:
+        return new_value(VAL_T, n->node.val->val_type, n->node.val->string_val);
+    case VAR_T:
+        if (!n->node.var->table_key && strcmp(n->node.var->name, s->var) == 0)
+            return replacement(s);
+        return new_variable(VAR_T, n->node.var->name, copy_node(n->node.var->table_key, s));
+    case EXPR_T:
+        return new_expression(EXPR_T, n->node.expr->expr_type, copy_node(n->node.expr->l, s),
+                              copy_node(n->node.expr->r, s));
+    case RETURN_T:
+        return new_return(RETURN_T, copy_node(n->node.ret->expr, s));
+    case FCALL_T:
+        c = new_func_call(FCALL_T, copy_node(n->node.fcall->func_expr, s), copy_list(n->node.fcall->args, s));
+        c->node.fcall->name = n->node.fcall->name;
+        c->node.fcall->return_type = n->node.fcall->return_type;
+        return c;
+    case IF_T:
+        return new_if(IF_T, copy_node(n->node.ifn->cond, s), copy_list(n->node.ifn->body, s),
+                      copy_list(n->node.ifn->else_body, s));
+    case FOR_T:
+        return new_for(FOR_T, n->node.forn->varname, copy_node(n->node.forn->start, s),
+                       copy_node(n->node.forn->end, s), copy_node(n->node.forn->step, s),
+                       copy_list(n->node.forn->stmt, s));
+    default:
+        // Esclusi da body_size
+        return n;
+    }
+}
+
+static struct AstNode *copy_list(struct AstNode *list, const struct subst *s)
+{
+    struct AstNode *head = NULL, **tail = &head;
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        *tail = copy_node(n, s);
+        tail = &(*tail)->next;
+    }
+    return head;
+}
+
+// Accoda le copie del corpo alla lista che termina in *tail
+static struct AstNode **append_copy(struct AstNode **tail, struct AstNode *body, const struct subst *s)
+{
+    *tail = copy_list(body, s);
+    while (*tail)
+        tail = &(*tail)->next;
+    return tail;
+}
+
+// Statement che sostituiscono il ciclo, NULL se resta com'è
+static struct AstNode *unroll_for(struct AstNode *n)
+{
+    struct forNode *forn = n->node.forn;
+    long long start, end, step = 1;
+    struct AstNode *head = NULL, **tail = &head;
+
+    // Un ciclo marcato --@parallel resta intero per essere diviso tra i thread
+    if (forn->parallel)
+        return NULL;
+    if (!literal_int(forn->start, &start) || !literal_int(forn->end, &end) ||
+        (forn->step && !literal_int(forn->step, &step)) || step == 0)
+        return NULL;
+
+    long long trips = step > 0 ? (end >= start ? (end - start) / step + 1 : 0)
+                               : (end <= start ? (start - end) / -step + 1 : 0);
+    int size = body_size(forn->stmt, forn->varname);
+    if (trips == 0 || size <= 0)
+        return NULL;
+
+    struct subst s = {forn->varname, 0, 0};
+    long long first = 0;
+    if (trips > UNROLL_FULL_TRIPS || trips * size > UNROLL_MAX_SIZE)
+    {
+        // Srotolamento parziale: un giro esegue unroll_factor iterazioni
+        long long rounds = trips / unroll_factor;
+        if (unroll_factor < 2 || rounds < 2 || (long long)size * unroll_factor > UNROLL_MAX_SIZE)
+            return NULL;
+
+        struct AstNode *body = NULL, **body_tail = &body;
+        s.relative = 1;
+        for (int k = 0; k < unroll_factor; k++)
+        {
+            s.value = k * step;
+            body_tail = append_copy(body_tail, forn->stmt, &s);
+        }
+        first = rounds * unroll_factor;
+        head = new_for(FOR_T, forn->varname, int_literal(start), int_literal(start + (first - 1) * step),
+                       int_literal(step * unroll_factor), body);
+        tail = &head->next;
+    }
+
+    // Iterazioni rimaste, o tutte con lo srotolamento completo
+    s.relative = 0;
+    for (long long k = first; k < trips; k++)
+    {
+        s.value = start + k * step;
+        tail = append_copy(tail, forn->stmt, &s);
+    }
+    return head;
+}
+
+static void unroll_list(struct AstNode *list);
+
+static void unroll_statement(struct AstNode *n)
+{
+    switch (n->nodetype)
+    {
+    case IF_T:
+        unroll_list(n->node.ifn->body);
+        unroll_list(n->node.ifn->else_body);
+        break;
+    case FOR_T:
+        unroll_list(n->node.forn->stmt);
+        break;
+    case FDEF_T:
+        unroll_list(n->node.fdef->code);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Srotola i cicli della lista partendo da quelli più interni. Il nodo del
+   ciclo diventa la prima copia, così resta valido anche il puntatore alla
+   radice dell'AST.
+*/
+static void unroll_list(struct AstNode *list)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        struct AstNode *copies, *last;
+
+        unroll_statement(n);
+        if (n->nodetype != FOR_T || !(copies = unroll_for(n)))
+            continue;
+
+        unrolled++;
+        for (last = copies; last->next; last = last->next)
+            ;
+        last->next = n->next;
+        *n = *copies;
+        // Le copie contengono cicli già srotolati: si riprende dopo l'ultima
+        if (last != copies)
+            n = last;
+    }
+}
+
+long unroll_ast(struct AstNode *root)
+{
+    unrolled = 0;
+    unroll_list(root);
+    return unrolled;
+}
@@ -0,0 +1,26 @@
+#ifndef UNROLL_H
+#define UNROLL_H
+
+#include "ast.h"
+
+/* Srotolamento dei cicli for con estremi e passo letterali interi, di cui il
+   numero di iterazioni è noto durante la traduzione. I cicli brevi
+   diventano una copia del corpo per iterazione; quelli più lunghi ripetono
+   il corpo unroll_factor volte per giro e le iterazioni che avanzano
+   seguono il ciclo come copie. Nelle copie la variabile di controllo è un
+   letterale, o (i + k * passo), che il passo fold ripiega.
+*/
+
+// Iterazioni oltre le quali un ciclo non viene srotolato completamente
+#define UNROLL_FULL_TRIPS 8
+// Nodi dell'AST oltre i quali le copie del corpo non vengono prodotte
+#define UNROLL_MAX_SIZE 160
+// Copie del corpo per giro nello srotolamento parziale, se non indicato con --unroll-factor
+#define UNROLL_DEFAULT_FACTOR 4
+
+// Copie del corpo per giro, 1 disattiva lo srotolamento parziale
+extern int unroll_factor;
+
+long unroll_ast(struct AstNode *root);
+
+#endif
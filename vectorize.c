@@ -0,0 +1,424 @@
+#include "vectorize.h"
+#include "global.h"
+#include "mem.h"
+#include <stdio.h>
+#include <string.h>
+
+int vec_report_flag = 0;
+long parallel_min_trips = PARALLEL_DEFAULT_MIN_TRIPS;
+
+static struct vec_loop *loops;
+// Ordine di analisi dei cicli, per il report
+static struct vec_loop **order;
+static int nloops;
+static int loops_cap;
+static int analyzed;
+
+// Riduzione di una variabile: operatore della clausola e statement che la aggiorna
+struct reduction
+{
+    const char *name;
+    const char *op; // "+", "*", "min", "max"
+};
+
+struct vec_body
+{
+    const char *var; // variabile di controllo
+    struct reduction red[VEC_MAX_REDUCTIONS];
+    int nred;
+    const char *captures[VEC_MAX_CAPTURES];
+    int ncaptures;
+    char *reason;
+};
+
+static int fail(struct vec_body *b, const char *fmt, const char *name)
+{
+    if (!b->reason[0])
+        snprintf(b->reason, 96, fmt, name ? name : "");
+    return 0;
+}
+
+static int is_reduction(struct vec_body *b, const char *name)
+{
+    for (int i = 0; i < b->nred; i++)
+    {
+        if (strcmp(b->red[i].name, name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Variabile letta dal corpo che i thread ricevono nel contesto
+static int add_capture(struct vec_body *b, const char *name)
+{
+    if (strcmp(name, b->var) == 0)
+        return 1;
+    for (int i = 0; i < b->ncaptures; i++)
+    {
+        if (strcmp(b->captures[i], name) == 0)
+            return 1;
+    }
+    if (b->ncaptures == VEC_MAX_CAPTURES)
+        return fail(b, "troppe variabili lette", NULL);
+    b->captures[b->ncaptures++] = name;
+    return 1;
+}
+
+static int same_expr(struct AstNode *a, struct AstNode *b)
+{
+    if (a == b)
+        return 1;
+    if (!a || !b || a->nodetype != b->nodetype)
+        return 0;
+    switch (a->nodetype)
+    {
+    case VAL_T:
+        return a->node.val->val_type == b->node.val->val_type &&
+               strcmp(a->node.val->string_val, b->node.val->string_val) == 0;
+    case VAR_T:
+        return !a->node.var->table_key && !b->node.var->table_key &&
+               strcmp(a->node.var->name, b->node.var->name) == 0;
+    case EXPR_T:
+        return a->node.expr->expr_type == b->node.expr->expr_type && same_expr(a->node.expr->l, b->node.expr->l) &&
+               same_expr(a->node.expr->r, b->node.expr->r);
+    default:
+        return 0;
+    }
+}
+
+/* Espressione che ogni iterazione calcola da sola: letterali numerici,
+   variabili che il ciclo non riduce e operazioni aritmetiche. Il nodo in
+   *skip è la variabile della riduzione stessa.
+*/
+static int simple_expr(struct vec_body *b, struct AstNode *n, struct AstNode **skip)
+{
+    if (skip && *skip == n)
+    {
+        // Il nodo può essere condiviso dal hash-consing: si salta solo la prima occorrenza
+        *skip = NULL;
+        return 1;
+    }
+    switch (n->nodetype)
+    {
+    case VAL_T:
+        if (n->node.val->val_type != INT_T && n->node.val->val_type != FLOAT_T && n->node.val->val_type != NUMBER_T)
+            return fail(b, "operando non numerico", NULL);
+        return 1;
+    case VAR_T:
+        if (n->node.var->table_key)
+            return fail(b, "accesso alla tabella %s", n->node.var->name);
+        if (is_reduction(b, n->node.var->name))
+            return fail(b, "%s letta fuori dalla propria riduzione", n->node.var->name);
+        return add_capture(b, n->node.var->name);
+    case FCALL_T:
+        return fail(b, "chiamata a %s", n->node.fcall->func_expr->node.var->name);
+    case EXPR_T:
+        break;
+    default:
+        return fail(b, "espressione non aritmetica", NULL);
+    }
+    switch (n->node.expr->expr_type)
+    {
+    case ADD_T:
+    case SUB_T:
+    case MUL_T:
+    case DIV_T:
+        return simple_expr(b, n->node.expr->l, skip) && simple_expr(b, n->node.expr->r, skip);
+    case NEG_T:
+    case PAR_T:
+        return simple_expr(b, n->node.expr->r, skip);
+    default:
+        return fail(b, "espressione non aritmetica", NULL);
+    }
+}
+
+static int add_reduction(struct vec_body *b, const char *name, const char *op)
+{
+    if (strcmp(name, b->var) == 0)
+        return fail(b, "assegna la variabile di controllo %s", name);
+    if (is_reduction(b, name))
+        return fail(b, "%s assegnata più volte", name);
+    if (b->nred == VEC_MAX_REDUCTIONS)
+        return fail(b, "troppe riduzioni", NULL);
+    b->red[b->nred].name = name;
+    b->red[b->nred].op = op;
+    b->nred++;
+    return 1;
+}
+
+/* Variabile assegnata da una riduzione: s = s + a - b ..., s = a + s o
+   s = s * a * b ..., con s all'estremo sinistro della catena di somme o
+   prodotti. In *skip il nodo di s da non considerare come lettura.
+*/
+static const char *reduction_var(struct AstNode *n, const char **op, struct AstNode **skip)
+{
+    struct AstNode *l = n->node.expr->l, *r = n->node.expr->r;
+    if (!l || l->nodetype != VAR_T || l->node.var->table_key || r->nodetype != EXPR_T)
+        return NULL;
+
+    enum EXPRESSION_TYPE t = r->node.expr->expr_type;
+    if (t != ADD_T && t != SUB_T && t != MUL_T)
+        return NULL;
+    *op = t == MUL_T ? "*" : "+";
+    if (t == ADD_T && same_expr(r->node.expr->r, l))
+    {
+        *skip = r->node.expr->r;
+        return l->node.var->name;
+    }
+
+    struct AstNode *leaf = r;
+    while (leaf->nodetype == EXPR_T &&
+           (t == MUL_T ? leaf->node.expr->expr_type == MUL_T
+                       : leaf->node.expr->expr_type == ADD_T || leaf->node.expr->expr_type == SUB_T))
+        leaf = leaf->node.expr->l;
+    if (!same_expr(leaf, l))
+        return NULL;
+    *skip = leaf;
+    return l->node.var->name;
+}
+
+/* if e < m then m = e end e le varianti con >, <= e >= o con m a
+   sinistra: minimo o massimo di e. NULL se l'if non ha questa forma.
+*/
+static const char *minmax_var(struct AstNode *n, const char **op, struct AstNode **e)
+{
+    struct AstNode *cond = n->node.ifn->cond, *body = n->node.ifn->body;
+    if (n->node.ifn->else_body || !body || body->next || body->nodetype != EXPR_T ||
+        body->node.expr->expr_type != ASS_T || cond->nodetype != EXPR_T)
+        return NULL;
+
+    struct AstNode *m = body->node.expr->l;
+    enum EXPRESSION_TYPE t = cond->node.expr->expr_type;
+    int less = t == L_T || t == LE_T;
+    if (!less && t != G_T && t != GE_T)
+        return NULL;
+    *e = body->node.expr->r;
+    if (same_expr(cond->node.expr->l, *e) && same_expr(cond->node.expr->r, m))
+        *op = less ? "min" : "max";
+    else if (same_expr(cond->node.expr->l, m) && same_expr(cond->node.expr->r, *e))
+        *op = less ? "max" : "min";
+    else
+        return NULL;
+    return m->nodetype == VAR_T && !m->node.var->table_key ? m->node.var->name : NULL;
+}
+
+/* Prima si raccolgono le riduzioni, poi si controlla che le espressioni
+   non leggano le variabili ridotte: così l'ordine degli statement non
+   conta.
+*/
+static int analyze_body(struct vec_body *b, struct AstNode *list)
+{
+    if (!list)
+        return fail(b, "corpo vuoto", NULL);
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        const char *name = NULL, *op;
+        struct AstNode *e;
+        switch (n->nodetype)
+        {
+        case EXPR_T:
+            if (n->node.expr->expr_type != ASS_T)
+                return fail(b, "espressione senza effetto", NULL);
+            if (!(name = reduction_var(n, &op, &e)))
+                return fail(b, "assegnazione di %s che non è una riduzione", n->node.expr->l->node.var->name);
+            break;
+        case IF_T:
+            if (!(name = minmax_var(n, &op, &e)))
+                return fail(b, "if che non calcola un minimo o un massimo", NULL);
+            break;
+        case FCALL_T:
+            return fail(b, "chiamata a %s", n->node.fcall->func_expr->node.var->name);
+        case FOR_T:
+            return fail(b, "contiene il ciclo su %s", n->node.forn->varname);
+        case RETURN_T:
+            return fail(b, "return nel ciclo", NULL);
+        default:
+            return fail(b, "statement non supportato", NULL);
+        }
+        if (!add_reduction(b, name, op))
+            return 0;
+    }
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        const char *op;
+        struct AstNode *e, *skip = NULL;
+        if (n->nodetype == EXPR_T)
+        {
+            reduction_var(n, &op, &skip);
+            e = n->node.expr->r;
+        }
+        else
+            minmax_var(n, &op, &e);
+        if (!simple_expr(b, e, &skip))
+            return 0;
+    }
+    return 1;
+}
+
+static void analyze_loop(struct AstNode *n, const char *func, int index)
+{
+    struct vec_loop *v = mem_alloc(MEM_AST, sizeof(struct vec_loop));
+    struct vec_body b;
+
+    memset(v, 0, sizeof(struct vec_loop));
+    memset(&b, 0, sizeof(b));
+    v->loop = n;
+    v->func = func;
+    v->index = index;
+    b.var = n->node.forn->varname;
+    b.reason = v->reason;
+
+    if (!n->node.forn->start || !n->node.forn->end)
+        fail(&b, "estremi mancanti", NULL);
+    else if (analyze_body(&b, n->node.forn->stmt))
+    {
+        v->ok = 1;
+        size_t len = 0;
+        for (int i = 0; i < b.nred; i++)
+        {
+            v->reductions[v->nreductions] = b.red[i].name;
+            v->ops[v->nreductions++] = b.red[i].op;
+        }
+        for (int i = 0; i < b.ncaptures; i++)
+            v->captures[v->ncaptures++] = b.captures[i];
+        for (int i = 0; i < b.nred; i++)
+            len += snprintf(v->clauses + len, sizeof(v->clauses) - len, " reduction(%s:%s)", b.red[i].op,
+                            b.red[i].name);
+    }
+
+    HASH_ADD_PTR(loops, loop, v);
+    if (nloops == loops_cap)
+    {
+        loops_cap = loops_cap ? loops_cap * 2 : 16;
+        order = order ? mem_realloc(order, loops_cap * sizeof(struct vec_loop *))
+                      : mem_alloc(MEM_AST, loops_cap * sizeof(struct vec_loop *));
+    }
+    order[nloops++] = v;
+}
+
+static void walk_list(struct AstNode *list, const char *func, int *index)
+{
+    for (struct AstNode *n = list; n; n = n->next)
+    {
+        switch (n->nodetype)
+        {
+        case IF_T:
+            walk_list(n->node.ifn->body, func, index);
+            walk_list(n->node.ifn->else_body, func, index);
+            break;
+        case FOR_T:
+            analyze_loop(n, func, ++*index);
+            walk_list(n->node.forn->stmt, func, index);
+            break;
+        case FDEF_T:
+        {
+            int inner = 0;
+            walk_list(n->node.fdef->code, n->node.fdef->name, &inner);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+static void analyze_all(struct AstNode *root)
+{
+    int index = 0;
+
+    if (analyzed)
+        return;
+    walk_list(root, NULL, &index);
+    analyzed = 1;
+}
+
+long vectorize_ast(struct AstNode *root)
+{
+    long found = 0;
+
+    analyze_all(root);
+    for (int i = 0; i < nloops; i++)
+    {
+        order[i]->simd = order[i]->ok;
+        found += order[i]->ok;
+    }
+    return found;
+}
+
+long parallelize_ast(struct AstNode *root)
+{
+    long found = 0;
+
+    analyze_all(root);
+    for (int i = 0; i < nloops; i++)
+    {
+        order[i]->parallel |= order[i]->ok;
+        found += order[i]->ok;
+    }
+    return found;
+}
+
+static void hint_warning(struct vec_loop *v, const char *reason)
+{
+    fprintf(stderr, YELLOW "ATTENZIONE:" RESET " --@parallel ignorato per il ciclo %d su %s in %s: %s\n", v->index,
+            v->loop->node.forn->varname, v->func ? v->func : "main", reason);
+}
+
+void parallelize_hints(struct AstNode *root, int ir_backend)
+{
+    analyze_all(root);
+    for (int i = 0; i < nloops; i++)
+    {
+        struct vec_loop *v = order[i];
+        if (!v->loop->node.forn->parallel)
+            continue;
+        if (ir_backend)
+            hint_warning(v, "il backend IR emette i cicli con salti");
+        else if (!v->ok)
+            hint_warning(v, v->reason);
+        else
+            v->parallel = v->forced = 1;
+    }
+}
+
+struct vec_loop *vectorize_find(struct AstNode *loop)
+{
+    struct vec_loop *v;
+    if (!analyzed)
+        return NULL;
+    HASH_FIND_PTR(loops, &loop, v);
+    return v;
+}
+
+void vectorize_reject(struct vec_loop *v, const char *reason, const char *name)
+{
+    v->ok = 0;
+    snprintf(v->reason, sizeof(v->reason), reason, name ? name : "");
+    if (v->forced)
+        hint_warning(v, v->reason);
+}
+
+long parallel_threshold(struct vec_loop *v)
+{
+    return v->forced ? PARALLEL_FORCED_MIN_TRIPS : parallel_min_trips;
+}
+
+void vectorize_report(FILE *out, int ir_backend)
+{
+    if (!vec_report_flag || !analyzed)
+        return;
+    if (ir_backend)
+        fprintf(out, "vettorizzazione: il backend IR emette i cicli con salti, nessun pragma\n");
+    for (int i = 0; i < nloops; i++)
+    {
+        struct vec_loop *v = order[i];
+        fprintf(out, "%s: ciclo %d su %s: ", v->func ? v->func : "main", v->index, v->loop->node.forn->varname);
+        if (!v->ok)
+            fprintf(out, "non vettorizzabile, %s\n", v->reason);
+        else if (v->parallel)
+            fprintf(out, "%sparallelo da %ld iterazioni,%s\n", v->simd ? "vettorizzabile e " : "",
+                    parallel_threshold(v), v->clauses);
+        else
+            fprintf(out, "vettorizzabile,%s\n", v->clauses);
+    }
+}
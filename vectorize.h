@@ -0,0 +1,75 @@
+#ifndef VECTORIZE_H
+#define VECTORIZE_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "symtab.h"
+
+/* Cicli for che il vettorizzatore di gcc può eseguire in SIMD: il corpo
+   contiene solo riduzioni (somma, prodotto, minimo, massimo) di
+   espressioni aritmetiche della variabile di controllo e di variabili non
+   assegnate nel ciclo, quindi le iterazioni non dipendono l'una
+   dall'altra. Il backend AST li emette in forma canonica, con il numero di
+   iterazioni calcolato prima del ciclo e #pragma omp simd con le clausole
+   reduction.
+   Gli stessi cicli possono essere divisi tra più thread (-fparallelize o
+   il commento --@parallel davanti al for): con OpenMP il pragma diventa
+   omp parallel for, senza OpenMP il corpo è portato in una funzione che
+   un piccolo runtime pthread nell'header esegue su blocchi contigui di
+   iterazioni, e i risultati parziali delle riduzioni sono combinati dopo
+   il join.
+*/
+
+// Riduzioni gestite in un ciclo, oltre il limite il ciclo non viene vettorizzato
+#define VEC_MAX_REDUCTIONS 8
+// Variabili lette dal corpo oltre a quella di controllo, copiate nel contesto dei thread
+#define VEC_MAX_CAPTURES 16
+
+// Iterazioni sotto le quali un ciclo parallelo gira comunque in un solo thread
+#define PARALLEL_DEFAULT_MIN_TRIPS 10000
+// Soglia dei cicli marcati --@parallel: basta che ci siano due iterazioni da dividere
+#define PARALLEL_FORCED_MIN_TRIPS 2
+
+// Esito dell'analisi di un ciclo
+struct vec_loop
+{
+    struct AstNode *loop; // chiave della hash table
+    const char *func;     // funzione che contiene il ciclo, NULL per il programma principale
+    int index;            // posizione del ciclo nella funzione, da 1
+    int ok;
+    int simd;     // emesso con #pragma omp simd (-fvectorize)
+    int parallel; // emesso su più thread (-fparallelize o --@parallel)
+    int forced;   // marcato --@parallel: nessuna soglia di iterazioni
+    char reason[96];   // perché il ciclo non è vettorizzabile
+    char clauses[160]; // clausole reduction del pragma
+    const char *reductions[VEC_MAX_REDUCTIONS];
+    const char *ops[VEC_MAX_REDUCTIONS]; // "+", "*", "min", "max"
+    int nreductions;
+    const char *captures[VEC_MAX_CAPTURES];
+    int ncaptures;
+    UT_hash_handle hh;
+};
+
+// Stampa il report dei cicli analizzati su stderr (--vec-report)
+extern int vec_report_flag;
+// Soglia di iterazioni dei cicli paralleli (--parallel-min-trips)
+extern long parallel_min_trips;
+
+long vectorize_ast(struct AstNode *root);
+long parallelize_ast(struct AstNode *root);
+
+// Cicli marcati --@parallel: sono emessi paralleli senza soglia se l'analisi li accetta
+void parallelize_hints(struct AstNode *root, int ir_backend);
+
+// Esito per il ciclo, NULL se il passo non è attivo o il ciclo non è stato analizzato
+struct vec_loop *vectorize_find(struct AstNode *loop);
+
+// Iterazioni dalle quali il ciclo parallelo usa più thread
+long parallel_threshold(struct vec_loop *v);
+
+// Il backend rinuncia al ciclo durante la traduzione
+void vectorize_reject(struct vec_loop *v, const char *reason, const char *name);
+
+void vectorize_report(FILE *out, int ir_backend);
+
+#endif